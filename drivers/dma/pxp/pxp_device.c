@@ -257,7 +257,8 @@ static int pxp_device_ioctl(struct inode *inode, struct file *filp,
 			dma_cap_zero(mask);
 			dma_cap_set(DMA_SLAVE, mask);
 			dma_cap_set(DMA_PRIVATE, mask);
-			info->dma_chan = dma_request_channel(mask, NULL, NULL);
+			info->dma_chan =
+			    dma_request_channel(mask, pxp_chan_filter, NULL);
 			if (!info->dma_chan) {
 				pr_err("Unsccessfully received channel!\n");
 				kfree(info);
@@ -266,6 +267,9 @@ static int pxp_device_ioctl(struct inode *inode, struct file *filp,
 			pr_debug("Successfully received channel."
 				 "chan_id %d\n", info->dma_chan->chan_id);
 
+			/* Don't hold up the EPDC behind user-space jobs */
+			to_pxp_channel(info->dma_chan)->priority = PXP_PRIO_LOW;
+
 			spin_lock(&pxp_chan_lock);
 			list_add_tail(&info->list, &list);
 			spin_unlock(&pxp_chan_lock);
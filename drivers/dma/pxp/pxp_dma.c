@@ -39,16 +39,66 @@
 #include <linux/timer.h>
 #include <linux/clk.h>
 #include <linux/workqueue.h>
+#include <linux/bitmap.h>
 #include <mach/clock.h>
 #include <mach/boardid.h>
 
 #include "regs-pxp.h"
 
 #define	PXP_DOWNSCALE_THRESHOLD		0x4000
+#define	PXP_NR_REGS			(SZ_4K >> 4)
 
-static LIST_HEAD(head);
 static int timeout_in_ms = 600;
 
+/* Groups of registers pxp_config() leaves alone when their inputs repeat */
+enum {
+	PXP_STAGE_S0,		/* CTRL, S0PARAM, S0CROP, S0SCALE */
+	PXP_STAGE_OL,		/* OLn, OLnSIZE, OLnPARAM, OLCOLORKEY */
+	PXP_STAGE_COLORKEY,	/* S0COLORKEY */
+	PXP_STAGE_CSC,
+	PXP_STAGE_BG,
+	PXP_STAGE_LUT,
+	NR_PXP_STAGES,
+};
+
+static const char *pxp_stage_names[NR_PXP_STAGES] = {
+	"s0", "ol", "colorkey", "csc", "bg", "lut",
+};
+
+struct pxp_s0_key {
+	u32 s0_fmt;
+	u32 out_fmt;
+	unsigned short s0_width;
+	unsigned short s0_height;
+	struct rect srect;
+	struct rect drect;
+	int hflip;
+	int vflip;
+	int rotate;
+};
+
+struct pxp_ol_key {
+	int nr;
+	struct {
+		dma_addr_t paddr;
+		unsigned short width;
+		unsigned short height;
+		u32 pixel_fmt;
+		u32 color_key;
+		u32 flags;
+	} ol[8];
+};
+
+/* The overlay key is the largest */
+#define	PXP_STAGE_KEY_WORDS	(sizeof(struct pxp_ol_key) / sizeof(u32))
+
+struct pxp_stage {
+	bool valid;
+	u32 key[PXP_STAGE_KEY_WORDS];	/* inputs last programmed */
+	unsigned long hits;
+	unsigned long misses;
+};
+
 struct pxp_dma {
 	struct dma_device dma;
 };
@@ -65,7 +115,6 @@ struct pxps {
 #define	CLK_STAT_OFF		0
 #define	CLK_STAT_ON		1
 	int pxp_ongoing;
-	int lut_state;
 
 	struct device *dev;
 	struct pxp_dma pxp_dma;
@@ -80,6 +129,16 @@ struct pxps {
 	struct timer_list clk_timer;
 
 	unsigned long pxp_lut_ctrl_state;
+
+	/* per-priority queues of channels with work waiting to start */
+	struct list_head queue[NR_PXP_PRIO];
+	struct pxp_channel *cur_chan;	/* channel the PxP is working for */
+
+	/* register image, so unchanged registers aren't rewritten */
+	u32 regs[PXP_NR_REGS];
+	DECLARE_BITMAP(regs_valid, PXP_NR_REGS);
+
+	struct pxp_stage stage[NR_PXP_STAGES];
 };
 
 #define to_pxp_dma(d) container_of(d, struct pxp_dma, dma)
@@ -90,9 +149,6 @@ struct pxps {
 #define PXP_DEF_BUFS	2
 #define PXP_MIN_PIX	8
 
-#define PXP_WAITCON	((__raw_readl(pxp->base + HW_PXP_STAT) & \
-				BM_PXP_STAT_IRQ) != BM_PXP_STAT_IRQ)
-
 static uint32_t pxp_s0_formats[] = {
 	PXP_PIX_FMT_RGB24,
 	PXP_PIX_FMT_RGB565,
@@ -104,6 +160,54 @@ static uint32_t pxp_s0_formats[] = {
 /*
  * PXP common functions
  */
+
+/*
+ * Configuration registers are only written when their value changes.
+ * The image is dropped whenever the block is reset.
+ */
+static void pxp_writel(struct pxps *pxp, u32 val, u32 reg)
+{
+	int i = reg >> 4;
+
+	if (test_bit(i, pxp->regs_valid) && (pxp->regs[i] == val))
+		return;
+
+	__raw_writel(val, pxp->base + reg);
+	pxp->regs[i] = val;
+	__set_bit(i, pxp->regs_valid);
+}
+
+/*
+ * Returns true if @stage was last programmed from an identical @key, so its
+ * registers already hold the right values; otherwise remembers @key.
+ */
+static bool pxp_stage_unchanged(struct pxps *pxp, int stage,
+				const void *key, size_t len)
+{
+	struct pxp_stage *st = &pxp->stage[stage];
+
+	if (st->valid && !memcmp(st->key, key, len)) {
+		st->hits++;
+		return true;
+	}
+
+	memcpy(st->key, key, len);
+	st->valid = true;
+	st->misses++;
+
+	return false;
+}
+
+/* Forget what the hardware was programmed with, after a reset */
+static void pxp_cache_invalidate(struct pxps *pxp)
+{
+	int i;
+
+	bitmap_zero(pxp->regs_valid, PXP_NR_REGS);
+	for (i = 0; i < NR_PXP_STAGES; i++)
+		pxp->stage[i].valid = false;
+}
+
 static void dump_pxp_reg(struct pxps *pxp)
 {
 	dev_dbg(pxp->dev, "PXP_CTRL 0x%x",
@@ -282,11 +386,11 @@ static void pxp_set_outbuf(struct pxps *pxp)
 	struct pxp_config_data *pxp_conf = &pxp->pxp_conf_state;
 	struct pxp_layer_param *out_params = &pxp_conf->out_param;
 
-	__raw_writel(out_params->paddr, pxp->base + HW_PXP_OUTBUF);
+	pxp_writel(pxp, out_params->paddr, HW_PXP_OUTBUF);
 
-	__raw_writel(BF_PXP_OUTSIZE_WIDTH(out_params->width) |
-		     BF_PXP_OUTSIZE_HEIGHT(out_params->height),
-		     pxp->base + HW_PXP_OUTSIZE);
+	pxp_writel(pxp, BF_PXP_OUTSIZE_WIDTH(out_params->width) |
+		   BF_PXP_OUTSIZE_HEIGHT(out_params->height),
+		   HW_PXP_OUTSIZE);
 }
 
 static void pxp_set_s0colorkey(struct pxps *pxp)
@@ -297,13 +401,11 @@ static void pxp_set_s0colorkey(struct pxps *pxp)
 	/* Low and high are set equal. V4L does not allow a chromakey range */
 	if (s0_params->color_key == -1) {
 		/* disable color key */
-		__raw_writel(0xFFFFFF, pxp->base + HW_PXP_S0COLORKEYLOW);
-		__raw_writel(0, pxp->base + HW_PXP_S0COLORKEYHIGH);
+		pxp_writel(pxp, 0xFFFFFF, HW_PXP_S0COLORKEYLOW);
+		pxp_writel(pxp, 0, HW_PXP_S0COLORKEYHIGH);
 	} else {
-		__raw_writel(s0_params->color_key,
-			     pxp->base + HW_PXP_S0COLORKEYLOW);
-		__raw_writel(s0_params->color_key,
-			     pxp->base + HW_PXP_S0COLORKEYHIGH);
+		pxp_writel(pxp, s0_params->color_key, HW_PXP_S0COLORKEYLOW);
+		pxp_writel(pxp, s0_params->color_key, HW_PXP_S0COLORKEYHIGH);
 	}
 }
 
@@ -314,14 +416,12 @@ static void pxp_set_olcolorkey(int layer_no, struct pxps *pxp)
 
 	/* Low and high are set equal. V4L does not allow a chromakey range */
 	if (ol_params->color_key_enable != 0 && ol_params->color_key != -1) {
-		__raw_writel(ol_params->color_key,
-			     pxp->base + HW_PXP_OLCOLORKEYLOW);
-		__raw_writel(ol_params->color_key,
-			     pxp->base + HW_PXP_OLCOLORKEYHIGH);
+		pxp_writel(pxp, ol_params->color_key, HW_PXP_OLCOLORKEYLOW);
+		pxp_writel(pxp, ol_params->color_key, HW_PXP_OLCOLORKEYHIGH);
 	} else {
 		/* disable color key */
-		__raw_writel(0xFFFFFF, pxp->base + HW_PXP_OLCOLORKEYLOW);
-		__raw_writel(0, pxp->base + HW_PXP_OLCOLORKEYHIGH);
+		pxp_writel(pxp, 0xFFFFFF, HW_PXP_OLCOLORKEYLOW);
+		pxp_writel(pxp, 0, HW_PXP_OLCOLORKEYHIGH);
 	}
 }
 
@@ -330,12 +430,12 @@ static void pxp_set_oln(int layer_no, struct pxps *pxp)
 	struct pxp_config_data *pxp_conf = &pxp->pxp_conf_state;
 	struct pxp_layer_param *olparams_data = &pxp_conf->ol_param[layer_no];
 	dma_addr_t phys_addr = olparams_data->paddr;
-	__raw_writel(phys_addr, pxp->base + HW_PXP_OLn(layer_no));
+	pxp_writel(pxp, phys_addr, HW_PXP_OLn(layer_no));
 
 	/* Fixme */
-	__raw_writel(BF_PXP_OLnSIZE_WIDTH(olparams_data->width >> 3) |
-		     BF_PXP_OLnSIZE_HEIGHT(olparams_data->height >> 3),
-		     pxp->base + HW_PXP_OLnSIZE(layer_no));
+	pxp_writel(pxp, BF_PXP_OLnSIZE_WIDTH(olparams_data->width >> 3) |
+		   BF_PXP_OLnSIZE_HEIGHT(olparams_data->height >> 3),
+		   HW_PXP_OLnSIZE(layer_no));
 }
 
 static void pxp_set_olparam(int layer_no, struct pxps *pxp)
@@ -359,7 +459,7 @@ static void pxp_set_olparam(int layer_no, struct pxps *pxp)
 		olparam |= BM_PXP_OLnPARAM_ENABLE_COLORKEY;
 	if (olparams_data->combine_enable)
 		olparam |= BM_PXP_OLnPARAM_ENABLE;
-	__raw_writel(olparam, pxp->base + HW_PXP_OLnPARAM(layer_no));
+	pxp_writel(pxp, olparam, HW_PXP_OLnPARAM(layer_no));
 }
 
 static void pxp_set_s0param(struct pxps *pxp)
@@ -373,7 +473,7 @@ static void pxp_set_s0param(struct pxps *pxp)
 	s0param |= BF_PXP_S0PARAM_YBASE(proc_data->drect.top >> 3);
 	s0param |= BF_PXP_S0PARAM_WIDTH(s0params_data->width >> 3);
 	s0param |= BF_PXP_S0PARAM_HEIGHT(s0params_data->height >> 3);
-	__raw_writel(s0param, pxp->base + HW_PXP_S0PARAM);
+	pxp_writel(pxp, s0param, HW_PXP_S0PARAM);
 }
 
 static void pxp_set_s0crop(struct pxps *pxp)
@@ -385,7 +485,7 @@ static void pxp_set_s0crop(struct pxps *pxp)
 	s0crop |= BF_PXP_S0CROP_YBASE(proc_data->srect.top >> 3);
 	s0crop |= BF_PXP_S0CROP_WIDTH(proc_data->drect.width >> 3);
 	s0crop |= BF_PXP_S0CROP_HEIGHT(proc_data->drect.height >> 3);
-	__raw_writel(s0crop, pxp->base + HW_PXP_S0CROP);
+	pxp_writel(pxp, s0crop, HW_PXP_S0CROP);
 }
 
 static int pxp_set_scaling(struct pxps *pxp)
@@ -405,7 +505,7 @@ static int pxp_set_scaling(struct pxps *pxp)
 	if ((proc_data->srect.width == proc_data->drect.width) &&
 	    (proc_data->srect.height == proc_data->drect.height)) {
 		proc_data->scaling = 0;
-		__raw_writel(0x10001000, pxp->base + HW_PXP_S0SCALE);
+		pxp_writel(pxp, 0x10001000, HW_PXP_S0SCALE);
 		goto out;
 	}
 
@@ -417,7 +517,7 @@ static int pxp_set_scaling(struct pxps *pxp)
 	if (yscale > PXP_DOWNSCALE_THRESHOLD)
 		yscale = PXP_DOWNSCALE_THRESHOLD;
 	s0scale = BF_PXP_S0SCALE_YSCALE(yscale) | BF_PXP_S0SCALE_XSCALE(xscale);
-	__raw_writel(s0scale, pxp->base + HW_PXP_S0SCALE);
+	pxp_writel(pxp, s0scale, HW_PXP_S0SCALE);
 
 out:
 	pxp_set_ctrl(pxp);
@@ -427,8 +527,8 @@ out:
 
 static void pxp_set_bg(struct pxps *pxp)
 {
-	__raw_writel(pxp->pxp_conf_state.proc_data.bgcolor,
-		     pxp->base + HW_PXP_S0BACKGROUND);
+	pxp_writel(pxp, pxp->pxp_conf_state.proc_data.bgcolor,
+		   HW_PXP_S0BACKGROUND);
 }
 
 static void pxp_set_lut(struct pxps *pxp)
@@ -438,10 +538,6 @@ static void pxp_set_lut(struct pxps *pxp)
 	u32 reg_val;
 	int i;
 
-	/* If LUT already configured as needed, return */
-	if (pxp->lut_state == lut_op)
-		return;
-
 	if (lut_op == PXP_LUT_NONE) {
 		__raw_writel(BM_PXP_LUT_CTRL_BYPASS,
 			     pxp->base + HW_PXP_LUT_CTRL);
@@ -491,8 +587,6 @@ static void pxp_set_lut(struct pxps *pxp)
 			__raw_writel(reg_val, pxp->base + HW_PXP_LUT);
 		}
 	}
-
-	pxp->lut_state = lut_op;
 }
 
 static void pxp_set_csc(struct pxps *pxp)
@@ -514,26 +608,26 @@ static void pxp_set_csc(struct pxps *pxp)
 			/* Must convert to RGB for combining with RGB overlay */
 
 			/* CSC1 - YUV->RGB */
-			__raw_writel(0x04030000, pxp->base + HW_PXP_CSCCOEF0);
-			__raw_writel(0x01230208, pxp->base + HW_PXP_CSCCOEF1);
-			__raw_writel(0x076b079c, pxp->base + HW_PXP_CSCCOEF2);
+			pxp_writel(pxp, 0x04030000, HW_PXP_CSCCOEF0);
+			pxp_writel(pxp, 0x01230208, HW_PXP_CSCCOEF1);
+			pxp_writel(pxp, 0x076b079c, HW_PXP_CSCCOEF2);
 
 			/* CSC2 - RGB->YUV */
-			__raw_writel(0x4, pxp->base + HW_PXP_CSC2CTRL);
-			__raw_writel(0x0096004D, pxp->base + HW_PXP_CSC2COEF0);
-			__raw_writel(0x05DA001D, pxp->base + HW_PXP_CSC2COEF1);
-			__raw_writel(0x007005B6, pxp->base + HW_PXP_CSC2COEF2);
-			__raw_writel(0x057C009E, pxp->base + HW_PXP_CSC2COEF3);
-			__raw_writel(0x000005E6, pxp->base + HW_PXP_CSC2COEF4);
-			__raw_writel(0x00000000, pxp->base + HW_PXP_CSC2COEF5);
+			pxp_writel(pxp, 0x4, HW_PXP_CSC2CTRL);
+			pxp_writel(pxp, 0x0096004D, HW_PXP_CSC2COEF0);
+			pxp_writel(pxp, 0x05DA001D, HW_PXP_CSC2COEF1);
+			pxp_writel(pxp, 0x007005B6, HW_PXP_CSC2COEF2);
+			pxp_writel(pxp, 0x057C009E, HW_PXP_CSC2COEF3);
+			pxp_writel(pxp, 0x000005E6, HW_PXP_CSC2COEF4);
+			pxp_writel(pxp, 0x00000000, HW_PXP_CSC2COEF5);
 		} else {
 			/* Input & Output both YUV, so bypass both CSCs */
 
 			/* CSC1 - Bypass */
-			__raw_writel(0x40000000, pxp->base + HW_PXP_CSCCOEF0);
+			pxp_writel(pxp, 0x40000000, HW_PXP_CSCCOEF0);
 
 			/* CSC2 - Bypass */
-			__raw_writel(0x1, pxp->base + HW_PXP_CSC2CTRL);
+			pxp_writel(pxp, 0x1, HW_PXP_CSC2CTRL);
 		}
 	} else if (input_is_YUV && !output_is_YUV) {
 		/*
@@ -542,12 +636,12 @@ static void pxp_set_csc(struct pxps *pxp)
 		 */
 
 		/* CSC1 - YUV->RGB */
-		__raw_writel(0x84ab01f0, pxp->base + HW_PXP_CSCCOEF0);
-		__raw_writel(0x01230204, pxp->base + HW_PXP_CSCCOEF1);
-		__raw_writel(0x0730079c, pxp->base + HW_PXP_CSCCOEF2);
+		pxp_writel(pxp, 0x84ab01f0, HW_PXP_CSCCOEF0);
+		pxp_writel(pxp, 0x01230204, HW_PXP_CSCCOEF1);
+		pxp_writel(pxp, 0x0730079c, HW_PXP_CSCCOEF2);
 
 		/* CSC2 - Bypass */
-		__raw_writel(0x1, pxp->base + HW_PXP_CSC2CTRL);
+		pxp_writel(pxp, 0x1, HW_PXP_CSC2CTRL);
 	} else if (!input_is_YUV && output_is_YUV) {
 		/*
 		 * Input = RGB, Output = YUV
@@ -555,16 +649,16 @@ static void pxp_set_csc(struct pxps *pxp)
 		 */
 
 		/* CSC1 - Bypass */
-		__raw_writel(0x40000000, pxp->base + HW_PXP_CSCCOEF0);
+		pxp_writel(pxp, 0x40000000, HW_PXP_CSCCOEF0);
 
 		/* CSC2 - RGB->YUV */
-		__raw_writel(0x4, pxp->base + HW_PXP_CSC2CTRL);
-		__raw_writel(0x0096004D, pxp->base + HW_PXP_CSC2COEF0);
-		__raw_writel(0x05DA001D, pxp->base + HW_PXP_CSC2COEF1);
-		__raw_writel(0x007005B6, pxp->base + HW_PXP_CSC2COEF2);
-		__raw_writel(0x057C009E, pxp->base + HW_PXP_CSC2COEF3);
-		__raw_writel(0x000005E6, pxp->base + HW_PXP_CSC2COEF4);
-		__raw_writel(0x00000000, pxp->base + HW_PXP_CSC2COEF5);
+		pxp_writel(pxp, 0x4, HW_PXP_CSC2CTRL);
+		pxp_writel(pxp, 0x0096004D, HW_PXP_CSC2COEF0);
+		pxp_writel(pxp, 0x05DA001D, HW_PXP_CSC2COEF1);
+		pxp_writel(pxp, 0x007005B6, HW_PXP_CSC2COEF2);
+		pxp_writel(pxp, 0x057C009E, HW_PXP_CSC2COEF3);
+		pxp_writel(pxp, 0x000005E6, HW_PXP_CSC2COEF4);
+		pxp_writel(pxp, 0x00000000, HW_PXP_CSC2COEF5);
 	} else {
 		/*
 		 * Input = RGB, Output = RGB
@@ -572,10 +666,10 @@ static void pxp_set_csc(struct pxps *pxp)
 		 */
 
 		/* CSC1 - Bypass */
-		__raw_writel(0x40000000, pxp->base + HW_PXP_CSCCOEF0);
+		pxp_writel(pxp, 0x40000000, HW_PXP_CSCCOEF0);
 
 		/* CSC2 - Bypass */
-		__raw_writel(0x1, pxp->base + HW_PXP_CSC2CTRL);
+		pxp_writel(pxp, 0x1, HW_PXP_CSC2CTRL);
 	}
 
 	/* YCrCb colorspace */
@@ -595,7 +689,7 @@ static void pxp_set_s0buf(struct pxps *pxp)
 	dma_addr_t Y, U, V;
 
 	Y = s0_params->paddr;
-	__raw_writel(Y, pxp->base + HW_PXP_S0BUF);
+	pxp_writel(pxp, Y, HW_PXP_S0BUF);
 	if ((s0_params->pixel_fmt == PXP_PIX_FMT_YUV420P) ||
 	    (s0_params->pixel_fmt == PXP_PIX_FMT_YVU420P) ||
 	    (s0_params->pixel_fmt == PXP_PIX_FMT_GREY)) {
@@ -603,8 +697,8 @@ static void pxp_set_s0buf(struct pxps *pxp)
 		int s = 2;
 		U = Y + (s0_params->width * s0_params->height);
 		V = U + ((s0_params->width * s0_params->height) >> s);
-		__raw_writel(U, pxp->base + HW_PXP_S0UBUF);
-		__raw_writel(V, pxp->base + HW_PXP_S0VBUF);
+		pxp_writel(pxp, U, HW_PXP_S0UBUF);
+		pxp_writel(pxp, V, HW_PXP_S0VBUF);
 	}
 }
 
@@ -617,27 +711,77 @@ static void pxp_set_s0buf(struct pxps *pxp)
 static int pxp_config(struct pxps *pxp, struct pxp_channel *pxp_chan)
 {
 	struct pxp_config_data *pxp_conf_data = &pxp->pxp_conf_state;
+	struct pxp_proc_data *proc_data = &pxp_conf_data->proc_data;
+	struct pxp_layer_param *s0_params = &pxp_conf_data->s0_param;
+	struct pxp_layer_param *ol_params;
+	struct pxp_s0_key s0_key;
+	struct pxp_ol_key ol_key;
+	u32 key;
 	int ol_nr;
 	int i;
 
-	/* Configure PxP regs */
-	pxp_set_ctrl(pxp);
-	pxp_set_s0param(pxp);
-	pxp_set_s0crop(pxp);
-	pxp_set_scaling(pxp);
-	ol_nr = pxp_conf_data->layer_nr - 2;
-	while (ol_nr > 0) {
-		i = pxp_conf_data->layer_nr - 2 - ol_nr;
-		pxp_set_oln(i, pxp);
-		pxp_set_olparam(i, pxp);
-		/* only the color key in higher overlay will take effect. */
-		pxp_set_olcolorkey(i, pxp);
-		ol_nr--;
+	BUILD_BUG_ON(sizeof(struct pxp_s0_key) > sizeof(struct pxp_ol_key));
+
+	/* Configure PxP regs, skipping stages whose inputs haven't changed */
+	memset(&s0_key, 0, sizeof(s0_key));
+	s0_key.s0_fmt = s0_params->pixel_fmt;
+	s0_key.out_fmt = pxp_conf_data->out_param.pixel_fmt;
+	s0_key.s0_width = s0_params->width;
+	s0_key.s0_height = s0_params->height;
+	s0_key.srect = proc_data->srect;
+	s0_key.drect = proc_data->drect;
+	s0_key.hflip = proc_data->hflip;
+	s0_key.vflip = proc_data->vflip;
+	s0_key.rotate = proc_data->rotate;
+	if (!pxp_stage_unchanged(pxp, PXP_STAGE_S0, &s0_key, sizeof(s0_key))) {
+		pxp_set_s0param(pxp);
+		pxp_set_s0crop(pxp);
+		/* also sets CTRL, which depends on the scaling decision */
+		pxp_set_scaling(pxp);
 	}
-	pxp_set_s0colorkey(pxp);
-	pxp_set_csc(pxp);
-	pxp_set_bg(pxp);
-	pxp_set_lut(pxp);
+
+	ol_nr = min_t(int, pxp_conf_data->layer_nr - 2,
+		      ARRAY_SIZE(ol_key.ol));
+	memset(&ol_key, 0, sizeof(ol_key));
+	ol_key.nr = ol_nr;
+	for (i = 0; i < ol_nr; i++) {
+		ol_params = &pxp_conf_data->ol_param[i];
+		ol_key.ol[i].paddr = ol_params->paddr;
+		ol_key.ol[i].width = ol_params->width;
+		ol_key.ol[i].height = ol_params->height;
+		ol_key.ol[i].pixel_fmt = ol_params->pixel_fmt;
+		ol_key.ol[i].color_key = ol_params->color_key;
+		ol_key.ol[i].flags = (ol_params->color_key_enable ? 1 : 0) |
+				     (ol_params->combine_enable << 1) |
+				     (ol_params->global_alpha_enable << 2) |
+				     (ol_params->global_alpha << 8);
+	}
+	if (!pxp_stage_unchanged(pxp, PXP_STAGE_OL, &ol_key, sizeof(ol_key))) {
+		for (i = 0; i < ol_nr; i++) {
+			pxp_set_oln(i, pxp);
+			pxp_set_olparam(i, pxp);
+			/* only the color key in the highest overlay applies */
+			pxp_set_olcolorkey(i, pxp);
+		}
+	}
+
+	key = s0_params->color_key;
+	if (!pxp_stage_unchanged(pxp, PXP_STAGE_COLORKEY, &key, sizeof(key)))
+		pxp_set_s0colorkey(pxp);
+
+	key = is_yuv(s0_params->pixel_fmt) |
+	      (is_yuv(pxp_conf_data->out_param.pixel_fmt) << 1) |
+	      (pxp_conf_data->ol_param[0].combine_enable << 2);
+	if (!pxp_stage_unchanged(pxp, PXP_STAGE_CSC, &key, sizeof(key)))
+		pxp_set_csc(pxp);
+
+	key = proc_data->bgcolor;
+	if (!pxp_stage_unchanged(pxp, PXP_STAGE_BG, &key, sizeof(key)))
+		pxp_set_bg(pxp);
+
+	key = proc_data->lut_transform;
+	if (!pxp_stage_unchanged(pxp, PXP_STAGE_LUT, &key, sizeof(key)))
+		pxp_set_lut(pxp);
 
 	pxp_set_s0buf(pxp);
 	pxp_set_outbuf(pxp);
@@ -660,6 +804,17 @@ static void pxp_clk_enable(struct pxps *pxp)
 	mutex_unlock(&pxp->clk_mutex);
 }
 
+static bool pxp_queues_empty(struct pxps *pxp)
+{
+	int prio;
+
+	for (prio = 0; prio < NR_PXP_PRIO; prio++)
+		if (!list_empty(&pxp->queue[prio]))
+			return false;
+
+	return true;
+}
+
 static void pxp_clk_disable(struct pxps *pxp)
 {
 	unsigned long flags;
@@ -671,7 +826,7 @@ static void pxp_clk_disable(struct pxps *pxp)
 		return;
 	}
 
-	if ((pxp->pxp_ongoing == 0) && list_empty(&head)) {
+	if ((pxp->pxp_ongoing == 0) && pxp_queues_empty(pxp)) {
 		/* Do nothing */
 	}
 	else {
@@ -680,7 +835,7 @@ static void pxp_clk_disable(struct pxps *pxp)
 	}
 
 	spin_lock_irqsave(&pxp->lock, flags);
-	if ((pxp->pxp_ongoing == 0) && list_empty(&head)) {
+	if ((pxp->pxp_ongoing == 0) && pxp_queues_empty(pxp)) {
 		spin_unlock_irqrestore(&pxp->lock, flags);
 		clk_disable(pxp->clk);
 		pxp->clk_stat = CLK_STAT_OFF;
@@ -701,7 +856,7 @@ static void pxp_clkoff_timer(unsigned long arg)
 {
 	struct pxps *pxp = (struct pxps *)arg;
 
-	if ((pxp->pxp_ongoing == 0) && list_empty(&head))
+	if ((pxp->pxp_ongoing == 0) && pxp_queues_empty(pxp))
 		schedule_work(&pxp->work);
 	else
 		mod_timer(&pxp->clk_timer,
@@ -730,6 +885,7 @@ static void __pxpdma_dostart(struct pxp_channel *pxp_chan)
 	/* so far we presume only one transaction on active_list */
 	/* S0 */
 	desc = pxpdma_first_active(pxp_chan);
+	pxp->pxp_conf_state.layer_nr = desc->len;
 	memcpy(&pxp->pxp_conf_state.s0_param,
 	       &desc->layer_param.s0_param, sizeof(struct pxp_layer_param));
 	memcpy(&pxp->pxp_conf_state.proc_data,
@@ -759,38 +915,40 @@ static void __pxpdma_dostart(struct pxp_channel *pxp_chan)
 		 pxp->pxp_conf_state.out_param.paddr);
 }
 
-static void pxpdma_dostart_work(struct pxps *pxp)
+/*
+ * Start the first job of the highest priority channel with work queued.
+ * Called with pxp->lock held and the clock on, either when the PxP is idle
+ * or from the completion IRQ, so nobody has to wait for the engine.
+ */
+static void pxpdma_start_next(struct pxps *pxp)
 {
-	struct pxp_channel *pxp_chan = NULL;
-	unsigned long flags, flags1;
-
-	while (__raw_readl(pxp->base + HW_PXP_CTRL) & BM_PXP_CTRL_ENABLE)
-		;
-
-	spin_lock_irqsave(&pxp->lock, flags);
-	if (list_empty(&head)) {
-		pxp->pxp_ongoing = 0;
-		spin_unlock_irqrestore(&pxp->lock, flags);
-		return;
-	}
-
-	pxp_chan = list_entry(head.next, struct pxp_channel, list);
-
-	spin_lock_irqsave(&pxp_chan->lock, flags1);
-	if (!list_empty(&pxp_chan->active_list)) {
-		struct pxp_tx_desc *desc;
-		/* REVISIT */
-		desc = pxpdma_first_active(pxp_chan);
-		__pxpdma_dostart(pxp_chan);
+	struct pxp_channel *pxp_chan;
+	int prio;
+
+	for (prio = NR_PXP_PRIO - 1; prio >= 0; prio--) {
+		while (!list_empty(&pxp->queue[prio])) {
+			pxp_chan = list_first_entry(&pxp->queue[prio],
+						    struct pxp_channel, list);
+			list_del_init(&pxp_chan->list);
+
+			spin_lock(&pxp_chan->lock);
+			if (list_empty(&pxp_chan->active_list)) {
+				spin_unlock(&pxp_chan->lock);
+				continue;
+			}
+			__pxpdma_dostart(pxp_chan);
+			spin_unlock(&pxp_chan->lock);
+
+			pxp->cur_chan = pxp_chan;
+			pxp->pxp_ongoing = 1;
+
+			/* Configure PxP */
+			pxp_config(pxp, pxp_chan);
+
+			pxp_start(pxp);
+			return;
+		}
 	}
-	spin_unlock_irqrestore(&pxp_chan->lock, flags1);
-
-	/* Configure PxP */
-	pxp_config(pxp, pxp_chan);
-
-	pxp_start(pxp);
-
-	spin_unlock_irqrestore(&pxp->lock, flags);
 }
 
 static void pxpdma_dequeue(struct pxp_channel *pxp_chan, struct list_head *list)
@@ -937,24 +1095,27 @@ static irqreturn_t pxp_irq(int irq, void *dev_id)
 
 	spin_lock_irqsave(&pxp->lock, flags);
 
-	if (list_empty(&head)) {
-		pxp->pxp_ongoing = 0;
+	pxp_chan = pxp->cur_chan;
+	pxp->cur_chan = NULL;
+	pxp->pxp_ongoing = 0;
+
+	if (!pxp_chan) {
 		spin_unlock_irqrestore(&pxp->lock, flags);
 		return IRQ_NONE;
 	}
 
-	pxp_chan = list_entry(head.next, struct pxp_channel, list);
-	list_del_init(&pxp_chan->list);
+	spin_lock(&pxp_chan->lock);
 
 	if (list_empty(&pxp_chan->active_list)) {
 		pr_debug("PXP_IRQ pxp_chan->active_list empty. chan_id %d\n",
 			 pxp_chan->dma_chan.chan_id);
-		pxp->pxp_ongoing = 0;
+		spin_unlock(&pxp_chan->lock);
+		pxpdma_start_next(pxp);
 		spin_unlock_irqrestore(&pxp->lock, flags);
 		return IRQ_NONE;
 	}
 
-	/* Get descriptor and call callback */
+	/* Get descriptor */
 	desc = pxpdma_first_active(pxp_chan);
 
 	pxp_chan->completed = desc->txd.cookie;
@@ -965,16 +1126,24 @@ static irqreturn_t pxp_irq(int irq, void *dev_id)
 	/* Send histogram status back to caller */
 	desc->hist_status = hist_status;
 
-	if ((desc->txd.flags & DMA_PREP_INTERRUPT) && callback)
-		callback(callback_param);
-
-	pxp_chan->status = PXP_CHANNEL_INITIALIZED;
-
 	list_splice_init(&desc->tx_list, &pxp_chan->free_list);
 	list_move(&desc->list, &pxp_chan->free_list);
 
+	/* More work on this channel: back to the tail of its queue */
+	if (!list_empty(&pxp_chan->active_list))
+		list_add_tail(&pxp_chan->list, &pxp->queue[pxp_chan->priority]);
+	else
+		pxp_chan->status = PXP_CHANNEL_INITIALIZED;
+
+	spin_unlock(&pxp_chan->lock);
+
+	/* Chain the next job before handing this one back */
+	pxpdma_start_next(pxp);
+
+	if ((desc->txd.flags & DMA_PREP_INTERRUPT) && callback)
+		callback(callback_param);
+
 	wake_up(&pxp->done);
-	pxp->pxp_ongoing = 0;
 	mod_timer(&pxp->clk_timer, jiffies + msecs_to_jiffies(timeout_in_ms));
 
 	spin_unlock_irqrestore(&pxp->lock, flags);
@@ -1025,8 +1194,6 @@ static struct dma_async_tx_descriptor *pxp_prep_slave_sg(struct dma_chan *chan,
 							 unsigned long tx_flags)
 {
 	struct pxp_channel *pxp_chan = to_pxp_channel(chan);
-	struct pxp_dma *pxp_dma = to_pxp_dma(chan->device);
-	struct pxps *pxp = to_pxp(pxp_dma);
 	struct pxp_tx_desc *desc = NULL;
 	struct pxp_tx_desc *first = NULL, *prev = NULL;
 	struct scatterlist *sg;
@@ -1074,7 +1241,6 @@ static struct dma_async_tx_descriptor *pxp_prep_slave_sg(struct dma_chan *chan,
 	}
 	spin_unlock_irqrestore(&pxp_chan->lock, flags);
 
-	pxp->pxp_conf_state.layer_nr = sg_len;
 	first->txd.flags = tx_flags;
 	first->len = sg_len;
 	pr_debug("%s:%d first %p, first->len %d, flags %08x\n",
@@ -1088,48 +1254,52 @@ static void pxp_issue_pending(struct dma_chan *chan)
 	struct pxp_channel *pxp_chan = to_pxp_channel(chan);
 	struct pxp_dma *pxp_dma = to_pxp_dma(chan->device);
 	struct pxps *pxp = to_pxp(pxp_dma);
-	unsigned long flags0, flags;
+	unsigned long flags;
 
-	spin_lock_irqsave(&pxp->lock, flags0);
-	spin_lock_irqsave(&pxp_chan->lock, flags);
+	spin_lock_irqsave(&pxp->lock, flags);
+	spin_lock(&pxp_chan->lock);
 
-	if (!list_empty(&pxp_chan->queue)) {
-		pxpdma_dequeue(pxp_chan, &pxp_chan->active_list);
-		pxp_chan->status = PXP_CHANNEL_READY;
-		list_add_tail(&pxp_chan->list, &head);
-	} else {
-		spin_unlock_irqrestore(&pxp_chan->lock, flags);
-		spin_unlock_irqrestore(&pxp->lock, flags0);
+	if (list_empty(&pxp_chan->queue)) {
+		spin_unlock(&pxp_chan->lock);
+		spin_unlock_irqrestore(&pxp->lock, flags);
 		return;
 	}
-	spin_unlock_irqrestore(&pxp_chan->lock, flags);
-	spin_unlock_irqrestore(&pxp->lock, flags0);
+
+	pxpdma_dequeue(pxp_chan, &pxp_chan->active_list);
+	pxp_chan->status = PXP_CHANNEL_READY;
+
+	/* The running channel is requeued by the IRQ when its job is done */
+	if (list_empty(&pxp_chan->list) && (pxp->cur_chan != pxp_chan))
+		list_add_tail(&pxp_chan->list, &pxp->queue[pxp_chan->priority]);
+
+	spin_unlock(&pxp_chan->lock);
+	spin_unlock_irqrestore(&pxp->lock, flags);
 
 	pxp_clk_enable(pxp);
-	if (!wait_event_interruptible_timeout(pxp->done, PXP_WAITCON, 2 * HZ) ||
-		signal_pending(current)) {
-		pxp_clk_disable(pxp);
-		return;
-	}
 
+	/* If the PxP is busy, the completion IRQ starts the next job */
 	spin_lock_irqsave(&pxp->lock, flags);
-	pxp->pxp_ongoing = 1;
+	if (!pxp->pxp_ongoing)
+		pxpdma_start_next(pxp);
 	spin_unlock_irqrestore(&pxp->lock, flags);
-
-	pxpdma_dostart_work(pxp);
 }
 
 static void __pxp_terminate_all(struct dma_chan *chan)
 {
 	struct pxp_channel *pxp_chan = to_pxp_channel(chan);
+	struct pxps *pxp = to_pxp(to_pxp_dma(chan->device));
 	unsigned long flags;
 
 	/* pchan->queue is modified in ISR, have to spinlock */
-	spin_lock_irqsave(&pxp_chan->lock, flags);
+	spin_lock_irqsave(&pxp->lock, flags);
+	list_del_init(&pxp_chan->list);
+
+	spin_lock(&pxp_chan->lock);
 	list_splice_init(&pxp_chan->queue, &pxp_chan->free_list);
 	list_splice_init(&pxp_chan->active_list, &pxp_chan->free_list);
+	spin_unlock(&pxp_chan->lock);
 
-	spin_unlock_irqrestore(&pxp_chan->lock, flags);
+	spin_unlock_irqrestore(&pxp->lock, flags);
 
 	pxp_chan->status = PXP_CHANNEL_INITIALIZED;
 }
@@ -1146,6 +1316,7 @@ static int pxp_alloc_chan_resources(struct dma_chan *chan)
 
 	chan->cookie = 1;
 	pxp_chan->completed = -ENXIO;
+	pxp_chan->priority = PXP_PRIO_NORMAL;
 
 	pr_debug("%s dma_chan.chan_id %d\n", __func__, chan->chan_id);
 	ret = pxp_init_channel(pxp_dma, pxp_chan);
@@ -1335,6 +1506,7 @@ static int pxp_dma_init(struct pxps *pxp)
 
 		spin_lock_init(&pxp_chan->lock);
 		mutex_init(&pxp_chan->chan_mutex);
+		INIT_LIST_HEAD(&pxp_chan->list);
 
 		/* Only one EOF IRQ for PxP, shared by all channels */
 		pxp_chan->eof_irq = pxp->irq;
@@ -1373,12 +1545,30 @@ static ssize_t clk_off_timeout_store(struct device *dev,
 static DEVICE_ATTR(clk_off_timeout, 0644, clk_off_timeout_show,
 		   clk_off_timeout_store);
 
+static ssize_t stage_stats_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct pxps *pxp = dev_get_drvdata(dev);
+	ssize_t len = 0;
+	int i;
+
+	for (i = 0; i < NR_PXP_STAGES; i++)
+		len += sprintf(buf + len, "%-8s hits %lu misses %lu\n",
+			       pxp_stage_names[i], pxp->stage[i].hits,
+			       pxp->stage[i].misses);
+
+	return len;
+}
+
+static DEVICE_ATTR(stage_stats, 0444, stage_stats_show, NULL);
+
 static int pxp_probe(struct platform_device *pdev)
 {
 	struct pxps *pxp;
 	struct resource *res;
 	int irq;
 	int err = 0;
+	int i;
 
 	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
 	irq = platform_get_irq(pdev, 0);
@@ -1400,10 +1590,11 @@ static int pxp_probe(struct platform_device *pdev)
 	pxp->irq = irq;
 
 	pxp->pxp_ongoing = 0;
-	pxp->lut_state = 0;
 
 	spin_lock_init(&pxp->lock);
 	mutex_init(&pxp->clk_mutex);
+	for (i = 0; i < NR_PXP_PRIO; i++)
+		INIT_LIST_HEAD(&pxp->queue[i]);
 
 	if (!request_mem_region(res->start, resource_size(res), "pxp-mem")) {
 		err = -EBUSY;
@@ -1440,6 +1631,13 @@ static int pxp_probe(struct platform_device *pdev)
 		goto err_dma_init;
 	}
 
+	if (device_create_file(&pdev->dev, &dev_attr_stage_stats)) {
+		dev_err(&pdev->dev,
+			"Unable to create file from stage_stats\n");
+		device_remove_file(&pdev->dev, &dev_attr_clk_off_timeout);
+		goto err_dma_init;
+	}
+
 	INIT_WORK(&pxp->work, clkoff_callback);
 	init_waitqueue_head(&pxp->done);
 	init_timer(&pxp->clk_timer);
@@ -1468,6 +1666,7 @@ static int __devexit pxp_remove(struct platform_device *pdev)
 	clk_put(pxp->clk);
 	iounmap(pxp->base);
 	device_remove_file(&pdev->dev, &dev_attr_clk_off_timeout);
+	device_remove_file(&pdev->dev, &dev_attr_stage_stats);
 
 	kfree(pxp);
 
@@ -1478,15 +1677,33 @@ static int __devexit pxp_remove(struct platform_device *pdev)
 static int pxp_suspend(struct platform_device *pdev, pm_message_t state)
 {
 	struct pxps *pxp = platform_get_drvdata(pdev);
+	unsigned long flags;
+	int busy;
 
 	pxp_clk_enable(pxp);
 
 	pxp->pxp_lut_ctrl_state = __raw_readl(pxp->base + HW_PXP_LUT_CTRL);
 
-	while (__raw_readl(pxp->base + HW_PXP_CTRL) & BM_PXP_CTRL_ENABLE)
-		;
+	/*
+	 * Let the running job finish; its IRQ wakes us.  Resetting the
+	 * block under a job would leave cur_chan and pxp_ongoing set, and
+	 * nothing would start on the PxP again after resume, so refuse to
+	 * suspend while it is still busy.
+	 */
+	wait_event_timeout(pxp->done, !pxp->pxp_ongoing, HZ);
+
+	spin_lock_irqsave(&pxp->lock, flags);
+	busy = pxp->pxp_ongoing;
+	spin_unlock_irqrestore(&pxp->lock, flags);
+
+	if (busy) {
+		dev_warn(&pdev->dev, "busy, can't suspend\n");
+		pxp_clk_disable(pxp);
+		return -EBUSY;
+	}
 
 	__raw_writel(BM_PXP_CTRL_SFTRST, pxp->base + HW_PXP_CTRL);
+	pxp_cache_invalidate(pxp);
 	pxp_clk_disable(pxp);
 
 	while (pxp->clk->usecount > 0) {
@@ -0,0 +1,673 @@
+/*
+ * Copyright 2012 Amazon Technologies, Inc. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+/*
+ * CPU implementation of the PxP subset used by the EPDC driver, registered
+ * as a second dmaengine provider with the same channel and descriptor
+ * layout as pxp_dma.c:
+ *
+ *   S0 in GREY, RGB565 or RGB32; output GREY; rotation by 0/90/180/270;
+ *   the invert/monochrome LUTs; the GRAY16 histogram status.
+ *
+ * No scaling, flips, overlays or color keys.  Jobs outside that subset are
+ * refused at tx_submit(); clients check pxp_sw_supported() before picking
+ * this engine.  The engine reads and writes through the CPU mappings
+ * clients put in pxp_tx_desc.vaddr, and runs each job to completion in
+ * issue_pending(), so a small update neither waits for the PxP clock nor
+ * for its interrupt.
+ *
+ * Clients pick it with dma_request_channel(mask, pxp_chan_filter, (void *)1).
+ */
+#include <linux/dma-mapping.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/platform_device.h>
+#include <linux/slab.h>
+#include <linux/dmaengine.h>
+#include <linux/pxp_dma.h>
+#include <linux/random.h>
+#include <linux/scatterlist.h>
+#include <linux/completion.h>
+
+#define	PXP_SW_NR_DESC		16
+
+/*
+ * Level sets of the HIST2/4/8 parameters pxp_hw_init() programs, as masks
+ * of the output's top nibble; HIST16 holds every level.
+ */
+#define	PXP_SW_HIST2_LEVELS	0x8001	/* 0x0 0xF */
+#define	PXP_SW_HIST4_LEVELS	0x8421	/* 0x0 0x5 0xA 0xF */
+#define	PXP_SW_HIST8_LEVELS	0xAA55	/* 0x0 0x2 0x4 0x6 0x9 0xB 0xD 0xF */
+
+struct pxp_sw {
+	struct platform_device *pdev;
+	struct dma_device dma;
+	struct pxp_channel channel[NR_PXP_VIRT_CHANNEL];
+};
+
+static struct pxp_sw *pxp_sw;
+
+/* RGB->Y weights of the CSC2 setup in pxp_set_csc(), per 565 component */
+static u16 pxp_sw_y_r[32];
+static u16 pxp_sw_y_g[64];
+static u16 pxp_sw_y_b[32];
+
+/* LUT contents pxp_set_lut() loads, indexed by lut_transform */
+static u8 pxp_sw_lut[4][256];
+
+static void pxp_sw_tables_init(void)
+{
+	u32 c8;
+	int i;
+
+	for (i = 0; i < 32; i++) {
+		c8 = (i << 3) | (i >> 2);
+		pxp_sw_y_r[i] = 77 * c8;
+		pxp_sw_y_b[i] = 29 * c8;
+	}
+	for (i = 0; i < 64; i++) {
+		c8 = (i << 2) | (i >> 4);
+		pxp_sw_y_g[i] = 150 * c8;
+	}
+
+	for (i = 0; i < 256; i++) {
+		pxp_sw_lut[PXP_LUT_NONE][i] = i;
+		pxp_sw_lut[PXP_LUT_INVERT][i] = ~i;
+		pxp_sw_lut[PXP_LUT_BLACK_WHITE][i] = (i < 0x80) ? 0x00 : 0xFF;
+		pxp_sw_lut[PXP_LUT_INVERT | PXP_LUT_BLACK_WHITE][i] =
+		    (i < 0x80) ? 0xFF : 0x00;
+	}
+}
+
+/*
+ * One S0 row to the output: CSC, LUT, then a store every @step bytes so
+ * rotation is just a choice of start and step.  Returns the level mask.
+ */
+static u32 pxp_sw_row(u8 *dst, int step, const u8 *src, int width, int bpp,
+		      const u8 *lut)
+{
+	u32 pix, levels = 0;
+	u8 y;
+	int x;
+
+	switch (bpp) {
+	case 1:
+		for (x = 0; x < width; x++, dst += step) {
+			y = lut[src[x]];
+			*dst = y;
+			levels |= 1 << (y >> 4);
+		}
+		break;
+	case 2:
+		for (x = 0; x < width; x++, dst += step) {
+			pix = src[2 * x] | (src[2 * x + 1] << 8);
+			y = lut[(pxp_sw_y_r[pix >> 11] +
+				 pxp_sw_y_g[(pix >> 5) & 0x3F] +
+				 pxp_sw_y_b[pix & 0x1F]) >> 8];
+			*dst = y;
+			levels |= 1 << (y >> 4);
+		}
+		break;
+	case 4:
+		for (x = 0; x < width; x++, dst += step) {
+			pix = le32_to_cpu(((const u32 *)src)[x]);
+			y = lut[(77 * ((pix >> 16) & 0xFF) +
+				 150 * ((pix >> 8) & 0xFF) +
+				 29 * (pix & 0xFF)) >> 8];
+			*dst = y;
+			levels |= 1 << (y >> 4);
+		}
+		break;
+	}
+
+	return levels;
+}
+
+static u32 pxp_sw_hist_status(u32 levels)
+{
+	u32 hist_status = 0x8;
+
+	if (!(levels & ~PXP_SW_HIST2_LEVELS))
+		hist_status |= 0x1;
+	if (!(levels & ~PXP_SW_HIST4_LEVELS))
+		hist_status |= 0x2;
+	if (!(levels & ~PXP_SW_HIST8_LEVELS))
+		hist_status |= 0x4;
+
+	return hist_status;
+}
+
+/* Can this job be run by the CPU engine? */
+static int pxp_sw_check(struct pxp_tx_desc *desc)
+{
+	if ((desc->len != 2) || !desc->next)
+		return -EINVAL;
+
+	if (!pxp_sw_supported(&desc->layer_param.s0_param,
+			      &desc->next->layer_param.out_param,
+			      &desc->proc_data))
+		return -EINVAL;
+
+	if (!desc->vaddr || !desc->next->vaddr)
+		return -EINVAL;
+
+	return 0;
+}
+
+static void pxp_sw_process(struct pxp_tx_desc *desc)
+{
+	struct pxp_layer_param *s0_params = &desc->layer_param.s0_param;
+	struct pxp_proc_data *proc_data = &desc->proc_data;
+	const u8 *lut = pxp_sw_lut[proc_data->lut_transform];
+	int bpp = pxp_sw_bpp(s0_params->pixel_fmt);
+	int src_stride = s0_params->width * bpp;
+	int w = proc_data->srect.width;
+	int h = proc_data->srect.height;
+	const u8 *src;
+	u8 *out = desc->next->vaddr;
+	u8 *dst;
+	int step;
+	u32 levels = 0;
+	int y;
+
+	src = (const u8 *)desc->vaddr + proc_data->srect.top * src_stride +
+	    proc_data->srect.left * bpp;
+
+	/* 90/270 output frames are h pixels wide */
+	for (y = 0; y < h; y++, src += src_stride) {
+		switch (proc_data->rotate) {
+		case 90:
+			dst = out + (h - 1 - y);
+			step = h;
+			break;
+		case 180:
+			dst = out + (h - 1 - y) * w + (w - 1);
+			step = -1;
+			break;
+		case 270:
+			dst = out + (w - 1) * h + y;
+			step = -h;
+			break;
+		default:
+			dst = out + y * w;
+			step = 1;
+			break;
+		}
+
+		levels |= pxp_sw_row(dst, step, src, w, bpp, lut);
+	}
+
+	/* Output is usually write-combined; drain it before the client DMAs */
+	wmb();
+
+	desc->hist_status = pxp_sw_hist_status(levels);
+}
+
+/* called with pxp_chan->lock held */
+static struct pxp_tx_desc *pxp_sw_desc_get(struct pxp_channel *pxp_chan)
+{
+	struct pxp_tx_desc *desc;
+
+	if (list_empty(&pxp_chan->free_list))
+		return NULL;
+
+	desc = list_first_entry(&pxp_chan->free_list, struct pxp_tx_desc,
+				list);
+	list_del_init(&desc->list);
+
+	return desc;
+}
+
+/* called with pxp_chan->lock held */
+static void pxp_sw_desc_put(struct pxp_channel *pxp_chan,
+			    struct pxp_tx_desc *desc)
+{
+	list_splice_init(&desc->tx_list, &pxp_chan->free_list);
+	list_add(&desc->list, &pxp_chan->free_list);
+}
+
+static dma_cookie_t pxp_sw_tx_submit(struct dma_async_tx_descriptor *tx)
+{
+	struct pxp_tx_desc *desc = to_tx_desc(tx);
+	struct pxp_channel *pxp_chan = to_pxp_channel(tx->chan);
+	dma_cookie_t cookie;
+	unsigned long flags;
+
+	if (pxp_sw_check(desc)) {
+		dev_dbg(&pxp_chan->dma_chan.dev->device,
+			"job not supported by pxp_sw\n");
+		spin_lock_irqsave(&pxp_chan->lock, flags);
+		pxp_sw_desc_put(pxp_chan, desc);
+		spin_unlock_irqrestore(&pxp_chan->lock, flags);
+		return -EINVAL;
+	}
+
+	mutex_lock(&pxp_chan->chan_mutex);
+
+	cookie = pxp_chan->dma_chan.cookie;
+	if (++cookie < 0)
+		cookie = 1;
+	pxp_chan->dma_chan.cookie = cookie;
+	tx->cookie = cookie;
+
+	spin_lock_irqsave(&pxp_chan->lock, flags);
+	list_add_tail(&desc->list, &pxp_chan->queue);
+	spin_unlock_irqrestore(&pxp_chan->lock, flags);
+
+	mutex_unlock(&pxp_chan->chan_mutex);
+
+	return cookie;
+}
+
+static struct dma_async_tx_descriptor *pxp_sw_prep_slave_sg(
+	struct dma_chan *chan, struct scatterlist *sgl, unsigned int sg_len,
+	enum dma_data_direction direction, unsigned long tx_flags)
+{
+	struct pxp_channel *pxp_chan = to_pxp_channel(chan);
+	struct pxp_tx_desc *desc, *first = NULL, *prev = NULL;
+	struct scatterlist *sg;
+	unsigned long flags;
+	int i;
+
+	if (direction != DMA_FROM_DEVICE && direction != DMA_TO_DEVICE)
+		return NULL;
+
+	if (unlikely(sg_len < 2))
+		return NULL;
+
+	spin_lock_irqsave(&pxp_chan->lock, flags);
+	for_each_sg(sgl, sg, sg_len, i) {
+		desc = pxp_sw_desc_get(pxp_chan);
+		if (!desc) {
+			if (first)
+				pxp_sw_desc_put(pxp_chan, first);
+			spin_unlock_irqrestore(&pxp_chan->lock, flags);
+			return NULL;
+		}
+
+		desc->vaddr = NULL;
+		desc->next = NULL;
+
+		if (!first) {
+			first = desc;
+			desc->layer_param.s0_param.paddr = sg_dma_address(sg);
+		} else {
+			list_add_tail(&desc->list, &first->tx_list);
+			prev->next = desc;
+			if (i == 1)
+				desc->layer_param.out_param.paddr =
+				    sg_dma_address(sg);
+			else
+				desc->layer_param.ol_param.paddr =
+				    sg_dma_address(sg);
+		}
+
+		prev = desc;
+	}
+	spin_unlock_irqrestore(&pxp_chan->lock, flags);
+
+	first->txd.flags = tx_flags;
+	first->len = sg_len;
+
+	return &first->txd;
+}
+
+/* Run everything queued on the channel, in the caller's context */
+static void pxp_sw_issue_pending(struct dma_chan *chan)
+{
+	struct pxp_channel *pxp_chan = to_pxp_channel(chan);
+	struct pxp_tx_desc *desc;
+	dma_async_tx_callback callback;
+	void *callback_param;
+	unsigned long flags, tx_flags;
+
+	spin_lock_irqsave(&pxp_chan->lock, flags);
+	list_splice_tail_init(&pxp_chan->queue, &pxp_chan->active_list);
+
+	while (!list_empty(&pxp_chan->active_list)) {
+		desc = list_first_entry(&pxp_chan->active_list,
+					struct pxp_tx_desc, list);
+		spin_unlock_irqrestore(&pxp_chan->lock, flags);
+
+		pxp_sw_process(desc);
+
+		pxp_chan->completed = desc->txd.cookie;
+		callback = desc->txd.callback;
+		callback_param = desc->txd.callback_param;
+		tx_flags = desc->txd.flags;
+
+		spin_lock_irqsave(&pxp_chan->lock, flags);
+		list_del_init(&desc->list);
+		pxp_sw_desc_put(pxp_chan, desc);
+		spin_unlock_irqrestore(&pxp_chan->lock, flags);
+
+		if ((tx_flags & DMA_PREP_INTERRUPT) && callback)
+			callback(callback_param);
+
+		spin_lock_irqsave(&pxp_chan->lock, flags);
+	}
+
+	spin_unlock_irqrestore(&pxp_chan->lock, flags);
+}
+
+static void pxp_sw_terminate_all(struct dma_chan *chan)
+{
+	struct pxp_channel *pxp_chan = to_pxp_channel(chan);
+	unsigned long flags;
+
+	spin_lock_irqsave(&pxp_chan->lock, flags);
+	list_splice_init(&pxp_chan->queue, &pxp_chan->free_list);
+	list_splice_init(&pxp_chan->active_list, &pxp_chan->free_list);
+	spin_unlock_irqrestore(&pxp_chan->lock, flags);
+
+	pxp_chan->status = PXP_CHANNEL_INITIALIZED;
+}
+
+static int pxp_sw_alloc_chan_resources(struct dma_chan *chan)
+{
+	struct pxp_channel *pxp_chan = to_pxp_channel(chan);
+	struct pxp_tx_desc *desc;
+	int i;
+
+	desc = kcalloc(PXP_SW_NR_DESC, sizeof(*desc), GFP_KERNEL);
+	if (!desc)
+		return -ENOMEM;
+
+	pxp_chan->desc = desc;
+	pxp_chan->n_tx_desc = PXP_SW_NR_DESC;
+	INIT_LIST_HEAD(&pxp_chan->active_list);
+	INIT_LIST_HEAD(&pxp_chan->queue);
+	INIT_LIST_HEAD(&pxp_chan->free_list);
+
+	for (i = 0; i < PXP_SW_NR_DESC; i++, desc++) {
+		INIT_LIST_HEAD(&desc->tx_list);
+		dma_async_tx_descriptor_init(&desc->txd, chan);
+		desc->txd.tx_submit = pxp_sw_tx_submit;
+		list_add(&desc->list, &pxp_chan->free_list);
+	}
+
+	chan->cookie = 1;
+	pxp_chan->completed = -ENXIO;
+	pxp_chan->status = PXP_CHANNEL_INITIALIZED;
+
+	return PXP_SW_NR_DESC;
+}
+
+static void pxp_sw_free_chan_resources(struct dma_chan *chan)
+{
+	struct pxp_channel *pxp_chan = to_pxp_channel(chan);
+
+	mutex_lock(&pxp_chan->chan_mutex);
+
+	pxp_sw_terminate_all(chan);
+	pxp_chan->status = PXP_CHANNEL_FREE;
+
+	kfree(pxp_chan->desc);
+	pxp_chan->desc = NULL;
+
+	mutex_unlock(&pxp_chan->chan_mutex);
+}
+
+static enum dma_status pxp_sw_is_tx_complete(struct dma_chan *chan,
+					     dma_cookie_t cookie,
+					     dma_cookie_t *done,
+					     dma_cookie_t *used)
+{
+	struct pxp_channel *pxp_chan = to_pxp_channel(chan);
+
+	if (done)
+		*done = pxp_chan->completed;
+	if (used)
+		*used = chan->cookie;
+
+	return dma_async_is_complete(cookie, pxp_chan->completed,
+				     chan->cookie);
+}
+
+#ifdef CONFIG_MXC_PXP_SW_SELFTEST
+/*
+ * Conformance check against the hardware: run the same jobs through a
+ * PxP channel and a pxp_sw channel and compare output and histogram.
+ * Covers every supported S0 format, rotation and LUT on a random image
+ * of a size that isn't square, so a transposed result can't pass.
+ */
+#define	PXP_SW_TEST_W		64
+#define	PXP_SW_TEST_H		48
+
+struct pxp_sw_test_job {
+	struct completion done;
+	struct dma_async_tx_descriptor *txd;
+};
+
+static void pxp_sw_test_done(void *arg)
+{
+	complete(&((struct pxp_sw_test_job *)arg)->done);
+}
+
+static int pxp_sw_test_run(struct dma_chan *chan, u32 fmt, int rotate,
+			   int lut, dma_addr_t src_phys, void *src,
+			   dma_addr_t dst_phys, void *dst, u32 *hist_status)
+{
+	struct pxp_sw_test_job job;
+	struct scatterlist sg[2];
+	struct pxp_tx_desc *desc;
+	struct pxp_proc_data *proc_data;
+
+	sg_init_table(sg, 2);
+	sg_dma_address(&sg[0]) = src_phys;
+	sg_dma_address(&sg[1]) = dst_phys;
+
+	job.txd = chan->device->device_prep_slave_sg(chan, sg, 2,
+						     DMA_TO_DEVICE,
+						     DMA_PREP_INTERRUPT);
+	if (!job.txd)
+		return -EIO;
+
+	init_completion(&job.done);
+	job.txd->callback = pxp_sw_test_done;
+	job.txd->callback_param = &job;
+
+	desc = to_tx_desc(job.txd);
+	proc_data = &desc->proc_data;
+	memset(proc_data, 0, sizeof(*proc_data));
+	proc_data->srect.width = proc_data->drect.width = PXP_SW_TEST_W;
+	proc_data->srect.height = proc_data->drect.height = PXP_SW_TEST_H;
+	proc_data->rotate = rotate;
+	proc_data->lut_transform = lut;
+
+	memset(&desc->layer_param.s0_param, 0, sizeof(struct pxp_layer_param));
+	desc->layer_param.s0_param.pixel_fmt = fmt;
+	desc->layer_param.s0_param.width = PXP_SW_TEST_W;
+	desc->layer_param.s0_param.height = PXP_SW_TEST_H;
+	desc->layer_param.s0_param.color_key = -1;
+	desc->layer_param.s0_param.paddr = src_phys;
+	desc->vaddr = src;
+
+	desc = desc->next;
+	memset(&desc->layer_param.out_param, 0,
+	       sizeof(struct pxp_layer_param));
+	desc->layer_param.out_param.pixel_fmt = PXP_PIX_FMT_GREY;
+	desc->layer_param.out_param.width = PXP_SW_TEST_W;
+	desc->layer_param.out_param.height = PXP_SW_TEST_H;
+	desc->layer_param.out_param.paddr = dst_phys;
+	desc->vaddr = dst;
+
+	if (job.txd->tx_submit(job.txd) < 0)
+		return -EIO;
+
+	dma_async_issue_pending(chan);
+
+	if (!wait_for_completion_timeout(&job.done, HZ))
+		return -ETIMEDOUT;
+
+	*hist_status = to_tx_desc(job.txd)->hist_status;
+
+	return 0;
+}
+
+static int __init pxp_sw_selftest(void)
+{
+	static const u32 fmts[] = {
+		PXP_PIX_FMT_GREY, PXP_PIX_FMT_RGB565, PXP_PIX_FMT_RGB32,
+	};
+	struct device *dev = &pxp_sw->pdev->dev;
+	size_t src_size = PXP_SW_TEST_W * PXP_SW_TEST_H * 4;
+	size_t dst_size = PXP_SW_TEST_W * PXP_SW_TEST_H;
+	struct dma_chan *hw_chan, *sw_chan;
+	dma_addr_t src_phys, hw_phys, sw_phys;
+	u8 *src, *hw_out, *sw_out;
+	u32 hw_hist, sw_hist;
+	dma_cap_mask_t mask;
+	int f, rotate, lut, i;
+	int failures = 0;
+
+	if (!pxp_sw)
+		return 0;
+
+	dma_cap_zero(mask);
+	dma_cap_set(DMA_SLAVE, mask);
+	dma_cap_set(DMA_PRIVATE, mask);
+	hw_chan = dma_request_channel(mask, pxp_chan_filter, NULL);
+	sw_chan = dma_request_channel(mask, pxp_chan_filter, (void *)1);
+	if (!hw_chan || !sw_chan) {
+		dev_info(dev, "selftest: no %s channel, skipped\n",
+			 hw_chan ? "pxp_sw" : "PxP");
+		goto release;
+	}
+
+	src = dma_alloc_coherent(dev, src_size, &src_phys, GFP_KERNEL);
+	hw_out = dma_alloc_coherent(dev, dst_size, &hw_phys, GFP_KERNEL);
+	sw_out = dma_alloc_coherent(dev, dst_size, &sw_phys, GFP_KERNEL);
+	if (!src || !hw_out || !sw_out) {
+		failures = -ENOMEM;
+		goto free;
+	}
+
+	for (i = 0; i < src_size; i++)
+		src[i] = random32();
+
+	for (f = 0; f < ARRAY_SIZE(fmts); f++)
+		for (rotate = 0; rotate <= 270; rotate += 90)
+			for (lut = 0; lut < 4; lut++) {
+				memset(hw_out, 0x5A, dst_size);
+				memset(sw_out, 0xA5, dst_size);
+
+				if (pxp_sw_test_run(hw_chan, fmts[f], rotate,
+						    lut, src_phys, src,
+						    hw_phys, hw_out,
+						    &hw_hist) ||
+				    pxp_sw_test_run(sw_chan, fmts[f], rotate,
+						    lut, src_phys, src,
+						    sw_phys, sw_out,
+						    &sw_hist) ||
+				    memcmp(hw_out, sw_out, dst_size) ||
+				    (hw_hist != sw_hist)) {
+					dev_err(dev, "selftest: fmt %08x "
+						"rotate %d lut %d differs\n",
+						fmts[f], rotate, lut);
+					failures++;
+				}
+			}
+
+	dev_info(dev, "selftest: %d failures\n", failures);
+
+free:
+	if (src)
+		dma_free_coherent(dev, src_size, src, src_phys);
+	if (hw_out)
+		dma_free_coherent(dev, dst_size, hw_out, hw_phys);
+	if (sw_out)
+		dma_free_coherent(dev, dst_size, sw_out, sw_phys);
+release:
+	if (hw_chan)
+		dma_release_channel(hw_chan);
+	if (sw_chan)
+		dma_release_channel(sw_chan);
+
+	return 0;
+}
+/* After the PxP itself has probed */
+late_initcall(pxp_sw_selftest);
+#endif
+
+static int __init pxp_sw_init(void)
+{
+	struct dma_device *dma;
+	int i, ret;
+
+	pxp_sw = kzalloc(sizeof(*pxp_sw), GFP_KERNEL);
+	if (!pxp_sw)
+		return -ENOMEM;
+
+	pxp_sw->pdev = platform_device_register_simple(PXP_SW_DEV_NAME, -1,
+						       NULL, 0);
+	if (IS_ERR(pxp_sw->pdev)) {
+		ret = PTR_ERR(pxp_sw->pdev);
+		goto err_free;
+	}
+	pxp_sw->pdev->dev.coherent_dma_mask = DMA_BIT_MASK(32);
+
+	pxp_sw_tables_init();
+
+	dma = &pxp_sw->dma;
+	dma_cap_set(DMA_SLAVE, dma->cap_mask);
+	dma_cap_set(DMA_PRIVATE, dma->cap_mask);
+
+	dma->dev = &pxp_sw->pdev->dev;
+	dma->device_alloc_chan_resources = pxp_sw_alloc_chan_resources;
+	dma->device_free_chan_resources = pxp_sw_free_chan_resources;
+	dma->device_is_tx_complete = pxp_sw_is_tx_complete;
+	dma->device_issue_pending = pxp_sw_issue_pending;
+	dma->device_prep_slave_sg = pxp_sw_prep_slave_sg;
+	dma->device_terminate_all = pxp_sw_terminate_all;
+
+	INIT_LIST_HEAD(&dma->channels);
+	for (i = 0; i < NR_PXP_VIRT_CHANNEL; i++) {
+		struct pxp_channel *pxp_chan = pxp_sw->channel + i;
+		struct dma_chan *dma_chan = &pxp_chan->dma_chan;
+
+		spin_lock_init(&pxp_chan->lock);
+		mutex_init(&pxp_chan->chan_mutex);
+		INIT_LIST_HEAD(&pxp_chan->list);
+		pxp_chan->status = PXP_CHANNEL_FREE;
+		pxp_chan->completed = -ENXIO;
+
+		dma_chan->device = dma;
+		dma_chan->cookie = 1;
+		dma_chan->chan_id = i;
+		list_add_tail(&dma_chan->device_node, &dma->channels);
+	}
+
+	ret = dma_async_device_register(dma);
+	if (ret)
+		goto err_unregister;
+
+	return 0;
+
+err_unregister:
+	platform_device_unregister(pxp_sw->pdev);
+err_free:
+	kfree(pxp_sw);
+	pxp_sw = NULL;
+	return ret;
+}
+subsys_initcall(pxp_sw_init);
+
+MODULE_DESCRIPTION("CPU implementation of the PxP subset used by the EPDC");
+MODULE_LICENSE("GPL");
@@ -65,6 +65,7 @@
 #define BS_SFM_PAGE_SIZE        256
 #define BS_SFM_PAGE_COUNT_128K  (BS_SFM_SECTOR_SIZE_128K/BS_SFM_PAGE_SIZE)
 #define BS_SFM_PAGE_COUNT_256K  (BS_SFM_SECTOR_SIZE_256K/BS_SFM_PAGE_SIZE)
+#define BS_SFM_WIP_POLLS        64      // Page programs typically finish well within these.
 
 #define BS_PANEL_ID_ISIS_MARIO  "V110_035_60_M01"
 #define BS_PANEL_ID_ISIS_LUIGI  "????_???_??_???"
@@ -96,9 +97,12 @@ static int bs_sfm_size = BS_SFM_SIZE_128K;
 static int bs_sfm_page_count = BS_SFM_PAGE_COUNT_128K;
 static int bs_tst_addr = BS_TST_ADDR_128K;
 static char sd[BS_SFM_SIZE_256K];
-static char *rd = &sd[0];
+static char so[BS_SFM_SECTOR_SIZE_256K];
+static char sp[BS_SFM_PAGE_SIZE];
 static int sfm_cd;
 
+static bs_sfm_stats_t bs_sfm_stats;
+
 static char bs_panel_bcd[BS_PANEL_BCD_SIZE] = { 0 };
 static char bs_panel_id[BS_PANEL_ID_SIZE] = { 0 };
 static char bs_vcom_str[BS_VCOM_SIZE] = { 0 };
@@ -394,20 +398,24 @@ static bs_cmd bs_poll_cmds[] =
 
 static unsigned long bs_set_ld_img_start;
 static unsigned long bs_ld_img_start;
+static unsigned long bs_upd_pipe_start;
 static unsigned long bs_upd_data_start;
+static bool bs_upd_pipe_started;
 
 static unsigned long bs_image_start_time;
 static unsigned long bs_image_processing_time;
 static unsigned long bs_image_loading_time;
 static unsigned long bs_image_display_time;
 static unsigned long bs_image_stop_time;
+static unsigned long bs_image_overlap_time;
 
 #define BS_IMAGE_TIMING_START   0
 #define BS_IMAGE_TIMING_PROC    1
 #define BS_IMAGE_TIMING_LOAD    2
 #define BS_IMAGE_TIMING_DISP    3
 #define BS_IMAGE_TIMING_STOP    4
-#define BS_NUM_IMAGE_TIMINGS    (BS_IMAGE_TIMING_STOP + 1)
+#define BS_IMAGE_TIMING_OVLP    5
+#define BS_NUM_IMAGE_TIMINGS    (BS_IMAGE_TIMING_OVLP + 1)
 static unsigned long bs_image_timings[BS_NUM_IMAGE_TIMINGS];
 
 static u8 bs_4bpp_nybble_swap_table_inverted[256] =
@@ -1829,6 +1837,26 @@ static bool bs_sfs_read_ready(void *unused)
     return ( (bs_sfm_read_status() & 0x1) == 0 );
 }
 
+// The flash keeps shifting its status register out for as long as chip select stays
+// asserted after an RDSR, so poll WIP in one transaction and only fall back to
+// yielding the CPU if the flash is still busy after that.
+//
+static void bs_sfm_wait_for_wip(int polls)
+{
+    bool ready = false;
+
+    BSC_WR_REG(0x0208, 1);
+    bs_sfm_wr_byte(BS_SFM_RDSR);
+
+    while ( !ready && polls-- )
+        ready = (bs_sfm_rd_byte() & 0x1) == 0;
+
+    BSC_WR_REG(0x0208, 0);
+
+    if ( !ready )
+        EINKFB_SCHEDULE_TIMEOUT_INTERRUPTIBLE(BS_SFM_TIMEOUT, bs_sfs_read_ready);
+}
+
 static void bs_sfm_erase(int addr)
 {
     einkfb_debug_full( "... erasing sector (0x%08X)\n", addr);
@@ -1861,93 +1889,131 @@ static void bs_sfm_program_page(int pa, int size, char *data)
 
     BSC_WR_REG(0x0208, 0);
 
-    EINKFB_SCHEDULE_TIMEOUT_INTERRUPTIBLE(BS_SFM_TIMEOUT, bs_sfs_read_ready);
-    bs_sfm_write_disable();
+    // The write-enable latch clears itself once the program completes.
+    //
+    bs_sfm_wait_for_wip(BS_SFM_WIP_POLLS);
 }
 
-static void bs_sfm_program_sector(int sa, int size, char *data)
+// Bring a sector from what it holds (old) to what it should hold (new).  Sectors
+// that already match are left alone.  Sectors whose new contents only clear bits
+// are programmed without an erase.  Otherwise, the sector is erased.  Either
+// way, only the pages that differ from what's in the flash get programmed, and
+// each programmed page is read back and checked.
+//
+static bool bs_sfm_program_sector(int sa, char *old, char *new)
 {
-    int p, y, pa = sa;
+    int i, p, pa;
+    bool erase = false, same = true, valid = true;
 
-    einkfb_debug_full( "... programming sector (0x%08X)\n", sa);
-
-    for ( p = 0; p < bs_sfm_page_count; p++ )
+    for ( i = 0; (i < bs_sfm_sector_size) && !erase; i++ )
     {
-        y = p * BS_SFM_PAGE_SIZE;
-        bs_sfm_program_page(pa, BS_SFM_PAGE_SIZE, &data[y]);
-        pa += BS_SFM_PAGE_SIZE;
-    }
-}
+        if ( old[i] != new[i] )
+        {
+            same = false;
 
-static void BS_SFM_WRITE(int addr, int size, char *data)
-{
-    int s1 = addr/bs_sfm_sector_size,
-        s2 = (addr + size - 1)/bs_sfm_sector_size,
-        x, i, s, sa, start, limit, count;
+            if ( (old[i] & new[i]) != new[i] )
+                erase = true;
+        }
+    }
 
-    for ( x = 0, s = s1; s <= s2; s++ )
+    if ( same )
     {
-        sa    = s * bs_sfm_sector_size;
-        start = 0;
-        count = bs_sfm_sector_size;
+        einkfb_debug_full( "... skipping sector (0x%08X)\n", sa);
+        bs_sfm_stats.sectors_skipped++;
+        bs_sfm_stats.pages_skipped += bs_sfm_page_count;
+    }
+    else
+    {
+        einkfb_debug_full( "... programming sector (0x%08X), erase = %d\n", sa, erase);
 
-        if ( s == s1 )
+        if ( erase )
         {
-            if ( addr > sa )
-            {
-	            start = addr - sa;
-	            bs_sfm_read(sa, start, sd);
-            }
+            bs_sfm_erase(sa);
+            einkfb_memset(old, 0xFF, bs_sfm_sector_size);
         }
+        else
+            bs_sfm_stats.sectors_unerased++;
 
-        if ( s == s2 )
+        for ( p = 0, pa = sa; p < bs_sfm_sector_size; p += BS_SFM_PAGE_SIZE, pa += BS_SFM_PAGE_SIZE )
         {
-            limit = addr + size;
-
-            if ( (sa + bs_sfm_sector_size) > limit )
+            if ( memcmp(&old[p], &new[p], BS_SFM_PAGE_SIZE) )
             {
-	            count = limit - sa;
-	            bs_sfm_read(limit, (sa + bs_sfm_sector_size - limit), &sd[count]);
+                bs_sfm_program_page(pa, BS_SFM_PAGE_SIZE, &new[p]);
+                bs_sfm_stats.pages_programmed++;
+
+                bs_sfm_read(pa, BS_SFM_PAGE_SIZE, sp);
+
+                if ( memcmp(sp, &new[p], BS_SFM_PAGE_SIZE) )
+                {
+                    einkfb_debug_full( "+++++++++++++++ page 0x%08X failed to verify\n", pa);
+                    bs_sfm_stats.pages_failed++;
+                    valid = false;
+                }
             }
+            else
+                bs_sfm_stats.pages_skipped++;
         }
 
-        bs_sfm_erase(sa);
+        bs_sfm_write_disable();
+    }
+
+    return ( valid );
+}
+
+static bool BS_SFM_WRITE(int addr, int size, char *data)
+{
+    int s1 = addr/bs_sfm_sector_size,
+        s2 = (addr + size - 1)/bs_sfm_sector_size,
+        x, s, sa, start, count;
+    bool valid = true;
+
+    bs_sfm_stats.sectors_total = (s2 - s1) + 1;
+
+    for ( x = 0, s = s1; s <= s2; s++ )
+    {
+        sa    = s * bs_sfm_sector_size;
+        start = (s == s1) ? (addr - sa) : 0;
+        count = (s == s2) ? ((addr + size) - sa) : bs_sfm_sector_size;
+
+        // What's in the sector now is both what we preserve around the data and
+        // what we compare the new sector against.
+        //
+        bs_sfm_read(sa, bs_sfm_sector_size, so);
 
-        for ( i = start; i < count; i++ )
-            sd[i] = data[x++];
+        EINKFB_MEMCPYK(sd, so, bs_sfm_sector_size);
+        EINKFB_MEMCPYK(&sd[start], &data[x], (count - start));
+        x += count - start;
 
-        bs_sfm_program_sector(sa, bs_sfm_sector_size, sd);
+        valid &= bs_sfm_program_sector(sa, so, sd);
+        bs_sfm_stats.sectors_done++;
     }
+
+    return ( valid );
 }
 
 void bs_sfm_write(int addr, int size, char *data)
 {
+    unsigned long start_time = jiffies;
     bool valid;
-    int i;
 
     einkfb_debug_full( "... writing the serial flash memory (address=0x%08X, size=%d)\n", addr, size);
-    einkfb_memset(sd, 0, bs_sfm_size);
-    BS_SFM_WRITE(addr, size, data);
+    einkfb_memset(&bs_sfm_stats, 0, sizeof(bs_sfm_stats_t));
+    bs_sfm_stats.bytes = size;
 
-    einkfb_debug_full( "... verifying the serial flash memory write\n");
-    einkfb_memset(rd, 0, bs_sfm_size);
-    bs_sfm_read(addr, size, rd);
-
-    for ( i = 0, valid = true; (i < size) && valid; i++ )
-    {
-        if ( rd[i] != data[i] )
-        {
-            einkfb_debug_full( "+++++++++++++++ rd[%d]=0x%02x  data[%d]=0x%02x\n", i, rd[i], i, data[i]);
-            valid = false;
-        }
-    }
+    valid = BS_SFM_WRITE(addr, size, data);
 
+    bs_sfm_stats.msecs = jiffies_to_msecs(jiffies - start_time);
     einkfb_debug_full( "... writing the serial flash memory --- done\n");
 
     if ( !valid )
         einkfb_print_crit("Failed to verify write of Broadsheet Flash.\n");
 }
 
+bs_sfm_stats_t *bs_sfm_get_stats(void)
+{
+    return ( &bs_sfm_stats );
+}
+
 #if PRAGMAS
     #pragma mark -
     #pragma mark Broadsheet Host Interface Helper API
@@ -1994,11 +2060,100 @@ enum bs_ld_img_data_t
 };
 typedef enum bs_ld_img_data_t bs_ld_img_data_t;
 
-static u16 bs_ld_img_data(u8 *data, bool upd_area, bool upd_fast, u16 x, u16 y, u16 w, u16 h)
+// The slow path stretches the image into stripes of BS_LD_IMG_STRIPE_ROWS rows,
+// alternating between the two halves of the scratch buffer, and hands each finished
+// stripe to the host interface in one go (DMA when the controller layer has it,
+// buffered PIO otherwise) instead of a word at a time.
+//
+// When the caller allows it (non-flashing area updates), each stripe is also loaded
+// as its own area and, once loaded, kicked off with a partial update.  That way, the
+// controller is already driving the top of the image while we're still stretching
+// and loading the bottom of it.  The last stripe is left to the caller's normal
+// update, which covers the whole area.
+//
+#define BS_LD_IMG_STRIPE_ROWS   64
+#define BS_LD_IMG_STRIPES_MIN   2
+
+static inline u8 bs_ld_img_pixels(u8 s, u32 bpp, bool isis, u16 *upd_mode)
+{
+    // Accumulate the update mode.
+    //
+    *upd_mode = BS_FIND_UPD_MODE(*upd_mode, s, bpp);
+
+    // Invert (4/8bpp) and/or nybble-swap (4bpp) the pixels going out to the
+    // controller on Broadsheet, but not on ISIS.
+    //
+    return ( isis ? s : (EINKFB_8BPP == bpp) ? ~s : bs_4bpp_nybble_swap_table_inverted[s] );
+}
+
+static int bs_ld_img_stretch_row(u8 *dst, u8 *src, int src_bytes, u32 bpp, bool isis, u16 *upd_mode)
+{
+    int i, j;
+    u8 s;
+
+    for ( i = j = 0; i < src_bytes; i++ )
+    {
+        s = src[i];
+
+        // If the source pixels aren't already at 4/8bpp, get them there.
+        //
+        switch ( bpp )
+        {
+            case EINKFB_2BPP:
+                dst[j++] = bs_ld_img_pixels(STRETCH_HI_NYBBLE(s, bpp), bpp, isis, upd_mode);
+                dst[j++] = bs_ld_img_pixels(STRETCH_LO_NYBBLE(s, bpp), bpp, isis, upd_mode);
+            break;
+
+            default:
+                dst[j++] = bs_ld_img_pixels(s, bpp, isis, upd_mode);
+            break;
+        }
+    }
+
+    return ( j );
+}
+
+static void bs_ld_img_stripe_wr(u8 *stripe, int bytes)
+{
+    // The controller layer clears the physical address after each transfer, so point
+    // it at the stripe we're sending each time through.
+    //
+    if ( broadsheet_needs_dma() )
+        bs_phys_addr = broadsheet_get_scratchfb_phys() + (stripe - broadsheet_get_scratchfb());
+    else
+        bs_clear_phys_addr();
+
+    BS_WR_DATA((bytes >> 1), (u16 *)stripe);
+}
+
+static void bs_ld_img_stripe_upd(u16 upd_mode, u16 x, u16 y, u16 w, u16 h)
+{
+    u16 override_upd_mode = (u16)broadsheet_get_override_upd_mode();
+
+    if ( BS_UPD_MODE_INIT != override_upd_mode )
+    {
+        upd_mode = BS_UPD_MODE(override_upd_mode);
+
+        if ( BS_ISIS() )
+            bs_cmd_set_wf_auto_sel_mode(0);
+    }
+
+    if ( !bs_upd_pipe_started )
+    {
+        bs_upd_pipe_start = jiffies;
+        bs_upd_pipe_started = true;
+    }
+
+    bs_cmd_upd_part_area(upd_mode, 0, 0, x, y, w, h);
+    bs_cmd_wait_dspe_trg();
+}
+
+static u16 bs_ld_img_data(u8 *data, bool upd_area, bool upd_fast, bool upd_pipe, u16 x, u16 y, u16 w, u16 h)
 {
     bs_ld_img_data_t bs_ld_img_data_which = bs_ld_img_data_slow;
     u16 upd_mode = 0, dfmt = 0;
-    int i, data_size = 0;
+    int data_size = 0;
+    bool ld_img_ended = false;
 
     struct einkfb_info info;
     einkfb_get_info(&info);
@@ -2048,14 +2203,26 @@ static u16 bs_ld_img_data(u8 *data, bool upd_area, bool upd_fast, u16 x, u16 y,
         }
     }
 
+    // Only the slow path pipelines, and only when there's enough of the image to be
+    // worth splitting up.
+    //
+    if ( (bs_ld_img_data_slow != bs_ld_img_data_which) || !upd_area ||
+         ((BS_LD_IMG_STRIPE_ROWS * BS_LD_IMG_STRIPES_MIN) > h) )
+        upd_pipe = false;
+
     // Convert fast updates to area updates to reduce the amount of data we must transmit
     // to the hardware as well deal with the slop issues (i.e., 824 vs. 825) on the
     // 9.7-inch-sized displays.
     //
-    if ( upd_area || upd_fast )
-        bs_cmd_ld_img_area(dfmt, x, y, w, h);
-    else
-        bs_cmd_ld_img(dfmt);
+    // Note:  When pipelining, each stripe is loaded as its own area below.
+    //
+    if ( !upd_pipe )
+    {
+        if ( upd_area || upd_fast )
+            bs_cmd_ld_img_area(dfmt, x, y, w, h);
+        else
+            bs_cmd_ld_img(dfmt);
+    }
 
     bs_ld_img_start = jiffies;
 
@@ -2068,12 +2235,12 @@ static u16 bs_ld_img_data(u8 *data, bool upd_area, bool upd_fast, u16 x, u16 y,
 
         case bs_ld_img_data_slow:
         {
-            u8 white = broadsheet_pixels(info.bpp, einkfb_white(info.bpp)), *controller_data = broadsheet_get_scratchfb();
-            int j, k, l = 0, m = 0, n = 0;
-            unsigned char s, pixels[2];
+            u8 white = broadsheet_pixels(info.bpp, einkfb_white(info.bpp)), *controller_data = broadsheet_get_scratchfb(),
+               *stripe;
+            int j = 0, k, m = 0, n = 0, row, rows, stripe_rows, src_rowbytes, rowbytes, buf_size, which = 0;
+            bool isis = BS_ISIS();
 
             upd_mode = BS_INIT_UPD_MODE();
-            bs_wr_one_ready();
 
             // Determine the hardware slop factors for non-area updates.
             //
@@ -2093,100 +2260,86 @@ static u16 bs_ld_img_data(u8 *data, bool upd_area, bool upd_fast, u16 x, u16 y,
                 }
             }
 
-            // Make BPP-specific adjustments.
+            // Size the stripes so that two of them (plus the slop and an odd byte carried
+            // over from the previous stripe) fit into the scratch buffer.
             //
-            w = BPP_SIZE(w, info.bpp);
+            src_rowbytes = BPP_SIZE(w, info.bpp);
+            rowbytes     = ((EINKFB_2BPP == info.bpp) ? (src_rowbytes << 1) : src_rowbytes) + m;
 
-            switch ( info.bpp )
-            {
-                case EINKFB_8BPP:
-                case EINKFB_4BPP:
-                    l = 1;
-                break;
+            stripe_rows  = ((int)(broadsheet_get_scratchfb_size() >> 1) - n - 2) / max(rowbytes, 1);
+            stripe_rows  = min(stripe_rows, BS_LD_IMG_STRIPE_ROWS) & ~1;
+            stripe_rows  = max(stripe_rows, 1);
 
-                case EINKFB_2BPP:
-                    l = 2;
-                break;
-            }
+            buf_size     = ((stripe_rows * rowbytes) + n + 2) & ~1;
 
-            for ( i = j = 0; i < data_size; )
+            for ( row = 0; row < h; row += rows )
             {
-                // First, get the source pixel(s).
-                //
-                s = data[i];
+                rows   = min(stripe_rows, (h - row));
+                stripe = &controller_data[which * buf_size];
 
-                // Next, if they're not already at 4/8bpp, get them there.
+                // Stretch the stripe, handling the horizontal hardware slop factor when
+                // necessary.
                 //
-                switch ( info.bpp )
+                for ( k = 0; k < rows; k++ )
                 {
-                    case EINKFB_8BPP:
-                    case EINKFB_4BPP:
-                        pixels[0] = s;
-                    break;
+                    j += bs_ld_img_stretch_row(&stripe[j], &data[(row + k) * src_rowbytes],
+                        src_rowbytes, info.bpp, isis, &upd_mode);
 
-                    case EINKFB_2BPP:
-                        pixels[0] = STRETCH_HI_NYBBLE(s, info.bpp);
-                        pixels[1] = STRETCH_LO_NYBBLE(s, info.bpp);
-                    break;
+                    einkfb_memset(&stripe[j], white, m);
+                    j += m;
                 }
 
-                // Now, get the 4/8bpp pixels to their destination in the right
-                // format.
+                // Handle the vertical slop factor when necessary.
                 //
-                for ( k = 0; k < l; k++ )
+                if ( (row + rows) == h )
                 {
-                    // Get pixels.
-                    //
-                    s = pixels[k];
+                    einkfb_memset(&stripe[j], white, n);
+                    j += n;
+                }
 
-                    // Accumulate the update mode.
+                if ( upd_pipe )
+                {
+                    // Load the stripe as its own area and, unless it's the last one,
+                    // start updating it while we go on to the next one.
                     //
-                    upd_mode = BS_FIND_UPD_MODE(upd_mode, s, info.bpp);
+                    bs_cmd_ld_img_area(dfmt, x, (y + row), w, rows);
+                    bs_ld_img_stripe_wr(stripe, j);
+                    bs_cmd_ld_img_end();
 
-                    // Invert (4/8bpp) and/or nybble-swap (4bpp) the pixels going out to the
-                    // controller on Broadsheet, but not on ISIS.
-                    //
-                    controller_data[j++] = BS_ISIS() ? s : (EINKFB_8BPP == info.bpp) ? ~s :
-                        bs_4bpp_nybble_swap_table_inverted[s];
+                    if ( (row + rows) < h )
+                        bs_ld_img_stripe_upd(BS_DONE_UPD_MODE(upd_mode), x, (y + row), w, rows);
 
-                    if ( 0 == (j % 2) )
-                        bs_wr_one(*((u16 *)&controller_data[j-2]));
+                    j = 0;
                 }
-
-                // Finally, determine what's next.
-                //
-                if ( 0 == (++i % w) )
+                else
                 {
-                    // Handle the horizontal hardware slop factor when necessary.
+                    // Send the whole words we have, and carry any odd byte over to the
+                    // start of the other stripe.
                     //
-                    for ( k = 0; k < m; k++ )
-                    {
-                        controller_data[j++] = white;
+                    bs_ld_img_stripe_wr(stripe, j);
 
-                        if ( 0 == (j % 2) )
-                            bs_wr_one(*((u16 *)&controller_data[j-2]));
+                    if ( j & 1 )
+                    {
+                        controller_data[(which ^ 1) * buf_size] = stripe[j-1];
+                        j = 1;
                     }
+                    else
+                        j = 0;
                 }
 
-                EINKFB_SCHEDULE_BLIT(i+1);
-            }
-
-            // Handle the vertical slop factor when necessary.
-            //
-            for ( k = 0; k < n; k++ )
-            {
-                controller_data[j++] = white;
-
-                if ( 0 == (j % 2) )
-                    bs_wr_one(*((u16 *)&controller_data[j-2]));
+                which ^= 1;
+                EINKFB_SCHEDULE();
             }
 
+            bs_clear_phys_addr();
             upd_mode = BS_DONE_UPD_MODE(upd_mode);
+            ld_img_ended = upd_pipe;
         }
         break;
     }
 
-    bs_cmd_ld_img_end();
+    if ( !ld_img_ended )
+        bs_cmd_ld_img_end();
 
     bs_debug_upd_mode(upd_mode);
 
@@ -2430,12 +2583,14 @@ void bs_cmd_bypass_vcom_enable(int v)
 #define IMAGE_TIMING_LOAD_TYPE  2
 #define IMAGE_TIMING_DISP_TYPE  3
 #define IMAGE_TIMING_STOP_TYPE  4
+#define IMAGE_TIMING_OVLP_TYPE  5
 
 #define IMAGE_TIMING            "image_timing"
 #define IMAGE_TIMING_STRT_NAME  "strt"
 #define IMAGE_TIMING_PROC_NAME  "proc"
 #define IMAGE_TIMING_LOAD_NAME  "load"
 #define IMAGE_TIMING_DISP_NAME  "disp"
+#define IMAGE_TIMING_OVLP_NAME  "ovlp"
 
 static void einkfb_print_image_timing(unsigned long time, int which)
 {
@@ -2457,6 +2612,10 @@ static void einkfb_print_image_timing(unsigned long time, int which)
 
         case IMAGE_TIMING_DISP_TYPE:
             name =  IMAGE_TIMING_DISP_NAME;
+        goto relative_common;
+
+        case IMAGE_TIMING_OVLP_TYPE:
+            name =  IMAGE_TIMING_OVLP_NAME;
         /* goto relative_common; */
 
         relative_common:
@@ -2469,6 +2628,158 @@ static void einkfb_print_image_timing(unsigned long time, int which)
     }
 }
 
+static void bs_upd_data_set_temp(fx_type local_update_mode)
+{
+    int  temp = broadsheet_get_temperature();
+    bool set_temp = false;
+    
+    // Check to see whether we need to externally drive the temperature and
+    // manually drive VCOM.
+    //
+    if ( BS_HAS_PMIC() )
+    {
+        bs_pmic_set_power_state(bs_pmic_power_state_active);
+        set_temp = true;
+        
+        // Check to see whether we should get the temperature from Papyrus or not.
+        //
+        if ( !IN_RANGE(temp, BS_TEMP_MIN, BS_TEMP_MAX) )
+        {
+            int  temp_batt = get_battery_temperature();
+            bool temp_batt_in_use = false;
+            
+            // Papyrus has an issue where it can potentially get stuck returning
+            // a temperature that's outside both the acceptable as well the
+            // ideal temperature range.
+            //
+            temp = BS_GET_TEMP_CACHED();
+            
+            // To get around the problem where Papyrus is stuck returning a
+            // bogus (-10C) temperature...
+            //
+            if ( BS_TEMP_STUCK == temp )
+            {
+                // ...use the battery's temperature if it's in range.
+                //
+                // Notes: Only log the bogus Papyrus temperature on
+                //        flashing updates to keep the logging traffic
+                //        to a relative minimum.
+                //
+                //        If we're clipping the temperature and the
+                //        temperature that the battery returns needs
+                //        to be clipped, that will still happen.
+                //
+                //        If the battery's temperature is also out
+                //        of range, we'll just leave things alone:
+                //        maybe it really is very cold!
+                //
+                //        We do this for both non-flashing and flashing
+                //        updates since Papyrus is presumably stuck
+                //        returning a bogus value.
+                //
+                if ( fx_update_full == local_update_mode )
+                {
+                    einkfb_print_warn(PMIC_TEMP_FORMAT_WARN_C_m_M, temp, BS_TEMP_MIN_IDEAL,
+                        BS_TEMP_MAX_IDEAL);
+                }
+                
+                if ( IN_RANGE(temp_batt, BS_TEMP_MIN, BS_TEMP_MAX) )
+                {
+                    temp_batt_in_use = true;
+                    temp = temp_batt;
+                }
+            }
+            
+            if ( bs_clip_temp && !IN_RANGE(temp, BS_TEMP_MIN_IDEAL, BS_TEMP_MAX_IDEAL) )
+            {
+                // Only warn/clip that we're outside of the ideal temperature range when we
+                // get a flashing (page-turn-like) update.
+                //
+                if ( fx_update_full == local_update_mode )
+                {
+                    log_battery_temperature();
+                    
+                    einkfb_print_warn(PMIC_TEMP_FORMAT_WARN_C_m_M, temp, BS_TEMP_MIN_IDEAL,
+                        BS_TEMP_MAX_IDEAL);
+
+                    // Papyrus is showing that we're outside the ideal temperature range.  If
+                    // it's hotter than the ideal temperature range, we're going to clip it.
+                    //
+                    if ( BS_TEMP_MAX_IDEAL < temp )
+                    {
+                        // If the battery temperature is in the ideal range...
+                        //
+                        if ( IN_RANGE(temp_batt, BS_TEMP_MIN_IDEAL, BS_TEMP_MAX_IDEAL) )
+                        {
+                            // ...and it's less than what Papyrus is showing, use it.
+                            //
+                            if ( BS_TEMP_MAX_IDEAL > temp_batt )
+                            {
+                                einkfb_print_warn(BATTERY_TEMP_FORMAT_C, temp_batt);
+                                temp = temp_batt;
+                            }
+                        }
+                        
+                        // Clip it to max if necessary.
+                        //
+                        if ( BS_TEMP_MAX_IDEAL < temp )
+                        {
+                            einkfb_print_warn(CLIPPED_TEMP_FORMAT_C, BS_TEMP_MAX_IDEAL);
+                            temp = BS_TEMP_MAX_IDEAL;
+                        }
+                    }
+                }
+            }
+            else
+            {
+                char *which = temp_batt_in_use ? TEMP_WHICH_C_BATT : TEMP_WHICH_C_PMIC;
+                
+                // We now always want to log the temperature on flashing (page-turn like)
+                // updates.
+                //
+                // Note:  If we substituted the battery's temperature for that of 
+                //        Papyrus because Papyrus is stuck returning a bogus one,
+                //        we'll see both the bogus tempature and the substitute
+                //        in the log.
+                //
+                if ( fx_update_full == local_update_mode )
+                {
+                    einkfb_print_info(TEMP_FORMAT_C_WHICH, temp, which);
+                }
+                else
+                    einkfb_debug(TEMP_FORMAT_C_WHICH, temp, which);
+            }
+        }
+        else
+        {
+            if ( fx_update_full == local_update_mode )
+            {
+                einkfb_print_info(OVERRIDE_TEMP_FORMAT_C, temp);
+            }
+            else
+                einkfb_debug(OVERRIDE_TEMP_FORMAT_C, temp);
+        }
+
+        BS_VCOM_ALWAYS_ON();
+    }
+    else
+    {
+        // Check to see whether we're manually overriding the temperature.
+        //
+        if ( IN_RANGE(temp, BS_TEMP_MIN, BS_TEMP_MAX) )
+        {
+            bs_cmd_wr_reg(BS_TEMP_DEV_SELECT_REG, BS_TEMP_DEV_EXT);
+            einkfb_debug(OVERRIDE_TEMP_FORMAT_C, temp);
+            set_temp = true;
+        }
+        else
+            bs_cmd_wr_reg(BS_TEMP_DEV_SELECT_REG, BS_TEMP_DEV_INT);
+    }
+    
+    if ( set_temp )
+        bs_cmd_wr_reg(BS_TEMP_VALUE_REG, (u16)temp);
+}
+
 static void bs_cmd_ld_img_upd_data_which(bs_cmd cmd, fx_type update_mode, u8 *data, u16 x, u16 y, u16 w, u16 h)
 {
     if ( data )
@@ -2478,7 +2789,9 @@ static void bs_cmd_ld_img_upd_data_which(bs_cmd cmd, fx_type update_mode, u8 *da
                 skip_buffer_display = false,
                 skip_buffer_load = false,
                 wait_dspe_frend = false,
-                upd_fast = false;
+                upd_fast = false,
+                upd_pipe = false,
+                temp_set = false;
         
         u16     upd_mode = bs_upd_mode;
         fx_type local_update_mode;
@@ -2489,6 +2802,7 @@ static void bs_cmd_ld_img_upd_data_which(bs_cmd cmd, fx_type update_mode, u8 *da
         // Set up to process, load, and/or display the image data.
         //
         bs_set_ld_img_start = jiffies;
+        bs_upd_pipe_started = false;
 
         switch ( update_mode )
         {
@@ -2566,10 +2880,22 @@ static void bs_cmd_ld_img_upd_data_which(bs_cmd cmd, fx_type update_mode, u8 *da
                 bs_cmd_wait_dspe_frend();
             }
 
+            // Non-flashing area updates can be pipelined:  the controller may start
+            // updating the stripes that have been loaded while the rest are still being
+            // loaded.  Since that happens before we get to the display step below, set
+            // up the temperature now.
+            //
+            if ( upd_area && !skip_buffer_display && !UPD_MODE_INIT(upd_mode) &&
+                 !UPDATE_AREA_FULL(local_update_mode) )
+            {
+                bs_upd_data_set_temp(local_update_mode);
+                temp_set = upd_pipe = true;
+            }
+
             // Load the image data into the controller, determining what the non-flashing
             // upd_mode would be.
             //
-            bs_upd_mode = bs_ld_img_data(data, upd_area, upd_fast, x, y, w, h);
+            bs_upd_mode = bs_ld_img_data(data, upd_area, upd_fast, upd_pipe, x, y, w, h);
         }
 
         // Update the display in the specified way (upd_mode || bs_upd_mode) if we should.
@@ -2578,154 +2904,8 @@ static void bs_cmd_ld_img_upd_data_which(bs_cmd cmd, fx_type update_mode, u8 *da
 
         if ( !skip_buffer_display )
         {
-            int  temp = broadsheet_get_temperature();
-            bool set_temp = false;
-            
-            // Check to see whether we need to externally drive the temperature and
-            // manually drive VCOM.
-            //
-            if ( BS_HAS_PMIC() )
-            {
-                bs_pmic_set_power_state(bs_pmic_power_state_active);
-                set_temp = true;
-                
-                // Check to see whether we should get the temperature from Papyrus or not.
-                //
-                if ( !IN_RANGE(temp, BS_TEMP_MIN, BS_TEMP_MAX) )
-                {
-                    int  temp_batt = get_battery_temperature();
-                    bool temp_batt_in_use = false;
-                    
-                    // Papyrus has an issue where it can potentially get stuck returning
-                    // a temperature that's outside both the acceptable as well the
-                    // ideal temperature range.
-                    //
-                    temp = BS_GET_TEMP_CACHED();
-                    
-                    // To get around the problem where Papyrus is stuck returning a
-                    // bogus (-10C) temperature...
-                    //
-                    if ( BS_TEMP_STUCK == temp )
-                    {
-                        // ...use the battery's temperature if it's in range.
-                        //
-                        // Notes: Only log the bogus Papyrus temperature on
-                        //        flashing updates to keep the logging traffic
-                        //        to a relative minimum.
-                        //
-                        //        If we're clipping the temperature and the
-                        //        temperature that the battery returns needs
-                        //        to be clipped, that will still happen.
-                        //
-                        //        If the battery's temperature is also out
-                        //        of range, we'll just leave things alone:
-                        //        maybe it really is very cold!
-                        //
-                        //        We do this for both non-flashing and flashing
-                        //        updates since Papyrus is presumably stuck
-                        //        returning a bogus value.
-                        //
-                        if ( fx_update_full == local_update_mode )
-                        {
-                            einkfb_print_warn(PMIC_TEMP_FORMAT_WARN_C_m_M, temp, BS_TEMP_MIN_IDEAL,
-                                BS_TEMP_MAX_IDEAL);
-                        }
-                        
-                        if ( IN_RANGE(temp_batt, BS_TEMP_MIN, BS_TEMP_MAX) )
-                        {
-                            temp_batt_in_use = true;
-                            temp = temp_batt;
-                        }
-                    }
-                    
-                    if ( bs_clip_temp && !IN_RANGE(temp, BS_TEMP_MIN_IDEAL, BS_TEMP_MAX_IDEAL) )
-                    {
-                        // Only warn/clip that we're outside of the ideal temperature range when we
-                        // get a flashing (page-turn-like) update.
-                        //
-                        if ( fx_update_full == local_update_mode )
-                        {
-                            log_battery_temperature();
-                            
-                            einkfb_print_warn(PMIC_TEMP_FORMAT_WARN_C_m_M, temp, BS_TEMP_MIN_IDEAL,
-                                BS_TEMP_MAX_IDEAL);
-
-                            // Papyrus is showing that we're outside the ideal temperature range.  If
-                            // it's hotter than the ideal temperature range, we're going to clip it.
-                            //
-                            if ( BS_TEMP_MAX_IDEAL < temp )
-                            {
-                                // If the battery temperature is in the ideal range...
-                                //
-                                if ( IN_RANGE(temp_batt, BS_TEMP_MIN_IDEAL, BS_TEMP_MAX_IDEAL) )
-                                {
-                                    // ...and it's less than what Papyrus is showing, use it.
-                                    //
-                                    if ( BS_TEMP_MAX_IDEAL > temp_batt )
-                                    {
-                                        einkfb_print_warn(BATTERY_TEMP_FORMAT_C, temp_batt);
-                                        temp = temp_batt;
-                                    }
-                                }
-                                
-                                // Clip it to max if necessary.
-                                //
-                                if ( BS_TEMP_MAX_IDEAL < temp )
-                                {
-                                    einkfb_print_warn(CLIPPED_TEMP_FORMAT_C, BS_TEMP_MAX_IDEAL);
-                                    temp = BS_TEMP_MAX_IDEAL;
-                                }
-                            }
-                        }
-                    }
-                    else
-                    {
-                        char *which = temp_batt_in_use ? TEMP_WHICH_C_BATT : TEMP_WHICH_C_PMIC;
-                        
-                        // We now always want to log the temperature on flashing (page-turn like)
-                        // updates.
-                        //
-                        // Note:  If we substituted the battery's temperature for that of 
-                        //        Papyrus because Papyrus is stuck returning a bogus one,
-                        //        we'll see both the bogus tempature and the substitute
-                        //        in the log.
-                        //
-                        if ( fx_update_full == local_update_mode )
-                        {
-                            einkfb_print_info(TEMP_FORMAT_C_WHICH, temp, which);
-                        }
-                        else
-                            einkfb_debug(TEMP_FORMAT_C_WHICH, temp, which);
-                    }
-                }
-                else
-                {
-                    if ( fx_update_full == local_update_mode )
-                    {
-                        einkfb_print_info(OVERRIDE_TEMP_FORMAT_C, temp);
-                    }
-                    else
-                        einkfb_debug(OVERRIDE_TEMP_FORMAT_C, temp);
-                }
-
-                BS_VCOM_ALWAYS_ON();
-            }
-            else
-            {
-                // Check to see whether we're manually overriding the temperature.
-                //
-                if ( IN_RANGE(temp, BS_TEMP_MIN, BS_TEMP_MAX) )
-                {
-                    bs_cmd_wr_reg(BS_TEMP_DEV_SELECT_REG, BS_TEMP_DEV_EXT);
-                    einkfb_debug(OVERRIDE_TEMP_FORMAT_C, temp);
-                    set_temp = true;
-                }
-                else
-                    bs_cmd_wr_reg(BS_TEMP_DEV_SELECT_REG, BS_TEMP_DEV_INT);
-            }
-            
-            if ( set_temp )
-                bs_cmd_wr_reg(BS_TEMP_VALUE_REG, (u16)temp);
+            if ( !temp_set )
+                bs_upd_data_set_temp(local_update_mode);
             
             // Set up to display the loaded image data.
             //
@@ -2912,6 +3092,7 @@ static void bs_cmd_ld_img_upd_data_which(bs_cmd cmd, fx_type update_mode, u8 *da
         bs_image_loading_time    = jiffies_to_msecs(bs_upd_data_start   - bs_ld_img_start);
         bs_image_display_time    = jiffies_to_msecs(bs_image_stop_time  - bs_upd_data_start);
         bs_image_stop_time       = jiffies_to_msecs(bs_image_stop_time  - info.jif_on);
+        bs_image_overlap_time    = bs_upd_pipe_started ? jiffies_to_msecs(bs_upd_data_start - bs_upd_pipe_start) : 0;
 
         if ( EINKFB_PERF() )
         {
@@ -2922,6 +3103,7 @@ static void bs_cmd_ld_img_upd_data_which(bs_cmd cmd, fx_type update_mode, u8 *da
             einkfb_print_image_timing(bs_image_loading_time,    IMAGE_TIMING_LOAD_TYPE);
             einkfb_print_image_timing(bs_image_display_time,    IMAGE_TIMING_DISP_TYPE);
             einkfb_print_image_timing(bs_image_stop_time,       IMAGE_TIMING_STOP_TYPE);
+            einkfb_print_image_timing(bs_image_overlap_time,    IMAGE_TIMING_OVLP_TYPE);
         }
 
         broadsheet_set_override_upd_mode(saved_override_upd_mode);
@@ -3192,6 +3374,7 @@ unsigned long *bs_get_img_timings(int *num_timings)
         bs_image_timings[BS_IMAGE_TIMING_LOAD]  = bs_image_loading_time;
         bs_image_timings[BS_IMAGE_TIMING_DISP]  = bs_image_display_time;
         bs_image_timings[BS_IMAGE_TIMING_STOP]  = bs_image_stop_time;
+        bs_image_timings[BS_IMAGE_TIMING_OVLP]  = bs_image_overlap_time;
 
         *num_timings = BS_NUM_IMAGE_TIMINGS;
         timings = bs_image_timings;
@@ -5013,9 +5196,11 @@ int broadsheet_program_flash(unsigned long start_addr, unsigned char *buffer, un
 
         switch ( flash_base )
         {
-            // Soft reset after flashing the waveform.
+            // Soft reset after flashing the waveform (and forget
+            // the old one's header).
             //
             case BS_WFM_ADDR:
+                broadsheet_waveform_info_clr();
                 bs_sw_init(DONT_BRINGUP_CONTROLLER, DONT_BRINGUP_PANEL);
                 if ( !bs_bootstrap )
                     bs_cmd_ld_img_upd_data(fx_update_partial, UPD_DATA_RESTORE);
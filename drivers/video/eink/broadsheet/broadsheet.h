@@ -40,6 +40,22 @@ typedef struct bs_cmd_queue_elem_t bs_cmd_queue_elem_t;
 
 typedef void (*bs_cmd_queue_iterator_t)(bs_cmd_queue_elem_t *bs_cmd_queue_elem);
 
+struct bs_sfm_stats_t
+{
+    int             sectors_total,          // Progress of the current (or last) write.
+                    sectors_done;           //
+    
+    int             sectors_skipped,        // Sectors that already matched.
+                    sectors_unerased,       // Sectors that could be programmed without an erase.
+                    pages_programmed,       //
+                    pages_skipped,          // Pages that already matched.
+                    pages_failed;           // Pages that didn't read back correctly.
+    
+    unsigned long   bytes,                  // Throughput of the current (or last) write.
+                    msecs;                  //
+};
+typedef struct bs_sfm_stats_t bs_sfm_stats_t;
+
 struct bs_resolution_t
 {
     u32 x_hw, x_sw, x_mm,
@@ -142,6 +158,7 @@ extern void bs_cmd_upd_set_imgadr(u32 ma);
 //
 extern bool bs_sfm_preflight(bool isis_override);
 extern int  bs_get_sfm_size(void);
+extern bs_sfm_stats_t *bs_sfm_get_stats(void);
 
 extern void bs_sfm_start(void);
 extern void bs_sfm_end(void);
@@ -27,6 +27,7 @@
 #define EINKFB_PROC_TEMPERATURE         "temperature"
 #define EINKFB_PROC_HARDWAREFB          "hardware_fb"
 #define EINKFB_PROC_EINK_ROM            "eink_rom"
+#define EINKFB_PROC_EINK_ROM_STATS      "eink_rom_stats"
 #define EINKFB_PROC_EINK_RAM            "eink_ram"
 #define EINKFB_PROC_EINK_REG            "eink_reg"
 
@@ -91,6 +92,7 @@ static struct proc_dir_entry *einkfb_proc_recent_commands   = NULL;
 static struct proc_dir_entry *einkfb_proc_temperature       = NULL;
 static struct proc_dir_entry *einkfb_proc_hardwarefb        = NULL;
 static struct proc_dir_entry *einkfb_proc_eink_rom          = NULL;
+static struct proc_dir_entry *einkfb_proc_eink_rom_stats    = NULL;
 static struct proc_dir_entry *einkfb_proc_eink_ram          = NULL;
 static struct proc_dir_entry *einkfb_proc_eink_reg          = NULL;
 
@@ -398,6 +400,41 @@ static int eink_rom_write(struct file *file, const char __user *buf, unsigned lo
     return ( result );
 }
 
+// /proc/eink_fb/eink_rom_stats (read-only)
+//
+static int read_eink_rom_stats(char *page, unsigned long off, int count)
+{
+    int result = 0;
+    
+    // We're done after one shot.
+    //
+    if ( 0 == off )
+    {
+        bs_sfm_stats_t *stats = bs_sfm_get_stats();
+        unsigned long msecs = stats->msecs;
+        
+        result  = sprintf(&page[result], "sectors          = %d/%d\n", stats->sectors_done, stats->sectors_total);
+        result += sprintf(&page[result], "sectors_skipped  = %d\n",    stats->sectors_skipped);
+        result += sprintf(&page[result], "sectors_unerased = %d\n",    stats->sectors_unerased);
+        result += sprintf(&page[result], "pages_programmed = %d\n",    stats->pages_programmed);
+        result += sprintf(&page[result], "pages_skipped    = %d\n",    stats->pages_skipped);
+        result += sprintf(&page[result], "pages_failed     = %d\n",    stats->pages_failed);
+        result += sprintf(&page[result], "bytes            = %ld\n",   stats->bytes);
+        result += sprintf(&page[result], "msecs            = %ld\n",   msecs);
+        result += sprintf(&page[result], "bytes_per_sec    = %ld\n",
+            msecs ? ((stats->bytes * 1000) / msecs) : 0);
+    }
+    
+    return ( result );
+}
+
+static int eink_rom_stats_read(char *page, char **start, off_t off, int count, int *eof, void *data)
+{
+    // Don't take the lock:  this is meant to be read while eink_rom is being written.
+    //
+    return ( EINKFB_PROC_SYSFS_RW_NO_LOCK(page, start, off, count, eof, 0, read_eink_rom_stats) );
+}
+
 // /proc/eink_fb/eink_ram (read/write)
 //
 static int read_eink_ram(char *page, unsigned long off, int count)
@@ -1177,6 +1214,10 @@ static void broadsheet_create_proc_entries(void)
                                             : EINKFB_PROC_CHILD_RW),
             eink_rom_read, eink_rom_write);
     
+    if ( broadsheet_supports_flash() && !broadsheet_flash_is_readonly() )
+        einkfb_proc_eink_rom_stats = einkfb_create_proc_entry(EINKFB_PROC_EINK_ROM_STATS, EINKFB_PROC_CHILD_R,
+            eink_rom_stats_read, NULL);
+    
     // Create Broadsheet-specific sysfs entries.
     //
     FB_DEVICE_CREATE_FILE(&info.dev->dev, &dev_attr_eink_ram_select);
@@ -1228,6 +1269,9 @@ static void broadsheet_remove_proc_entries(void)
     if ( broadsheet_supports_flash() )
         einkfb_remove_proc_entry(EINKFB_PROC_EINK_ROM, einkfb_proc_eink_rom);
     
+    if ( broadsheet_supports_flash() && !broadsheet_flash_is_readonly() )
+        einkfb_remove_proc_entry(EINKFB_PROC_EINK_ROM_STATS, einkfb_proc_eink_rom_stats);
+    
     // Remove Broadsheet-specific sysfs entries.
     //
     device_remove_file(&info.dev->dev, &dev_attr_eink_ram_select);
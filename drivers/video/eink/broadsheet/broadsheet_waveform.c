@@ -55,6 +55,9 @@ typedef enum tuning_biases tuning_biases;
 
 static char waveform_version_string[waveform_version_string_max];
 
+static broadsheet_waveform_info_t waveform_info;
+static bool waveform_info_cached = false;
+
 static char *run_type_names[num_run_types] =
 {
     "B", "T", "P", "Q", "A", "C", "D", "E", "F", "G", "H", "I",
@@ -98,12 +101,26 @@ static char *tuning_bias_names[num_tuning_biases] =
 
 #define BS_CHECKSUM(c1, c2) (((c2) << 16) | (c1))
 
+// Reading the header out of flash takes an SFM transaction per field, so it's only done
+// once per waveform flashed.  ISIS waveforms are read straight out of memory and can be
+// swapped out from underneath us, so they aren't cached.
+//
+#define BS_WAVEFORM_INFO_CACHED() (!BS_ISIS() && waveform_info_cached)
+
+void broadsheet_waveform_info_clr(void)
+{
+    waveform_info_cached = false;
+}
+
 void broadsheet_get_waveform_info(broadsheet_waveform_info_t *info)
 {
-    if ( info )
+    if ( info && BS_WAVEFORM_INFO_CACHED() )
+        *info = waveform_info;
+    else if ( info )
     {
         bs_flash_select saved_flash_select = broadsheet_get_flash_select();
         unsigned char checksum1, checksum2;
+        int flash_read;
 
         broadsheet_set_flash_select(bs_flash_waveform);
 
@@ -125,13 +142,19 @@ void broadsheet_get_waveform_info(broadsheet_waveform_info_t *info)
 
         broadsheet_read_from_flash_long(EINK_ADDR_CHECKSUM,             &info->checksum);
         broadsheet_read_from_flash_long(EINK_ADDR_FILESIZE,             &info->filesize);
-        broadsheet_read_from_flash_long(EINK_ADDR_SERIAL_NUMBER,        &info->serial_number);
+        flash_read = broadsheet_read_from_flash_long(EINK_ADDR_SERIAL_NUMBER, &info->serial_number);
 
         broadsheet_set_flash_select(saved_flash_select);
 
         if ( 0 == info->filesize )
             info->checksum = BS_CHECKSUM(checksum1, checksum2);
 
+        if ( flash_read && !BS_ISIS() )
+        {
+            waveform_info = *info;
+            waveform_info_cached = true;
+        }
+
 	    einkfb_debug(   "\n"
                         " Waveform version:  0x%02X\n"
                         "       subversion:  0x%02X\n"
@@ -98,6 +98,7 @@ struct broadsheet_fpl_t
 typedef struct broadsheet_fpl_t broadsheet_fpl_t;
 
 extern void broadsheet_get_waveform_info(broadsheet_waveform_info_t *info);
+extern void broadsheet_waveform_info_clr(void);
 extern void broadsheet_get_waveform_version(broadsheet_waveform_t *waveform);
 extern void broadsheet_get_fpl_version(broadsheet_fpl_t *fpl);
 extern char *broadsheet_get_waveform_version_string(void);
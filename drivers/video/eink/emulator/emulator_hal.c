@@ -2,6 +2,9 @@
  *  linux/drivers/video/eink/emulator/emulator_hal.c
  *  -- eInk frame buffer device HAL emulator
  *
+ *  Simulates a panel well enough to time updates without one:  per-pixel gray
+ *  state, LUT occupancy, and frame timing all come from a real waveform file.
+ *
  *      Copyright (C) 2005-2010 Amazon Technologies, Inc.
  *
  *  This file is subject to the terms and conditions of the GNU General Public
@@ -23,6 +26,25 @@
 
 #define EMULATOR_SIZE   BPP_SIZE((XRES_6*YRES_6), BPP)
 
+#define EMU_WAVEFORM_SIZE       (1024 * 1024 * 2)
+#define EMU_FRAMES_MAX          512     // Longest LUT we'll time, in frames.
+#define EMU_FRAMES_SIZE         (EMU_FRAMES_MAX * EINK_WF_LUT_FRAME_SIZE)
+
+#define EMU_MODES_MAX           8
+#define EMU_LUTS_MAX            16
+#define EMU_TEMP_DEFAULT        25
+#define EMU_FRAME_RATE_DEFAULT  50      // Hz, when the waveform doesn't say.
+#define EMU_UPD_MODE_AUTO       (-1)
+
+#define EMU_UPD_MODES_00        0       // V100 (MU/GU/GC/PU) waveforms; all others are DU/GC16-based.
+#define EMU_UPD_MODE_DU         1
+#define EMU_UPD_MODE_GC16       2
+
+#define EMU_GRAY_WHITE          (EINK_WF_LUT_GRAYS - 1)
+#define EMU_GRAY(n)             (EMU_GRAY_WHITE - (n))  // einkfb nybble (0 = white) -> waveform gray (0 = black)
+
+#define EINKFB_PROC_EMULATOR_STATS "emulator_stats"
+
 #define IS_PORTRAIT()                           \
     (EINK_ORIENT_PORTRAIT  == emu_orientation)
 
@@ -55,6 +77,52 @@ static struct fb_fix_screeninfo emulator_fix =
     .accel              = FB_ACCEL_NONE,
 };
 
+// Per-mode timing, boiled down from the waveform's LUT at the current temperature:
+// how many frames the LUT runs for and, per (from, to) transition, how many of
+// those frames actually drive the pixel.
+//
+struct emu_mode_t
+{
+    int num_frames;
+    u16 drives[EINK_WF_LUT_GRAYS][EINK_WF_LUT_GRAYS];
+};
+typedef struct emu_mode_t emu_mode_t;
+
+// An update occupying one of the LUTs, on the simulated timeline (usecs).
+//
+struct emu_lut_t
+{
+    rect_t area;
+    s64    start, end;
+};
+typedef struct emu_lut_t emu_lut_t;
+
+struct emu_stats_t
+{
+    unsigned long updates,
+                  updates_flashing,
+                  updates_empty,
+                  updates_by_mode[EMU_MODES_MAX],
+                  collisions,
+                  lut_stalls,
+                  max_luts_busy,
+                  frames,
+                  pixels,
+                  pixel_frames;
+    
+    s64           wait_usecs,
+                  display_usecs,
+                  sync_usecs;
+                  
+    int           last_mode,
+                  last_frames;
+    s64           last_wait_usecs,
+                  last_usecs;
+};
+typedef struct emu_stats_t emu_stats_t;
+
+static struct proc_dir_entry *einkfb_proc_emulator_stats = NULL;
+
 static int emulator_xres     = XRES_6;
 static int emulator_yres     = YRES_6;
 
@@ -62,6 +130,38 @@ static unsigned long emu_bpp = BPP;
 static int emu_orientation   = EINKFB_ORIENT_PORTRAIT;
 static int emu_size          = 0;
 
+static char *emu_waveform_path = NULL;
+static int emu_luts            = EMU_LUTS_MAX;
+static int emu_temperature     = EMU_TEMP_DEFAULT;
+
+static char *emu_waveform      = NULL;
+static int  emu_waveform_size  = 0;
+static u8   *emu_frames        = NULL;
+static char emu_waveform_version[EINK_WF_PATH_LEN] = { 0 };
+
+static int  emu_mode_version   = EMU_UPD_MODES_00;
+static int  emu_frame_usecs    = USEC_PER_SEC / EMU_FRAME_RATE_DEFAULT;
+static int  emu_temp_min       = EINKFB_TEMP_INVALID;
+static int  emu_temp_max       = EINKFB_TEMP_INVALID;
+static int  emu_override_upd_mode = EMU_UPD_MODE_AUTO;
+
+static emu_mode_t emu_modes[EMU_MODES_MAX];
+static int  emu_num_modes      = 0;
+
+static u8   *emu_panel         = NULL;  // gray level on the glass, per pixel
+static u8   *emu_image         = NULL;  // gray level loaded into the controller, per pixel
+static int  emu_panel_size     = 0;
+
+static emu_lut_t emu_lut[EMU_LUTS_MAX];
+static emu_stats_t emu_stats;
+static s64  emu_time_base      = 0;
+static s64  emu_time_skew      = 0;
+
+// Without a waveform, time the V100 modes (INIT, MU, GU, GC, PU) with typical
+// 25C, 50Hz frame counts.
+//
+static int emu_default_frames[] = { 192, 13, 38, 38, 13 };
+
 #ifdef MODULE
 module_param_named(emu_bpp, emu_bpp, long, S_IRUGO);
 MODULE_PARM_DESC(emu_bpp, "1, 2, 4, or 8");
@@ -71,8 +171,472 @@ MODULE_PARM_DESC(emu_orientation, "0 (portrait) or 1 (landscape)");
 
 module_param_named(emu_size, emu_size, int, S_IRUGO);
 MODULE_PARM_DESC(emu_size, "0 (default, 6-inch), 6 (6-inch), or 9 (9.7-inch)");
+
+module_param_named(emu_waveform, emu_waveform_path, charp, S_IRUGO);
+MODULE_PARM_DESC(emu_waveform, "path of a waveform file to time updates with");
+
+module_param_named(emu_luts, emu_luts, int, S_IRUGO);
+MODULE_PARM_DESC(emu_luts, "1 to 16 (default) LUTs");
+
+module_param_named(emu_temperature, emu_temperature, int, S_IRUGO);
+MODULE_PARM_DESC(emu_temperature, "0 to 50C (default 25C)");
 #endif // MODULE
 
+#if PRAGMAS
+    #pragma mark -
+    #pragma mark Waveform Timing
+    #pragma mark -
+#endif
+
+static void emu_set_default_modes(void)
+{
+    int from, to, mode;
+    
+    emu_num_modes    = ARRAY_SIZE(emu_default_frames);
+    emu_mode_version = EMU_UPD_MODES_00;
+    emu_frame_usecs  = USEC_PER_SEC / EMU_FRAME_RATE_DEFAULT;
+    
+    // Every transition drives for the whole LUT, except that the non-clearing
+    // modes leave unchanged pixels alone.
+    //
+    for ( mode = 0; mode < emu_num_modes; mode++ )
+    {
+        emu_modes[mode].num_frames = emu_default_frames[mode];
+        
+        for ( from = 0; from < EINK_WF_LUT_GRAYS; from++ )
+            for ( to = 0; to < EINK_WF_LUT_GRAYS; to++ )
+                emu_modes[mode].drives[from][to] = ((from != to) || (WF_UPD_MODE_INIT == mode) ||
+                    (WF_UPD_MODE_GC == mode)) ? emu_default_frames[mode] : 0;
+    }
+}
+
+static void emu_set_modes(void)
+{
+    eink_waveform_lut_t lut;
+    char *saved_buffer;
+    int saved_size, mode, frame, from, to, num_decoded = 0;
+    
+    if ( !emu_waveform || !emu_frames )
+    {
+        emu_set_default_modes();
+        return;
+    }
+    
+    saved_buffer = einkwf_get_buffer();
+    saved_size   = einkwf_get_buffer_size();
+    
+    einkwf_set_buffer(emu_waveform);
+    einkwf_set_buffer_size(emu_waveform_size);
+    
+    lut.frames = emu_frames;
+    lut.frames_size = EMU_FRAMES_SIZE;
+    lut.num_modes = 0;
+    lut.temp_min = lut.temp_max = EINKFB_TEMP_INVALID;
+    
+    for ( mode = 0, emu_num_modes = EMU_MODES_MAX; mode < emu_num_modes; mode++ )
+    {
+        emu_mode_t *emu_mode = &emu_modes[mode];
+        memset(emu_mode, 0, sizeof(emu_mode_t));
+        
+        if ( einkwf_get_waveform_lut(&lut, mode, emu_temperature) )
+        {
+            emu_mode->num_frames = lut.num_frames;
+            num_decoded++;
+            
+            for ( frame = 0; frame < lut.num_frames; frame++ )
+            {
+                u8 *drive = &emu_frames[frame * EINK_WF_LUT_FRAME_SIZE];
+                
+                for ( from = 0; from < EINK_WF_LUT_GRAYS; from++ )
+                    for ( to = 0; to < EINK_WF_LUT_GRAYS; to++ )
+                        if ( EINK_WF_DRIVES(*drive++) )
+                            emu_mode->drives[from][to]++;
+            }
+        }
+        
+        emu_num_modes = min(lut.num_modes, EMU_MODES_MAX);
+    }
+    
+    emu_temp_min = lut.temp_min;
+    emu_temp_max = lut.temp_max;
+    
+    einkwf_set_buffer(saved_buffer);
+    einkwf_set_buffer_size(saved_size);
+    
+    // Fall back to the default timings if nothing in the waveform could be decoded.
+    //
+    if ( !num_decoded )
+        emu_set_default_modes();
+}
+
+static bool emu_load_waveform(char *path)
+{
+    eink_waveform_info_t info;
+    char *saved_buffer;
+    int saved_size;
+    bool result = false;
+    
+    if ( !emu_waveform )
+        emu_waveform = vmalloc(EMU_WAVEFORM_SIZE);
+    
+    if ( !emu_frames )
+        emu_frames = vmalloc(EMU_FRAMES_SIZE);
+    
+    if ( !emu_waveform || !emu_frames )
+        return ( false );
+    
+    saved_buffer = einkwf_get_buffer();
+    saved_size   = einkwf_get_buffer_size();
+    
+    einkwf_set_buffer(emu_waveform);
+    einkwf_set_buffer_size(EMU_WAVEFORM_SIZE);
+    
+    if ( (0 == einkwf_read_waveform_from_file(path)) && einkwf_waveform_valid() )
+    {
+        emu_waveform_size = einkwf_get_buffer_size();
+        einkwf_get_waveform_info(&info);
+        
+        strlcpy(emu_waveform_version, einkwf_get_waveform_version_string(eink_waveform_version_string),
+            EINK_WF_PATH_LEN);
+        
+        switch ( info.waveform.fpl_rate )
+        {
+            case EINK_FPL_RATE_60:
+                emu_frame_usecs = USEC_PER_SEC / 60;
+            break;
+            
+            case EINK_FPL_RATE_85:
+                emu_frame_usecs = USEC_PER_SEC / 85;
+            break;
+            
+            default:
+                emu_frame_usecs = USEC_PER_SEC / EMU_FRAME_RATE_DEFAULT;
+            break;
+        }
+        
+        emu_mode_version = info.waveform.mode_version;
+        result = true;
+    }
+    else
+        einkfb_print_warn("couldn't load waveform from %s\n", path);
+    
+    einkwf_set_buffer(saved_buffer);
+    einkwf_set_buffer_size(saved_size);
+    
+    // Fall back to the default timings if the waveform didn't take.
+    //
+    if ( !result )
+    {
+        vfree(emu_waveform);
+        emu_waveform = NULL;
+        emu_waveform_version[0] = 0;
+    }
+    
+    emu_set_modes();
+    
+    return ( result );
+}
+
+static int emu_get_upd_mode(fx_type update_mode, bool flashing_update)
+{
+    int upd_mode;
+    
+    if ( IN_RANGE(emu_override_upd_mode, 0, (emu_num_modes - 1)) )
+        upd_mode = emu_override_upd_mode;
+    else
+    {
+        bool v100 = EMU_UPD_MODES_00 == emu_mode_version;
+        
+        switch ( update_mode )
+        {
+            case fx_update_fast:
+                upd_mode = v100 ? WF_UPD_MODE_PU : EMU_UPD_MODE_DU;
+            break;
+            
+            default:
+                if ( v100 )
+                    upd_mode = flashing_update ? WF_UPD_MODE_GC : WF_UPD_MODE_GU;
+                else
+                    upd_mode = EMU_UPD_MODE_GC16;
+            break;
+        }
+    }
+    
+    return ( upd_mode );
+}
+
+#if PRAGMAS
+    #pragma mark -
+    #pragma mark Panel Simulation
+    #pragma mark -
+#endif
+
+static s64 emu_now(void)
+{
+    return ( ktime_to_us(ktime_get()) - emu_time_base + emu_time_skew );
+}
+
+static void emu_reset_stats(void)
+{
+    memset(&emu_stats, 0, sizeof(emu_stats_t));
+    memset(emu_lut, 0, sizeof(emu_lut));
+    
+    emu_stats.last_mode = EMU_UPD_MODE_AUTO;
+    emu_time_base = ktime_to_us(ktime_get());
+    emu_time_skew = 0;
+}
+
+static void emu_reset_panel(void)
+{
+    if ( emu_panel )
+    {
+        memset(emu_panel, EMU_GRAY_WHITE, emu_panel_size);
+        memset(emu_image, EMU_GRAY_WHITE, emu_panel_size);
+    }
+}
+
+static bool emu_areas_overlap(rect_t *a, rect_t *b)
+{
+    return ( (a->x1 < b->x2) && (b->x1 < a->x2) && (a->y1 < b->y2) && (b->y1 < a->y2) );
+}
+
+static u8 emu_get_nybble(u8 *row, int x, unsigned long bpp)
+{
+    int shift = (8 - bpp) - ((x * bpp) & 7);
+    u8 pixel = (row[(x * bpp) >> 3] >> shift) & ((1 << bpp) - 1);
+    
+    // Keep the top four bits of 8bpp pixels, and scale 1, 2, and 4bpp pixels up.
+    //
+    return ( (EINKFB_8BPP == bpp) ? (pixel >> 4) : ((pixel * 0x0F) / ((1 << bpp) - 1)) );
+}
+
+static void emu_load_area(u8 *data, rect_t *area)
+{
+    int x, y, xres = area->x2 - area->x1, rowbytes;
+    
+    struct einkfb_info info;
+    einkfb_get_info(&info);
+    
+    rowbytes = BPP_SIZE(xres, info.bpp);
+    
+    for ( y = area->y1; y < area->y2; y++ )
+    {
+        u8 *row   = &data[rowbytes * (y - area->y1)],
+           *image = &emu_image[(info.xres * y) + area->x1];
+        
+        for ( x = 0; x < xres; x++ )
+            image[x] = EMU_GRAY(emu_get_nybble(row, x, info.bpp));
+    }
+}
+
+// Wait, as the caller of a real controller would, for every update in flight to
+// finish.  The wait shifts the simulated timeline, so that later updates arrive
+// when they would have on real hardware.
+//
+static void emu_sync(void)
+{
+    s64 now = emu_now(), end = now;
+    int lut;
+    
+    for ( lut = 0; lut < emu_luts; lut++ )
+        end = max(end, emu_lut[lut].end);
+    
+    emu_stats.sync_usecs += end - now;
+    emu_time_skew += end - now;
+}
+
+static void emu_display_area(rect_t *area, fx_type update_mode, bool flashing_update, bool stall)
+{
+    int x, y, lut, free_lut, luts_busy, upd_mode = emu_get_upd_mode(update_mode, flashing_update);
+    unsigned long pixels = 0, pixel_frames = 0;
+    s64 arrival, start, duration;
+    emu_mode_t *mode;
+    
+    struct einkfb_info info;
+    einkfb_get_info(&info);
+    
+    if ( !IN_RANGE(upd_mode, 0, (emu_num_modes - 1)) )
+        return;
+    
+    mode = &emu_modes[upd_mode];
+    
+    // Drive the pixels:  every pixel in the area on flashing updates, only the
+    // changed ones otherwise.
+    //
+    for ( y = area->y1; y < area->y2; y++ )
+    {
+        u8 *panel = &emu_panel[info.xres * y],
+           *image = &emu_image[info.xres * y];
+        
+        for ( x = area->x1; x < area->x2; x++ )
+        {
+            if ( flashing_update || (panel[x] != image[x]) )
+            {
+                pixel_frames += mode->drives[panel[x]][image[x]];
+                panel[x] = image[x];
+                pixels++;
+            }
+        }
+        
+        EINKFB_SCHEDULE();
+    }
+    
+    // The controller doesn't start a LUT for an update that changes nothing.
+    //
+    if ( !pixels || !mode->num_frames )
+    {
+        emu_stats.updates_empty++;
+        return;
+    }
+    
+    // The update has to wait for every update in flight that it collides with (or all
+    // of them when stalling the LUT pipeline), and then for a LUT to free up.
+    //
+    duration = (s64)mode->num_frames * emu_frame_usecs;
+    start = arrival = emu_now();
+    
+    for ( lut = 0, luts_busy = 0; lut < emu_luts; lut++ )
+    {
+        if ( emu_lut[lut].end > arrival )
+        {
+            luts_busy++;
+            
+            if ( stall || emu_areas_overlap(&emu_lut[lut].area, area) )
+            {
+                if ( emu_lut[lut].end > start )
+                    start = emu_lut[lut].end;
+                
+                emu_stats.collisions++;
+            }
+        }
+    }
+    
+    for ( lut = 0, free_lut = 0; lut < emu_luts; lut++ )
+        if ( emu_lut[lut].end < emu_lut[free_lut].end )
+            free_lut = lut;
+    
+    if ( emu_lut[free_lut].end > start )
+    {
+        start = emu_lut[free_lut].end;
+        emu_stats.lut_stalls++;
+    }
+    
+    emu_lut[free_lut].area  = *area;
+    emu_lut[free_lut].start = start;
+    emu_lut[free_lut].end   = start + duration;
+    
+    emu_stats.updates++;
+    emu_stats.updates_by_mode[upd_mode]++;
+    emu_stats.updates_flashing += flashing_update ? 1 : 0;
+    luts_busy = min((luts_busy + 1), emu_luts);
+    emu_stats.max_luts_busy = max(emu_stats.max_luts_busy, (unsigned long)luts_busy);
+    emu_stats.frames += mode->num_frames;
+    emu_stats.pixels += pixels;
+    emu_stats.pixel_frames += pixel_frames;
+    emu_stats.wait_usecs += start - arrival;
+    emu_stats.display_usecs += duration;
+    
+    emu_stats.last_mode = upd_mode;
+    emu_stats.last_frames = mode->num_frames;
+    emu_stats.last_wait_usecs = start - arrival;
+    emu_stats.last_usecs = (start - arrival) + duration;
+    
+    einkfb_debug("mode = %d, frames = %d, pixels = %ld, wait = %lld, usecs = %lld\n",
+        upd_mode, mode->num_frames, pixels, emu_stats.last_wait_usecs, emu_stats.last_usecs);
+}
+
+#if PRAGMAS
+    #pragma mark -
+    #pragma mark Proc/Sysfs Entries
+    #pragma mark -
+#endif
+
+// /proc/eink_fb/emulator_stats (read/write)
+//
+static int read_emulator_stats(char *page, unsigned long off, int count)
+{
+    int result = 0, mode;
+    
+    // We're done after one shot.
+    //
+    if ( 0 == off )
+    {
+        result  = sprintf(&page[result], "waveform         = %s\n",
+            emu_waveform ? emu_waveform_version : "default");
+        result += sprintf(&page[result], "temperature      = %d (%d..%d)\n",
+            emu_temperature, emu_temp_min, emu_temp_max);
+        result += sprintf(&page[result], "frame_usecs      = %d\n",  emu_frame_usecs);
+        result += sprintf(&page[result], "luts             = %d\n",  emu_luts);
+        result += sprintf(&page[result], "frames_by_mode   =");
+        
+        for ( mode = 0; mode < emu_num_modes; mode++ )
+            result += sprintf(&page[result], " %d", emu_modes[mode].num_frames);
+        
+        result += sprintf(&page[result], "\nupdates_by_mode  =");
+        
+        for ( mode = 0; mode < emu_num_modes; mode++ )
+            result += sprintf(&page[result], " %ld", emu_stats.updates_by_mode[mode]);
+        
+        result += sprintf(&page[result], "\nupdates          = %ld\n", emu_stats.updates);
+        result += sprintf(&page[result], "updates_flashing = %ld\n",  emu_stats.updates_flashing);
+        result += sprintf(&page[result], "updates_empty    = %ld\n",  emu_stats.updates_empty);
+        result += sprintf(&page[result], "collisions       = %ld\n",  emu_stats.collisions);
+        result += sprintf(&page[result], "lut_stalls       = %ld\n",  emu_stats.lut_stalls);
+        result += sprintf(&page[result], "max_luts_busy    = %ld\n",  emu_stats.max_luts_busy);
+        result += sprintf(&page[result], "frames           = %ld\n",  emu_stats.frames);
+        result += sprintf(&page[result], "pixels           = %ld\n",  emu_stats.pixels);
+        result += sprintf(&page[result], "pixel_frames     = %ld\n",  emu_stats.pixel_frames);
+        result += sprintf(&page[result], "wait_usecs       = %lld\n", emu_stats.wait_usecs);
+        result += sprintf(&page[result], "display_usecs    = %lld\n", emu_stats.display_usecs);
+        result += sprintf(&page[result], "sync_usecs       = %lld\n", emu_stats.sync_usecs);
+        result += sprintf(&page[result], "last_update      = %d %d %lld %lld\n",
+            emu_stats.last_mode, emu_stats.last_frames, emu_stats.last_wait_usecs, emu_stats.last_usecs);
+    }
+    
+    return ( result );
+}
+
+static int emulator_stats_read(char *page, char **start, off_t off, int count, int *eof, void *data)
+{
+    return ( EINKFB_PROC_SYSFS_RW_LOCK(page, NULL, off, count, eof, 0, read_emulator_stats) );
+}
+
+static int write_emulator_stats(char *buf, unsigned long count, int unused)
+{
+    // Any write starts a new run.
+    //
+    emu_reset_stats();
+    
+    return ( count );
+}
+
+static int emulator_stats_write(struct file *file, const char __user *buf, unsigned long count, void *data)
+{
+    return ( EINKFB_PROC_SYSFS_RW_LOCK((char *)buf, NULL, count, 0, NULL, 0, write_emulator_stats) );
+}
+
+// /sys/devices/platform/eink_fb.0/override_upd_mode (read/write)
+//
+static ssize_t show_override_upd_mode(FB_DSHOW_PARAMS)
+{
+    return ( sprintf(buf, "%d\n", emu_override_upd_mode) );
+}
+
+static ssize_t store_override_upd_mode(FB_DSTOR_PARAMS)
+{
+    int result = -EINVAL, upd_mode;
+    
+    if ( sscanf(buf, "%d", &upd_mode) )
+    {
+        emu_override_upd_mode = IN_RANGE(upd_mode, 0, (EMU_MODES_MAX - 1)) ? upd_mode : EMU_UPD_MODE_AUTO;
+        result = count;
+    }
+    
+    return ( result );
+}
+
+static DEVICE_ATTR(override_upd_mode, DEVICE_MODE_RW, show_override_upd_mode, store_override_upd_mode);
+
 #if PRAGMAS
     #pragma mark HAL module operations
     #pragma mark -
@@ -138,9 +702,141 @@ static bool emulator_sw_init(struct fb_var_screeninfo *var, struct fb_fix_screen
     *var = emulator_var;
     *fix = emulator_fix;
     
+    // Set up the simulated panel, which starts out white.
+    //
+    if ( !IN_RANGE(emu_luts, 1, EMU_LUTS_MAX) )
+        emu_luts = EMU_LUTS_MAX;
+    
+    if ( !IN_RANGE(emu_temperature, EINKFB_TEMP_MIN, EINKFB_TEMP_MAX) )
+        emu_temperature = EMU_TEMP_DEFAULT;
+    
+    emu_panel_size = emulator_xres * emulator_yres;
+    emu_panel = vmalloc(emu_panel_size << 1);
+    
+    if ( !emu_panel )
+        return ( EINKFB_FAILURE );
+    
+    emu_image = &emu_panel[emu_panel_size];
+    
+    emu_reset_panel();
+    emu_reset_stats();
+    emu_set_default_modes();
+    
+    return ( EINKFB_SUCCESS );
+}
+
+static void emulator_sw_done(void)
+{
+    vfree(emu_panel);
+    vfree(emu_waveform);
+    vfree(emu_frames);
+    
+    emu_panel = emu_image = emu_frames = NULL;
+    emu_waveform = NULL;
+}
+
+static bool emulator_hw_init(struct fb_info *info, bool full)
+{
+    if ( emu_waveform_path )
+        emu_load_waveform(emu_waveform_path);
+    
     return ( EINKFB_SUCCESS );
 }
 
+static void emulator_create_proc_entries(void)
+{
+    struct einkfb_info info; einkfb_get_info(&info);
+    
+    einkfb_proc_emulator_stats = einkfb_create_proc_entry(EINKFB_PROC_EMULATOR_STATS, EINKFB_PROC_CHILD_RW,
+        emulator_stats_read, emulator_stats_write);
+    
+    FB_DEVICE_CREATE_FILE(&info.dev->dev, &dev_attr_override_upd_mode);
+}
+
+static void emulator_remove_proc_entries(void)
+{
+    struct einkfb_info info; einkfb_get_info(&info);
+    
+    einkfb_remove_proc_entry(EINKFB_PROC_EMULATOR_STATS, einkfb_proc_emulator_stats);
+    device_remove_file(&info.dev->dev, &dev_attr_override_upd_mode);
+}
+
+static void emulator_update_area(update_area_t *update_area)
+{
+    fx_type update_mode = update_area->which_fx;
+    u8 *data = update_area->buffer;
+    
+    if ( fx_display_sync == update_mode )
+    {
+        emu_sync();
+        data = NULL;
+    }
+    
+    if ( data || UPDATE_MODE_BUFFER_DISPLAY(update_mode) )
+    {
+        bool skip_buffer_display = false,
+             skip_buffer_load    = false,
+             flashing_update     = false,
+             area_update         = false;
+        
+        rect_t area;
+        struct einkfb_info info;
+        einkfb_get_info(&info);
+        
+        area.x1 = update_area->x1; area.x2 = update_area->x2;
+        area.y1 = update_area->y1; area.y2 = update_area->y2;
+        
+        area_update = (info.xres != (area.x2 - area.x1)) || (info.yres != (area.y2 - area.y1));
+        
+        switch ( update_mode )
+        {
+            // Just load up the controller's buffer; don't display it.
+            //
+            case fx_buffer_load:
+                skip_buffer_display = true;
+            break;
+            
+            // Just display what's already in the controller's buffer.
+            //
+            case fx_buffer_display_partial:
+            case fx_buffer_display_full:
+                skip_buffer_load = true;
+            /* goto set_update_mode; */
+            
+            default:
+                flashing_update = UPDATE_FULL(area_update ? UPDATE_AREA_MODE(update_mode)
+                                                          : UPDATE_MODE(update_mode));
+            break;
+        }
+        
+        if ( !skip_buffer_load )
+            emu_load_area(data, &area);
+        
+        // As on the real controllers, flashing and full-screen updates stall the LUT
+        // pipeline; non-flashing area updates only wait on those they collide with.
+        //
+        if ( !skip_buffer_display )
+            emu_display_area(&area, update_mode, flashing_update, (flashing_update || !area_update));
+    }
+}
+
+static void emulator_update_display(fx_type update_mode)
+{
+    update_area_t update_area;
+    struct einkfb_info info;
+    einkfb_get_info(&info);
+    
+    update_area.x1 = 0;
+    update_area.y1 = 0;
+    update_area.x2 = info.xres;
+    update_area.y2 = info.yres;
+    
+    update_area.which_fx = update_mode;
+    update_area.buffer = info.start;
+    
+    emulator_update_area(&update_area);
+}
+
 static bool emulator_set_display_orientation(orientation_t orientation)
 {
     bool rotate = false;
@@ -166,6 +862,12 @@ static bool emulator_set_display_orientation(orientation_t orientation)
         break;
     }
     
+    // The simulated panel is kept in framebuffer coordinates, so start it over
+    // on rotation.
+    //
+    if ( rotate )
+        emu_reset_panel();
+    
     return ( rotate );
 }
 
@@ -188,12 +890,65 @@ static orientation_t emulator_get_display_orientation(void)
     return ( orientation );
 }
 
+static char *emulator_waveform_version_io(char *path)
+{
+    char *result = NULL;
+    
+    // If we're requesting that the in-use waveform version be returned...
+    //
+    if ( EINKFB_READ_WFV(path) )
+    {
+        // ...then do that now.
+        //
+        result = emu_waveform ? emu_waveform_version : EINK_WF_USE_BUILTIN_WAVEFORM;
+    }
+    else
+    {
+        // ...otherwise, time updates with the waveform at the passed-in path.
+        //
+        emu_load_waveform(path);
+    }
+    
+    return ( result );
+}
+
+static int emulator_temperature_io(int temperature)
+{
+    int result = EINKFB_TEMP_INVALID;
+    
+    if ( EINKFB_READ_TEMP(temperature) )
+        result = emu_temperature;
+    else
+    {
+        // Only go back to the waveform when we've left the current temperature range.
+        //
+        emu_temperature = temperature;
+        
+        if ( emu_waveform && !((emu_temp_min <= temperature) && (temperature < emu_temp_max)) )
+            emu_set_modes();
+    }
+    
+    return ( result );
+}
+
 static einkfb_hal_ops_t emulator_hal_ops =
 {
-    .hal_sw_init = emulator_sw_init,
+    .hal_sw_init                 = emulator_sw_init,
+    .hal_sw_done                 = emulator_sw_done,
+    
+    .hal_hw_init                 = emulator_hw_init,
+    
+    .hal_create_proc_entries     = emulator_create_proc_entries,
+    .hal_remove_proc_entries     = emulator_remove_proc_entries,
+    
+    .hal_update_display          = emulator_update_display,
+    .hal_update_area             = emulator_update_area,
     
     .hal_set_display_orientation = emulator_set_display_orientation,
-    .hal_get_display_orientation = emulator_get_display_orientation
+    .hal_get_display_orientation = emulator_get_display_orientation,
+    
+    .hal_waveform_version_io     = emulator_waveform_version_io,
+    .hal_temperature_io          = emulator_temperature_io
 };
 
 static int emulator_hal_init(void)
@@ -21,14 +21,10 @@
 #define BPP                     EINKFB_8BPP
 #define FSLEPDC_SIZE            BPP_SIZE((XRES_6*YRES_6), BPP)
 
-#define FSLEPDC_SU_TIMEOUT      (HZ * 2) // How long to keep trying to send an update before giving up.
-#define FSLEPDC_SU_WAIT         (HZ / 2) // How long to wait before trying to send an update again.
-
-#define FSLEPDC_SU_DELAY        (HZ / 2) // Delay until we until we try again.
-#define FSLEPDC_SU_RETRIES      3        // Give up.
-
-#define FSLEPDC_UPDATE_RETRY    false
-#define FSLEPDC_UPDATE_NEW      true
+#define FSLEPDC_SU_TIMEOUT      (HZ * 2)  // How long to keep trying to send an update before giving up.
+#define FSLEPDC_SU_BACKOFF_MIN  (HZ / 50) // How long to wait before the first retry; doubles on each failure...
+#define FSLEPDC_SU_BACKOFF_MAX  (HZ / 2)  // ...up to this.
+#define FSLEPDC_SU_QUEUE_SIZE   8         // How many non-overlapping updates to hold onto for retrying.
 
 #define FSLEPDC_ROTATE_UR_0     FB_ROTATE_UR
 #define FSLEPDC_ROTATE_UR_90    FB_ROTATE_CW
@@ -136,14 +132,14 @@ static einkfb_power_level fslepdc_power_level = einkfb_power_level_init;
 static int fslepdc_temperature = EINKFB_TEMP_INVALID;
 
 static u8   *fslepdc_waveform_proxy = NULL;
+static int   fslepdc_waveform_proxy_size = 0;
 static char *fslepdc_waveform_name  = NULL;
 
 static u32  fslepdc_last_update_marker = 0;
 static int  fslepdc_bootstrap = 0;
 
-struct mxcfb_update_data fslepdc_send_update_retry_data;
-static int  fslepdc_send_update_retry_counter = 0;
 static void fslepdc_send_update_retry(struct work_struct *work);
+static void fslepdc_send_update_flush(void);
 static DECLARE_DELAYED_WORK(fslepdc_send_update_work, fslepdc_send_update_retry);
 
 #ifdef MODULE
@@ -198,7 +194,10 @@ static bool fslepdc_sw_init(struct fb_var_screeninfo *var, struct fb_fix_screeni
         //
         if ( fslepdc_waveform_proxy )
         {
+	    fslepdc_waveform_proxy_size = waveform_proxy_size;
+	    einkwf_index_clr();
 	    einkwf_set_buffer(fslepdc_waveform_proxy);
+	    einkwf_set_buffer_size(fslepdc_waveform_proxy_size);
 	    fslepdc_waveform_name = einkwf_get_waveform_version_string(eink_waveform_filename);
 
             mxc_epdc_set_wv_file((void *)fslepdc_waveform_proxy, fslepdc_waveform_name, waveform_proxy_size);
@@ -271,10 +270,12 @@ static void fslepdc_free_waveform_proxy(void)
     if ( fslepdc_waveform_proxy )
     {
 	einkwf_set_buffer(NULL);
+	einkwf_index_clr();
         einkwf_panel_waveform_free(fslepdc_waveform_proxy);
         mxc_epdc_clr_wv_file();
         
         fslepdc_waveform_proxy = NULL;
+        fslepdc_waveform_proxy_size = 0;
     }
 }
 
@@ -371,6 +372,10 @@ static bool fslepdc_using_builtin_waveform(void)
 
 static void fslepdc_sync(void)
 {
+    // The last update may still be waiting to be sent.
+    //
+    fslepdc_send_update_flush();
+    
     if ( fslepdc_last_update_marker )
     {
         mxc_epdc_fb_wait_update_complete(fslepdc_last_update_marker, NULL);
@@ -414,145 +419,333 @@ static unsigned long *fslepdc_get_img_timings(int *num_timings)
     return ( timings );
 }
 
-static bool fslepdc_send_update(struct mxcfb_update_data *update_data, bool retry)
+// Updates that the EPDC won't accept yet are queued here and retried from
+// fslepdc_send_update_work.  Each entry keeps its own rectangle, waveform,
+// and update mode; only updates whose rectangles overlap get merged, since
+// the later update must not be shown before the earlier one it overlaps.
+//
+#define FSLEPDC_RETRY_RETRIED   0 // Queued updates that were eventually sent.
+#define FSLEPDC_RETRY_SAVED     1 // Retries saved by merging overlapping updates.
+#define FSLEPDC_RETRY_DROPPED   2 // Queued updates that ran out of latency budget.
+#define FSLEPDC_NUM_RETRY_STATS (FSLEPDC_RETRY_DROPPED + 1)
+
+struct fslepdc_retry
 {
-    bool result = false;
+    struct mxcfb_update_data update_data;
+    unsigned long            queued;
+};
+typedef struct fslepdc_retry fslepdc_retry;
+
+static fslepdc_retry fslepdc_retry_queue[FSLEPDC_SU_QUEUE_SIZE];
+static int           fslepdc_retry_count   = 0;
+static int           fslepdc_retry_backoff = 0;
+static unsigned long fslepdc_retry_stats[FSLEPDC_NUM_RETRY_STATS];
+static DEFINE_MUTEX(fslepdc_retry_lock);
+
+static unsigned long *fslepdc_get_retry_stats(int *num_stats)
+{
+    unsigned long *stats = NULL;
+
+    if ( num_stats )
+    {
+        *num_stats = FSLEPDC_NUM_RETRY_STATS;
+        stats = fslepdc_retry_stats;
+    }
+
+    return ( stats );
+}
+
+static void fslepdc_debug_update_data(struct mxcfb_update_data *update_data)
+{
+    char temp_string[16];
     
-    if ( update_data )
+    if ( TEMP_USE_AMBIENT == update_data->temp )
+        strcpy(temp_string, "ambient");
+    else
+        sprintf(temp_string, "%d", update_data->temp);
+    
+    einkfb_debug("update_data:\n");
+    einkfb_debug("  rect x: %d\n", update_data->update_region.left);
+    einkfb_debug("  rect y: %d\n", update_data->update_region.top);
+    einkfb_debug("  rect w: %d\n", update_data->update_region.width);
+    einkfb_debug("  rect h: %d\n", update_data->update_region.height);
+    einkfb_debug("  wfmode: %d\n", update_data->waveform_mode);
+    einkfb_debug("  update: %s\n", update_data->update_mode ? "flashing" : "non-flashing");
+    einkfb_debug("  marker: %d\n", update_data->update_marker);
+    einkfb_debug("  temp:   %s\n", temp_string);
+}
+
+static bool fslepdc_rects_overlap(struct mxcfb_rect *a, struct mxcfb_rect *b)
+{
+    return ( (a->left < (b->left + b->width))  && (b->left < (a->left + a->width)) &&
+             (a->top  < (b->top  + b->height)) && (b->top  < (a->top  + a->height)) );
+}
+
+static void fslepdc_union_rect(struct mxcfb_rect *dst, struct mxcfb_rect *a, struct mxcfb_rect *b)
+{
+    u32 right  = max(a->left + a->width,  b->left + b->width),
+        bottom = max(a->top  + a->height, b->top  + b->height);
+    
+    dst->left   = min(a->left, b->left);
+    dst->top    = min(a->top,  b->top);
+    dst->width  = right  - dst->left;
+    dst->height = bottom - dst->top;
+}
+
+static u32 fslepdc_union_area(struct mxcfb_rect *a, struct mxcfb_rect *b)
+{
+    struct mxcfb_rect rect;
+    
+    fslepdc_union_rect(&rect, a, b);
+    
+    return ( rect.width * rect.height );
+}
+
+static void fslepdc_retry_merge(fslepdc_retry *dst, fslepdc_retry *src)
+{
+    struct mxcfb_update_data *dst_data = &dst->update_data,
+                             *src_data = &src->update_data;
+
+    fslepdc_union_rect(&dst_data->update_region, &dst_data->update_region, &src_data->update_region);
+    
+    // Keep the waveform if both updates agree on it.  Otherwise, let the EPDC
+    // pick one for the merged content rather than forcing GC on everything.
+    //
+    if ( dst_data->waveform_mode != src_data->waveform_mode )
+        dst_data->waveform_mode = WF_UPD_MODE_AUTO;
+    
+    // Flash if either update would have.
+    //
+    if ( UPDATE_MODE_FULL == src_data->update_mode )
+        dst_data->update_mode = UPDATE_MODE_FULL;
+    
+    // Use the later marker and its temperature, but hold onto the earlier
+    // queue time so that the merged update stays within its latency budget.
+    //
+    if ( 0 < (s32)(src_data->update_marker - dst_data->update_marker) )
+    {
+        dst_data->update_marker = src_data->update_marker;
+        dst_data->temp          = src_data->temp;
+    }
+    
+    if ( time_before(src->queued, dst->queued) )
+        dst->queued = src->queued;
+    
+    fslepdc_retry_stats[FSLEPDC_RETRY_SAVED]++;
+}
+
+static void fslepdc_retry_remove(int which)
+{
+    fslepdc_retry_count--;
+    
+    if ( which < fslepdc_retry_count )
+        memmove(&fslepdc_retry_queue[which], &fslepdc_retry_queue[which + 1],
+            (fslepdc_retry_count - which) * sizeof(fslepdc_retry));
+}
+
+static void fslepdc_retry_enqueue(struct mxcfb_update_data *update_data)
+{
+    int i, j, which = -1;
+    
+    // Merge the new update into the first queued update that it overlaps...
+    //
+    for ( i = 0; (i < fslepdc_retry_count) && (0 > which); i++ )
+        if ( fslepdc_rects_overlap(&fslepdc_retry_queue[i].update_data.update_region, &update_data->update_region) )
+            which = i;
+    
+    // ...or, if there's no room for it, into whichever queued update grows the least.
+    //
+    if ( (0 > which) && (FSLEPDC_SU_QUEUE_SIZE == fslepdc_retry_count) )
     {
-        unsigned long start_time, stop_time;
-        int send_update_err;
+        u32 area, best_area = ~0;
         
-        // If this isn't a retry...
-        //
-        if ( !retry )
+        for ( i = 0; i < fslepdc_retry_count; i++ )
         {
-            // ...cancel any pending retries.
-            //
-            cancel_delayed_work(&fslepdc_send_update_work);
+            area = fslepdc_union_area(&fslepdc_retry_queue[i].update_data.update_region, &update_data->update_region);
             
-            // But accumulate any pending retry with the new data.
-            //
-            if ( fslepdc_send_update_retry_counter )
+            if ( area < best_area )
             {
-                struct mxcfb_rect old_retry = fslepdc_send_update_retry_data.update_region,
-                                  new_retry,
-                                  update    = update_data->update_region;
-                u32               old_retry_right,
-                                  old_retry_bot,
-                                  new_retry_right,
-                                  new_retry_bot,
-                                  update_right,
-                                  update_bot;
-                
-                // First, accumulate the update region.
-                //
-                old_retry_right  = (old_retry.left + old_retry.width)  - 1;
-                old_retry_bot    = (old_retry.top  + old_retry.height) - 1;
-                update_right     = (update.left    + update.width)     - 1;
-                update_bot       = (update.top     + update.height)    - 1;
-                
-                new_retry.left   = min(old_retry.left,  update.left);
-                new_retry.top    = min(old_retry.top,   update.top);
-                new_retry_right  = max(old_retry_right, update_right);
-                new_retry_bot    = max(old_retry_bot,   update_bot);
-                
-                new_retry.width  = (new_retry_right - new_retry.left)  + 1;
-                new_retry.height = (new_retry_bot   - new_retry.top)   + 1;
-                
-                fslepdc_send_update_retry_data.update_region = new_retry;
-                
-                // Since it's a retry, go for the highest fidelity possible.
-                //
-                fslepdc_send_update_retry_data.waveform_mode = fslepdc_get_waveform_mode(WF_UPD_MODE_GC);
-                fslepdc_send_update_retry_data.update_mode   = UPDATE_MODE_FULL;
-                
-                // Use the latest marker and temperature.
-                //
-                fslepdc_send_update_retry_data.update_marker = update_data->update_marker;
-                fslepdc_send_update_retry_data.temp          = update_data->temp;
-                
-                // Copy the retry data back for this attempt.
-                //
-                *update_data = fslepdc_send_update_retry_data;
+                best_area = area;
+                which = i;
             }
         }
+    }
+    
+    if ( 0 > which )
+    {
+        fslepdc_retry_queue[fslepdc_retry_count].update_data = *update_data;
+        fslepdc_retry_queue[fslepdc_retry_count].queued = jiffies;
+        fslepdc_retry_count++;
+    }
+    else
+    {
+        fslepdc_retry new_retry = { .update_data = *update_data, .queued = jiffies };
+        fslepdc_retry_merge(&fslepdc_retry_queue[which], &new_retry);
         
-        // We can get errors sending updates to EPDC if it's not ready to do
-        // an update yet.  So, back off and retry a few times here first
-        // before scheduling a retry.
+        // The merged rectangle may now overlap other queued updates, so fold
+        // those in too, always keeping the result at the earlier position.
         //
-        start_time = jiffies; stop_time = start_time + FSLEPDC_SU_TIMEOUT;    
-
-        do
+        for ( j = 0; j < fslepdc_retry_count; )
         {
-            send_update_err = mxc_epdc_fb_send_update(update_data, NULL);
-            
-            if ( 0 != send_update_err )
+            if ( (j != which) && fslepdc_rects_overlap(&fslepdc_retry_queue[j].update_data.update_region,
+                                                       &fslepdc_retry_queue[which].update_data.update_region) )
             {
-                einkfb_print_error("EPDC_send_update_error=%d:\n", send_update_err);
-                schedule_timeout_uninterruptible(FSLEPDC_SU_WAIT);
+                int lo = min(j, which), hi = max(j, which);
+                
+                fslepdc_retry_merge(&fslepdc_retry_queue[lo], &fslepdc_retry_queue[hi]);
+                fslepdc_retry_remove(hi);
+                
+                which = lo; j = 0;
             }
+            else
+                j++;
         }
-        while ( (0 != send_update_err) && time_before_eq(jiffies, stop_time) );
+    }
+}
+
+// Sends whatever is queued, in order, until the EPDC refuses an update.  Returns
+// zero if the queue is now empty, or else how long to wait before trying again.
+//
+static unsigned long fslepdc_retry_drain(void)
+{
+    unsigned long delay = 0, now, deadline;
+    int i, send_update_err = 0;
+    
+    while ( fslepdc_retry_count && (0 == send_update_err) )
+    {
+        fslepdc_retry *retry = &fslepdc_retry_queue[0];
         
-        if ( time_after(jiffies, stop_time) )
-        {
-             einkfb_print_crit("EDPC_send_update_timed_out=true:\n");
-        }
-        else
+        send_update_err = mxc_epdc_fb_send_update(&retry->update_data, NULL);
+        
+        if ( 0 == send_update_err )
         {
-            char temp_string[16];
-            
-            if ( TEMP_USE_AMBIENT == update_data->temp )
-                strcpy(temp_string, "ambient");
-            else
-                sprintf(temp_string, "%d", update_data->temp);
+            fslepdc_debug_update_data(&retry->update_data);
             
-            einkfb_debug("update_data:\n");
-            einkfb_debug("  rect x: %d\n", update_data->update_region.left);
-            einkfb_debug("  rect y: %d\n", update_data->update_region.top);
-            einkfb_debug("  rect w: %d\n", update_data->update_region.width);
-            einkfb_debug("  rect h: %d\n", update_data->update_region.height);
-            einkfb_debug("  wfmode: %d\n", update_data->waveform_mode);
-            einkfb_debug("  update: %s\n", update_data->update_mode ? "flashing" : "non-flashing");
-            einkfb_debug("  marker: %d\n", update_data->update_marker);
-            einkfb_debug("  temp:   %s\n", temp_string);
+            if ( fslepdc_retry_backoff )
+                fslepdc_retry_stats[FSLEPDC_RETRY_RETRIED]++;
             
-            fslepdc_send_update_retry_counter = 0;
-            result = true;
+            fslepdc_retry_remove(0);
         }
-
-        // If our attempt to send an update failed, try it again later.
+        else
+            einkfb_print_error("EPDC_send_update_error=%d:\n", send_update_err);
+    }
+    
+    if ( 0 == send_update_err )
+    {
+        fslepdc_retry_backoff = 0;
+    }
+    else
+    {
+        // Give up on anything that has already waited out its latency budget.
         //
-        if ( !result )
+        now = jiffies;
+        
+        for ( i = 0; i < fslepdc_retry_count; )
         {
-            if ( FSLEPDC_SU_RETRIES > ++fslepdc_send_update_retry_counter )
+            if ( time_after_eq(now, fslepdc_retry_queue[i].queued + FSLEPDC_SU_TIMEOUT) )
             {
-                // If this isn't a retry, use the current update data.
-                //
-                if ( !retry )
-                    fslepdc_send_update_retry_data = *update_data;
-                
-                schedule_delayed_work(&fslepdc_send_update_work, FSLEPDC_SU_DELAY);
+                einkfb_print_crit("EDPC_send_update_timed_out=true:\n");
+                fslepdc_retry_stats[FSLEPDC_RETRY_DROPPED]++;
+                fslepdc_retry_remove(i);
             }
             else
+                i++;
+        }
+        
+        if ( fslepdc_retry_count )
+        {
+            // Back off exponentially, but never past the point where the oldest
+            // queued update would blow its latency budget.
+            //
+            delay = min((unsigned long)FSLEPDC_SU_BACKOFF_MIN << fslepdc_retry_backoff,
+                        (unsigned long)FSLEPDC_SU_BACKOFF_MAX);
+            
+            if ( FSLEPDC_SU_BACKOFF_MAX > delay )
+                fslepdc_retry_backoff++;
+            
+            for ( i = 0; i < fslepdc_retry_count; i++ )
             {
-                einkfb_print_crit("Updates are failing...\n");
+                deadline = fslepdc_retry_queue[i].queued + FSLEPDC_SU_TIMEOUT;
+                
+                if ( time_before(deadline, now + delay) )
+                    delay = deadline - now;
             }
+            
+            delay = max(delay, 1UL);
+        }
+        else
+        {
+            einkfb_print_crit("Updates are failing...\n");
+            fslepdc_retry_backoff = 0;
         }
     }
     
+    return ( delay );
+}
+
+static bool fslepdc_send_update(struct mxcfb_update_data *update_data)
+{
+    bool result = false;
+    
+    if ( update_data )
+    {
+        unsigned long delay;
+        
+        // Queue the new update behind (or into) anything still pending, and then
+        // try to send everything.  We can get errors sending updates to EPDC if
+        // it's not ready to do an update yet, so whatever is left over gets
+        // retried later.
+        //
+        mutex_lock(&fslepdc_retry_lock);
+        
+        fslepdc_retry_enqueue(update_data);
+        delay = fslepdc_retry_drain();
+        
+        mutex_unlock(&fslepdc_retry_lock);
+        
+        if ( delay )
+            schedule_delayed_work(&fslepdc_send_update_work, delay);
+        else
+            result = true;
+    }
+    
     return ( result );
 }
 
 static void fslepdc_send_update_retry(struct work_struct *work)
 {
+    unsigned long delay;
+    
     if (fslepdc_removed)
 	return;
 
-    einkfb_debug("Retrying update, count = %d\n", fslepdc_send_update_retry_counter);
-    fslepdc_send_update(&fslepdc_send_update_retry_data, FSLEPDC_UPDATE_RETRY);
+    mutex_lock(&fslepdc_retry_lock);
+    
+    einkfb_debug("Retrying updates, count = %d\n", fslepdc_retry_count);
+    delay = fslepdc_retry_drain();
+    
+    mutex_unlock(&fslepdc_retry_lock);
+    
+    if ( delay )
+        schedule_delayed_work(&fslepdc_send_update_work, delay);
+}
+
+static void fslepdc_send_update_flush(void)
+{
+    unsigned long delay;
+    
+    // Wait for anything still queued to be sent (or to time out).
+    //
+    mutex_lock(&fslepdc_retry_lock);
+    
+    while ( (delay = fslepdc_retry_drain()) )
+    {
+        mutex_unlock(&fslepdc_retry_lock);
+        schedule_timeout_uninterruptible(delay);
+        mutex_lock(&fslepdc_retry_lock);
+    }
+    
+    mutex_unlock(&fslepdc_retry_lock);
 }
 
 static void fsledpc_init_update_data(struct mxcfb_update_data *update_data)
@@ -587,7 +780,7 @@ static void fslepdc_repair_worker(struct work_struct *unused)
 
 	fslepdc_repair_count = 0;
 
-	fslepdc_send_update(&update_data, FSLEPDC_UPDATE_NEW);
+	fslepdc_send_update(&update_data);
 }
 DECLARE_DELAYED_WORK(fslepdc_repair_work, fslepdc_repair_worker);
 
@@ -788,7 +981,7 @@ static void fslepdc_update_area(update_area_t *update_area)
 			fslepdc_repair_count++;
 		}
 
-		fslepdc_send_update(&update_data, FSLEPDC_UPDATE_NEW);
+		fslepdc_send_update(&update_data);
 		if (UPDATE_MODE_FULL == update_data.update_mode) {
 			fslepdc_repair_count = 0;
 		}
@@ -951,9 +1144,23 @@ static ssize_t show_image_timings(FB_DSHOW_PARAMS)
     return ( len );
 }
 
+// /sys/devices/platform/eink_fb.0/send_update_retries (read-only)
+//
+static ssize_t show_send_update_retries(FB_DSHOW_PARAMS)
+{
+    int i, len, num_stats;
+    unsigned long *stats = fslepdc_get_retry_stats(&num_stats);
+    
+    for ( i = 0, len = 0; i < num_stats; i++ )
+        len += sprintf(&buf[len], "%lu%s", stats[i], (i == (num_stats - 1)) ? "" : " " );
+        
+    return ( len );
+}
+
 static DEVICE_ATTR(override_upd_mode,   DEVICE_MODE_RW, show_override_upd_mode, store_override_upd_mode);
 static DEVICE_ATTR(vcom,                DEVICE_MODE_RW, show_vcom,              store_vcom);
 static DEVICE_ATTR(image_timings,       DEVICE_MODE_R,  show_image_timings,     NULL);
+static DEVICE_ATTR(send_update_retries, DEVICE_MODE_R,  show_send_update_retries, NULL);
 
 static void fslepdc_create_proc_entries(void)
 {
@@ -962,6 +1169,7 @@ static void fslepdc_create_proc_entries(void)
     
     FB_DEVICE_CREATE_FILE(&info.dev->dev, &dev_attr_override_upd_mode);
     FB_DEVICE_CREATE_FILE(&info.dev->dev, &dev_attr_image_timings);
+    FB_DEVICE_CREATE_FILE(&info.dev->dev, &dev_attr_send_update_retries);
 
     if ( einkwf_panel_supports_vcom() )
           FB_DEVICE_CREATE_FILE(&info.dev->dev, &dev_attr_vcom);    
@@ -975,6 +1183,7 @@ static void fslepdc_remove_proc_entries(void)
     if ( einkwf_panel_supports_vcom() )
         device_remove_file(&info.dev->dev, &dev_attr_vcom);
     
+    device_remove_file(&info.dev->dev, &dev_attr_send_update_retries);
     device_remove_file(&info.dev->dev, &dev_attr_image_timings);
     device_remove_file(&info.dev->dev, &dev_attr_override_upd_mode);
 }
@@ -990,6 +1199,7 @@ static char *fslepdc_waveform_version_io(char *path)
         // ...then do that now.
         //
 	einkwf_set_buffer(fslepdc_waveform_proxy);
+	einkwf_set_buffer_size(fslepdc_waveform_proxy_size);
         result = einkwf_get_waveform_version_string(eink_waveform_version_string);
     }
     else
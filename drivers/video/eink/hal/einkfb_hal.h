@@ -18,6 +18,7 @@
 #include <linux/device.h>
 #include <linux/dma-mapping.h>
 #include <linux/einkfb.h>
+#include <linux/einkfb_events.h>
 #include <linux/einkwf.h>
 #include <linux/errno.h>
 #include <linux/fb.h>
@@ -83,6 +84,7 @@
 #define FB_FILLRECT     sys_fillrect
 #define FB_COPYAREA     sys_copyarea
 #define FB_IMAGEBLIT    sys_imageblit
+#define FB_WRITE        fb_sys_write
 
 #define REBOOT_PRIORITY 0x3FFFFFFF
 
@@ -653,6 +655,16 @@ typedef bool (*einkfb_hardware_ready_t)(void *data);
 //
 typedef void (*einkfb_blit_t)(int x, int y, int rowbytes, int bytes, void *data);
 
+// For use with einkfb_blit_rows():  called once per row with the span of
+// bytes [x, x + span) in row y of the framebuffer; bytes is the offset of
+// the span's first byte in the packed area buffer.
+//
+typedef void (*einkfb_blit_row_t)(int x, int y, int rowbytes, int bytes, int span, void *data);
+
+// For transforming a span of pixel bytes in place.
+//
+typedef void (*einkfb_span_t)(u8 *buf, int len);
+
 // From einkfb_hal_main.c:
 //
 extern void einkfb_set_info_hook(einkfb_info_hook_t info_hook);
@@ -688,6 +700,10 @@ extern void einkfb_inc_lock_count(void);
 extern void einkfb_dec_lock_count(void);
 
 extern void einkfb_blit(int xstart, int xend, int ystart, int yend, einkfb_blit_t blit, void *data);
+extern void einkfb_blit_rows(int xstart, int xend, int ystart, int yend, einkfb_blit_row_t blit, void *data);
+
+extern bool einkfb_span_copy_cmp(u8 *dst, u8 *src, int len);
+extern void einkfb_span_invert(u8 *buf, int len);
 
 extern einkfb_bounds_failure einkfb_get_last_bounds_failure(void);
 extern bool einkfb_bounds_are_acceptable(int xstart, int xres, int ystart, int yres);
@@ -698,10 +714,19 @@ extern unsigned char einkfb_stretch_nybble(unsigned char nybble, unsigned long b
 extern void einkfb_posterize_to_1bpp_begin(void);
 extern void einkfb_posterize_to_1bpp_end(void);
 extern u8 einkfb_posterize_to_1bpp(u8 data, int i);
+extern void einkfb_posterize_to_1bpp_span(u8 *buf, int len);
 
 extern void einkfb_contrast_begin(void);
 extern void einkfb_contrast_end(void);
 extern u8 einkfb_apply_contrast(u8 data, int i);
+extern void einkfb_apply_contrast_span(u8 *buf, int len);
+
+extern void einkfb_invert_begin(void);
+extern void einkfb_invert_end(void);
+extern u8 einkfb_apply_fx_table(u8 data, int i);
+extern void einkfb_fx_span(u8 *buf, int len);
+extern bool einkfb_fx_copy_cmp(u8 *dst, u8 *src, int len);
+extern int einkfb_fx_bench(char *page);
 
 extern void einkfb_display_grayscale_ramp(void);
 
@@ -754,6 +779,11 @@ extern void einkfb_free(void *ptr, einkfb_dma_addr_t *phys, bool mmap);
 extern int  einkfb_memcpy(bool direction, unsigned long flag, void *destination, const void *source, size_t length);
 extern void einkfb_memset(void *destination, int value, size_t length);
 
+extern void einkfb_dirty_mark(unsigned long offset, unsigned long length);
+extern void einkfb_dirty_mark_rows(int y1, int y2);
+extern void einkfb_dirty_mark_all(void);
+extern unsigned long *einkfb_dirty_take(void *start, int *tiles);
+
 // From einkfb_hal_io.c:
 //
 extern char *einkfb_get_cmd_string(unsigned int cmd);
@@ -795,12 +825,14 @@ extern bool einkfb_get_power_override_state(void);
 //
 extern void einkfb_init_event(einkfb_event_t *event);
 extern void einkfb_post_event(einkfb_event_t *event);
+extern unsigned long einkfb_get_events_dropped(void);
 
 extern int einkfb_events_open(struct inode *inode, struct file *file);
 extern int einkfb_events_release(struct inode *inode, struct file *file);
 
 extern ssize_t einkfb_events_read(struct file *file, char *buf, size_t count, loff_t *ofs);
 extern unsigned int einkfb_events_poll(struct file *file, poll_table *wait);
+extern long einkfb_events_ioctl(struct file *file, unsigned int cmd, unsigned long arg);
 
 extern void einkfb_start_event_timer(void);
 extern void einkfb_stop_event_timer(void);
@@ -15,26 +15,41 @@
     #pragma mark Definitions/Globals
 #endif
 
-#define EINKFB_NUM_EVENTS               101     // n+1 -> n events + 1 for empty
+#define EINKFB_NUM_EVENTS               128     // power of 2
+#define EINKFB_EVENTS_MASK              (EINKFB_NUM_EVENTS - 1)
+#define EINKFB_EVENTS_SAFE              (EINKFB_NUM_EVENTS - 1)  // most a reader may trail by
+#define EINKFB_EVENTS_BATCH             8       // events copied to user-space at a time
 #define EINKFB_EVENT_TIMER_DELAY        (HZ/4)  // minimum DU-style update time
-#define EINKFB_EVENT_THREAD_NAME        EINKFB_NAME"_et"
 
-static einkfb_event_t einkfb_event_queue[EINKFB_NUM_EVENTS];
-static einkfb_event_t einkfb_event;
+// Events go into a single ring that posters fill under einkfb_event_lock.
+// Readers never take the lock: each open file has its own cursor into the
+// ring.  The slot at head - EINKFB_NUM_EVENTS is the one the next poster
+// overwrites, so a reader that falls that far behind skips ahead to the
+// oldest slot that's still safe and counts what it missed.  Its next read
+// fails with -EOVERFLOW, and EINKFB_EVENTS_DROPPED returns the count.
+//
+struct einkfb_event_reader_t
+{
+    u32             tail;
+    unsigned long   dropped;
+    bool            lapped;
+};
+typedef struct einkfb_event_reader_t einkfb_event_reader_t;
+
+static einkfb_event_t einkfb_event_ring[EINKFB_NUM_EVENTS];
+static u32 einkfb_event_head = 0;
 
-static int einkfb_event_queue_entry     = 0;
-static int einkfb_event_queue_exit      = 0;
-static int einkfb_events_access_count   = 0;
+static DEFINE_SPINLOCK(einkfb_event_lock);
+static atomic_t einkfb_events_access_count = ATOMIC_INIT(0);
+static atomic_t einkfb_events_dropped = ATOMIC_INIT(0);
 
 static DECLARE_WAIT_QUEUE_HEAD(einkfb_events_read_wait);
 
 static bool einkfb_event_timer_active   = false;
 static bool einkfb_event_timer_primed   = false;
-static struct timer_list einkfb_event_timer;
-static int einkfb_event_thread_exit = 0;
-static THREAD_ID(einkfb_event_thread_id);
-static DECLARE_COMPLETION(einkfb_event_thread_exited);
-static DECLARE_COMPLETION(einkfb_event_thread_complete);
+
+static void einkfb_event_complete_work(struct work_struct *unused);
+static DECLARE_DELAYED_WORK(einkfb_event_complete, einkfb_event_complete_work);
 
 #if PRAGMAS
     #pragma mark -
@@ -52,65 +67,100 @@ static bool einkfb_valid_event(einkfb_event_t *event)
     return ( result );
 }
 
-static bool einkfb_event_queue_empty(void)
+static u32 einkfb_event_ring_head(void)
+{
+    u32 head = ACCESS_ONCE(einkfb_event_head);
+    smp_rmb();
+    
+    return ( head );
+}
+
+static bool einkfb_event_ring_empty(einkfb_event_reader_t *reader)
 {
-    return ( einkfb_event_queue_entry == einkfb_event_queue_exit );
+    return ( einkfb_event_ring_head() == reader->tail );
 }
 
 static void einkfb_enqueue_event(einkfb_event_t *event)
 {
     if ( einkfb_valid_event(event) )
     {
-        // Enqueue the passed-in event.
-        //
-        EINKFB_MEMCPYK(&einkfb_event_queue[einkfb_event_queue_entry++], event, sizeof(einkfb_event_t));
-
-        // Wrap back to the start if we've reached the end.
-        //
-        if ( EINKFB_NUM_EVENTS == einkfb_event_queue_entry )
-            einkfb_event_queue_entry = 0;
-
-        // Ensure that we don't accidently go empty.
+        unsigned long flags;
+        
+        spin_lock_irqsave(&einkfb_event_lock, flags);
+        
+        // Fill the slot before publishing it, overwriting the oldest event
+        // if the ring has wrapped; readers account for that themselves.
         //
-        if ( einkfb_event_queue_empty() )
-        {
-            einkfb_event_queue_exit++;
+        einkfb_event_ring[einkfb_event_head & EINKFB_EVENTS_MASK] = *event;
+        smp_wmb();
+        einkfb_event_head++;
         
-            if ( EINKFB_NUM_EVENTS == einkfb_event_queue_exit )
-                einkfb_event_queue_exit = 0;
-        }
+        spin_unlock_irqrestore(&einkfb_event_lock, flags);
     }
 }
 
-static einkfb_event_t *einkfb_dequeue_event(void)
+static bool einkfb_event_reader_lapped(einkfb_event_reader_t *reader, u32 head)
+{
+    return ( (head - reader->tail) >= EINKFB_NUM_EVENTS );
+}
+
+static void einkfb_event_reader_drop(einkfb_event_reader_t *reader, u32 head)
 {
-    einkfb_event_t *result = NULL;
+    u32 dropped = (head - reader->tail) - EINKFB_EVENTS_SAFE;
     
-    if ( !einkfb_event_queue_empty() )
-    {
-        // Dequeue the event.
-        //
-        EINKFB_MEMCPYK(&einkfb_event, &einkfb_event_queue[einkfb_event_queue_exit++], sizeof(einkfb_event_t));
-        result = &einkfb_event;
-        
-        // Wrap back to the start if we've reached the end.
-        //
-        if ( EINKFB_NUM_EVENTS == einkfb_event_queue_exit )
-            einkfb_event_queue_exit = 0;
-    }
+    reader->dropped += dropped;
+    reader->tail += dropped;
+    reader->lapped = true;
     
-    return ( result );
+    atomic_add(dropped, &einkfb_events_dropped);
 }
 
-static void exit_einkfb_event_thread(void)
+// Returns 0 without consuming anything once the posters have lapped the
+// reader, whether before or while copying, so that events from both sides
+// of the gap never come back from the same read.
+//
+static int einkfb_dequeue_events(einkfb_event_reader_t *reader, einkfb_event_t *events, int max_events)
 {
-    einkfb_event_thread_exit = 1;
-    complete(&einkfb_event_thread_complete);
+    int i, num_events;
+    u32 head;
+    
+    // Skip whatever the posters have already lapped us on.
+    //
+    head = einkfb_event_ring_head();
+    
+    if ( einkfb_event_reader_lapped(reader, head) )
+    {
+        einkfb_event_reader_drop(reader, head);
+        return ( 0 );
+    }
+    
+    num_events = min((int)(head - reader->tail), max_events);
+    
+    for ( i = 0; i < num_events; i++ )
+        events[i] = einkfb_event_ring[(reader->tail + i) & EINKFB_EVENTS_MASK];
+    
+    // If the posters lapped us while we were copying, the oldest of the
+    // copied events may have been overwritten, so toss the copy.  Whatever
+    // survived is still in the ring for the next read.
+    //
+    smp_rmb();
+    head = ACCESS_ONCE(einkfb_event_head);
+    
+    if ( einkfb_event_reader_lapped(reader, head) )
+    {
+        einkfb_event_reader_drop(reader, head);
+        return ( 0 );
+    }
+    
+    reader->tail += num_events;
+
+    return ( num_events );
 }
 
-static void einkfb_event_thread_body(void)
+static void einkfb_event_complete_work(struct work_struct *unused)
 {
     // Post that the prior update-display event(s) have completed once they have.
+    // Like deferred I/O, this waits for the hardware from the shared workqueue.
     //
     if ( einkfb_event_timer_active && einkfb_event_timer_primed )
     {
@@ -124,50 +174,6 @@ static void einkfb_event_thread_body(void)
         EINKFB_FSYNC();
         einkfb_post_event(&event);
     }
-    
-    wait_for_completion_interruptible(&einkfb_event_thread_complete);
-}
-
-static int einkfb_event_thread(void *data)
-{
-    int  *exit_thread = (int *)data;
-    bool thread_active = true;
-    
-    THREAD_HEAD(EINKFB_EVENT_THREAD_NAME);
-
-    while ( thread_active )
-    {
-        TRY_TO_FREEZE();
-
-        if ( !THREAD_SHOULD_STOP() )
-        {
-            THREAD_BODY(*exit_thread, einkfb_event_thread_body);
-        }
-        else
-        {
-            thread_active = false;
-        }
-    }
-
-    THREAD_TAIL(einkfb_event_thread_exited);
-}
-
-static void einkfb_start_event_thread(void)
-{
-    einkfb_event_thread_exit = 0;
-    
-    THREAD_START(einkfb_event_thread_id, &einkfb_event_thread_exit, einkfb_event_thread,
-        EINKFB_EVENT_THREAD_NAME);
-}
-
-static void einkfb_stop_event_thread(void)
-{
-    THREAD_STOP(einkfb_event_thread_id, exit_einkfb_event_thread, einkfb_event_thread_exited);
-}
-
-static void einkfb_event_timer_function(unsigned long unused)
-{
-    complete(&einkfb_event_thread_complete);
 }
 
 #if PRAGMAS
@@ -184,61 +190,95 @@ void einkfb_init_event(einkfb_event_t *event)
 
 void einkfb_post_event(einkfb_event_t *event)
 {
-    if ( einkfb_events_access_count )
+    if ( atomic_read(&einkfb_events_access_count) )
     {
         einkfb_enqueue_event(event);
-    
-        if ( !einkfb_event_queue_empty() )
-            wake_up_interruptible(&einkfb_events_read_wait);
+        wake_up_interruptible(&einkfb_events_read_wait);
     }
 }
 
+unsigned long einkfb_get_events_dropped(void)
+{
+    return ( (unsigned long)atomic_read(&einkfb_events_dropped) );
+}
+
 int einkfb_events_open(struct inode *inode, struct file *file)
 {
-    if ( 0 == einkfb_events_access_count++ )
+    einkfb_event_reader_t *reader = kzalloc(sizeof(einkfb_event_reader_t), GFP_KERNEL);
+    int result = EINKFB_EVENT_FAILURE;
+    
+    // Each reader only sees the events posted after it opens.
+    //
+    if ( reader )
     {
-        int i;
+        reader->tail = einkfb_event_ring_head();
+        file->private_data = reader;
         
-        einkfb_event_queue_entry = einkfb_event_queue_exit = 0;
-        
-        for ( i = 0; i < EINKFB_NUM_EVENTS; i++ )
-            einkfb_init_event(&einkfb_event_queue[i]);
+        atomic_inc(&einkfb_events_access_count);
+        result = EINKFB_SUCCESS;
     }
  
-    return ( EINKFB_SUCCESS );
+    return ( result );
 }
 
 int einkfb_events_release(struct inode *inode, struct file *file)
 {
+    einkfb_event_reader_t *reader = (einkfb_event_reader_t *)file->private_data;
     int result = EINKFB_SUCCESS;
     
-    if ( 0 >= einkfb_events_access_count )
+    if ( !reader )
         result = EINKFB_EVENT_FAILURE;
     else
-        einkfb_events_access_count--;
+    {
+        if ( reader->dropped )
+            einkfb_debug("reader dropped %lu events\n", reader->dropped);
+        
+        file->private_data = NULL;
+        kfree(reader);
+        
+        atomic_dec(&einkfb_events_access_count);
+    }
 
     return ( result );
 }
 
 ssize_t einkfb_events_read(struct file *file, char *buf, size_t count, loff_t *ofs)
 {
+    einkfb_event_reader_t *reader = (einkfb_event_reader_t *)file->private_data;
     ssize_t result = 0;
     
-    // Only deal with whole events once someone is looking for them.
+    // Only deal with whole events, but hand back as many as fit.
     //
-    if ( einkfb_events_access_count && (SIZEOF_EINK_EVENT <= count) )
+    if ( reader && (SIZEOF_EINK_EVENT <= count) )
     {
-        einkfb_event_t *event = NULL;
+        einkfb_event_t events[EINKFB_EVENTS_BATCH];
+        int num_events;
         
         // Block until an event occurs.
         //
-        wait_event_interruptible(einkfb_events_read_wait, !einkfb_event_queue_empty());
-        event = einkfb_dequeue_event();
-
-        if ( event )
+        if ( !reader->lapped )
+            wait_event_interruptible(einkfb_events_read_wait, !einkfb_event_ring_empty(reader));
+        
+        while ( !reader->lapped && ((result + SIZEOF_EINK_EVENT) <= count) )
         {
-            if ( EINKFB_SUCCESS == EINKFB_MEMCPYUT(buf, event, SIZEOF_EINK_EVENT) )
-                result = SIZEOF_EINK_EVENT;
+            num_events = einkfb_dequeue_events(reader, events,
+                min((int)((count - result) / SIZEOF_EINK_EVENT), EINKFB_EVENTS_BATCH));
+            
+            if ( 0 == num_events )
+                break;
+            
+            if ( EINKFB_SUCCESS != EINKFB_MEMCPYUT(&buf[result], events, num_events * SIZEOF_EINK_EVENT) )
+                break;
+            
+            result += num_events * SIZEOF_EINK_EVENT;
+        }
+        
+        // Hand back what came before a gap first, then report the gap.
+        //
+        if ( reader->lapped && (0 == result) )
+        {
+            reader->lapped = false;
+            result = -EOVERFLOW;
         }
     }
 
@@ -247,29 +287,36 @@ ssize_t einkfb_events_read(struct file *file, char *buf, size_t count, loff_t *o
 
 unsigned int einkfb_events_poll(struct file *file, poll_table *wait)
 {
+    einkfb_event_reader_t *reader = (einkfb_event_reader_t *)file->private_data;
     unsigned int mask = 0;
 
     poll_wait(file, &einkfb_events_read_wait, wait);
 
-    if ( !einkfb_event_queue_empty() )
+    if ( reader && (reader->lapped || !einkfb_event_ring_empty(reader)) )
         mask |= POLLIN | POLLRDNORM;
     
     return ( mask );
 }
 
+long einkfb_events_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+    einkfb_event_reader_t *reader = (einkfb_event_reader_t *)file->private_data;
+    long result = EINKFB_EVENT_FAILURE;
+    
+    // Tell the reader how many events it has missed since it opened.
+    //
+    if ( reader && (EINKFB_EVENTS_DROPPED == cmd) )
+        result = put_user(reader->dropped, (unsigned long __user *)arg);
+    
+    return ( result );
+}
+
 void einkfb_start_event_timer(void)
 {
     if ( !einkfb_event_timer_active )
     {
-        init_timer(&einkfb_event_timer);
-        
-        einkfb_event_timer.function = einkfb_event_timer_function;
-        einkfb_event_timer.data = 0;
-    
         einkfb_event_timer_active  = true;
         einkfb_event_timer_primed  = false;
-        
-        einkfb_start_event_thread();
     }
 }
 
@@ -280,18 +327,21 @@ void einkfb_stop_event_timer(void)
         einkfb_event_timer_active  = false;
         einkfb_event_timer_primed  = false;
 
-        einkfb_stop_event_thread();
-        del_timer_sync(&einkfb_event_timer);
+        cancel_delayed_work_sync(&einkfb_event_complete);
     }
 }
 
 void einkfb_prime_event_timer(bool delay_timer)
 {
-    if ( einkfb_event_timer_active && (einkfb_events_access_count > 0) )
+    if ( einkfb_event_timer_active && (atomic_read(&einkfb_events_access_count) > 0) )
     {
+        // Push any pending update_display_complete event out by the minimum
+        // update time, or hold it off altogether while an update starts.
+        //
         einkfb_event_timer_primed = delay_timer;
-        mod_timer(&einkfb_event_timer, TIMER_EXPIRES_JIFS(delay_timer ? EINKFB_EVENT_TIMER_DELAY
-                                                                      : MIN_SCHEDULE_TIMEOUT));
+        cancel_delayed_work(&einkfb_event_complete);
+        
+        if ( delay_timer )
+            schedule_delayed_work(&einkfb_event_complete, EINKFB_EVENT_TIMER_DELAY);
     }
 }
-
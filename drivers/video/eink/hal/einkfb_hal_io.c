@@ -21,8 +21,6 @@ struct load_buffer_t
 };
 typedef struct load_buffer_t load_buffer_t;
 
-typedef u8 (*change_area_data_t)(u8 data, int i);
-
 static display_paused_t einkfb_display_paused = display_paused;
 static einkfb_ioctl_hook_t einkfb_ioctl_hook = NULL;
 static unsigned long ioctl_time[2] = { 0, 0 };
@@ -36,10 +34,10 @@ static EINKFB_MUTEX(ioctl_lock);
     #pragma mark -
 #endif
 
-static void einkfb_load_buffer(int x, int y, int rowbytes, int bytes, void *data)
+static void einkfb_load_buffer(int x, int y, int rowbytes, int bytes, int span, void *data)
 {
     load_buffer_t *load_buffer = (load_buffer_t *)data;
-    load_buffer->dst[bytes] = load_buffer->src[(rowbytes * y) + x];
+    memcpy(&load_buffer->dst[bytes], &load_buffer->src[(rowbytes * y) + x], span);
 }
 
 static int einkfb_validate_area_data(update_area_t *update_area)
@@ -140,7 +138,7 @@ static update_area_t *einkfb_set_area_data(unsigned long flag, update_area_t *up
                         load_buffer.src = info.start;
                         load_buffer.dst = buffer;
                         
-                        einkfb_blit(result->x1, result->x2, result->y1, result->y2, einkfb_load_buffer, (void *)&load_buffer);
+                        einkfb_blit_rows(result->x1, result->x2, result->y1, result->y2, einkfb_load_buffer, (void *)&load_buffer);
                         success = EINKFB_SUCCESS;
                     }
                 }
@@ -156,7 +154,7 @@ static update_area_t *einkfb_set_area_data(unsigned long flag, update_area_t *up
     return ( result );
 }
 
-static void einkfb_change_area_data(update_area_t *update_area, change_area_data_t change_area_data)
+static void einkfb_change_area_data(update_area_t *update_area, einkfb_span_t change_area_span)
 {
     int xstart = update_area->x1, xend = update_area->x2,
         ystart = update_area->y1, yend = update_area->y2,
@@ -164,58 +162,61 @@ static void einkfb_change_area_data(update_area_t *update_area, change_area_data
         xres = xend - xstart,
         yres = yend - ystart,
         
-        buffer_size = 0,
-        i;
+        row_size = 0,
+        bytes,
+        y;
         
     u8  *buffer = update_area->buffer;
         
     struct einkfb_info info;
     einkfb_get_info(&info);
     
-    buffer_size = BPP_SIZE((xres * yres), info.bpp);
+    row_size = BPP_SIZE(xres, info.bpp);
     
-    for ( i = 0; i < buffer_size; i++ )
+    // Change a row at a time, yielding whenever we cross another
+    // EINKFB_MEMCPY_MIN bytes.
+    //
+    for ( bytes = 0, y = 0; y < yres; y++, bytes += row_size )
     {
-        buffer[i] = change_area_data(buffer[i], i);
-        EINKFB_SCHEDULE_BLIT(i);
+        (*change_area_span)(&buffer[bytes], row_size);
+        
+        if ( (bytes / EINKFB_MEMCPY_MIN) != ((bytes + row_size) / EINKFB_MEMCPY_MIN) )
+            EINKFB_SCHEDULE();
     }
 }
 
-static u8 invert_area_data(u8 data, int i)
-{
-    return ( ~data );
-}
-
 static void einkfb_invert_area_data(update_area_t *update_area)
 {
-    einkfb_change_area_data(update_area, invert_area_data);
+    einkfb_change_area_data(update_area, einkfb_span_invert);
 }
 
 static void einkfb_posterize_area_data(update_area_t *update_area)
 {
     einkfb_posterize_to_1bpp_begin();
     
-    einkfb_change_area_data(update_area, einkfb_posterize_to_1bpp);
+    einkfb_change_area_data(update_area, einkfb_fx_span);
     
     einkfb_posterize_to_1bpp_end();
 }
 
 static void einkfb_posterize_invert_area_data(update_area_t *update_area)
 {
+    // Posterize and invert in a single pass.
+    //
     einkfb_posterize_to_1bpp_begin();
+    einkfb_invert_begin();
     
-    einkfb_change_area_data(update_area, einkfb_posterize_to_1bpp);
-     
-    einkfb_posterize_to_1bpp_end();
+    einkfb_change_area_data(update_area, einkfb_fx_span);
     
-    einkfb_change_area_data(update_area, invert_area_data);
+    einkfb_invert_end();
+    einkfb_posterize_to_1bpp_end();
 }
 
 static void einkfb_contrast_area_data(update_area_t *update_area)
 {
     einkfb_contrast_begin();
     
-    einkfb_change_area_data(update_area, einkfb_apply_contrast);
+    einkfb_change_area_data(update_area, einkfb_fx_span);
     
     einkfb_contrast_end();
 }
@@ -82,13 +82,47 @@ module_param_named(einkfb_hw_bringup_mode, einkfb_hw_bringup_mode, int, S_IRUGO)
 MODULE_PARM_DESC(einkfb_hw_bringup_mode, "non-zero to fully bring up hardware");
 #endif // MODULE
 
+/*
+ * Kernel-side drawing and write() don't go through deferred I/O, so they
+ * feed the dirty map themselves.
+ */
+static void einkfb_fillrect(struct fb_info *info, const struct fb_fillrect *rect)
+{
+	FB_FILLRECT(info, rect);
+	einkfb_dirty_mark_rows(rect->dy, rect->dy + rect->height);
+}
+
+static void einkfb_copyarea(struct fb_info *info, const struct fb_copyarea *area)
+{
+	FB_COPYAREA(info, area);
+	einkfb_dirty_mark_rows(area->dy, area->dy + area->height);
+}
+
+static void einkfb_imageblit(struct fb_info *info, const struct fb_image *image)
+{
+	FB_IMAGEBLIT(info, image);
+	einkfb_dirty_mark_rows(image->dy, image->dy + image->height);
+}
+
+static ssize_t einkfb_write(struct fb_info *info, const char __user *buf, size_t count, loff_t *ppos)
+{
+	loff_t pos = *ppos;
+	ssize_t result = FB_WRITE(info, buf, count, ppos);
+	
+	if ( 0 < result )
+		einkfb_dirty_mark((unsigned long)pos, result);
+	
+	return ( result );
+}
+
 static struct fb_ops einkfb_ops 		=
 {
 	.owner		= THIS_MODULE,
+	.fb_write	= einkfb_write,
 	.fb_blank	= einkfb_blank,
-	.fb_fillrect	= FB_FILLRECT,
-	.fb_copyarea	= FB_COPYAREA,
-	.fb_imageblit	= FB_IMAGEBLIT,
+	.fb_fillrect	= einkfb_fillrect,
+	.fb_copyarea	= einkfb_copyarea,
+	.fb_imageblit	= einkfb_imageblit,
 	.fb_ioctl	= einkfb_ioctl,
 	.fb_mmap	= einkfb_mmap,
 };
@@ -106,6 +140,7 @@ static struct file_operations einkfb_events_ops =
 	.release	= einkfb_events_release,
 	.read		= einkfb_events_read,
 	.poll		= einkfb_events_poll,
+	.unlocked_ioctl	= einkfb_events_ioctl,
 	.fsync		= einkfb_fsync,
 };
 
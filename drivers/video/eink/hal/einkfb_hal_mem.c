@@ -15,13 +15,74 @@
     #pragma mark -
 #endif
 
+// The dirty map tracks, one bit per page-sized tile of the real framebuffer,
+// which parts of it may differ from the virtual framebuffer.  Deferred I/O,
+// the area-update path, and the kernel-side drawing hooks feed it; full
+// updates take it so that only written tiles get copied and compared.  When
+// a write couldn't be tracked, the map is marked invalid, and the next full
+// update falls back to the whole framebuffer.
+//
+static unsigned long *einkfb_dirty_live = NULL;
+static unsigned long *einkfb_dirty_snap = NULL;
+static int  einkfb_dirty_tiles = 0;
+static bool einkfb_dirty_valid = false;
+static void *einkfb_dirty_base = NULL;
+static DEFINE_SPINLOCK(einkfb_dirty_lock);
+
+// Set while einkfb_deferred_io() issues its update, i.e., while the task
+// in question holds fbdefio's lock and has already marked its pages.
+//
+static struct task_struct *einkfb_defio_task = NULL;
+
+static bool einkfb_dirty_init(void *base, size_t size)
+{
+    int tiles = FB_ROUNDUP(size, PAGE_SIZE) >> PAGE_SHIFT,
+        longs = BITS_TO_LONGS(tiles);
+    
+    einkfb_dirty_live = kzalloc(longs * 2 * sizeof(unsigned long), GFP_KERNEL);
+    
+    if ( einkfb_dirty_live )
+    {
+        einkfb_dirty_snap  = &einkfb_dirty_live[longs];
+        einkfb_dirty_tiles = tiles;
+        einkfb_dirty_base  = base;
+    }
+    
+    einkfb_dirty_valid = false;
+
+    return ( NULL != einkfb_dirty_live );
+}
+
+static void einkfb_dirty_done(void)
+{
+    unsigned long flags;
+    
+    spin_lock_irqsave(&einkfb_dirty_lock, flags);
+    
+    kfree(einkfb_dirty_live);
+    
+    einkfb_dirty_live  = einkfb_dirty_snap = NULL;
+    einkfb_dirty_tiles = 0;
+    einkfb_dirty_valid = false;
+    einkfb_dirty_base  = NULL;
+    
+    spin_unlock_irqrestore(&einkfb_dirty_lock, flags);
+}
+
 static void einkfb_deferred_io(struct fb_info *fb_info, struct list_head *pagelist)
 {
+    struct page *page;
+    
+    // Track the written pages even while the display is paused so that the
+    // full update that follows the pause knows about them.
+    //
+    list_for_each_entry(page, pagelist, lru)
+        einkfb_dirty_mark(page->index << PAGE_SHIFT, PAGE_SIZE);
+
     if ( !EINKFB_DISPLAY_PAUSED() )
     {
         unsigned long beg, end;
         int y1, y2, miny, maxy;
-        struct page *page;
 
         miny = INT_MAX;
         maxy = 0;
@@ -43,6 +104,11 @@ static void einkfb_deferred_io(struct fb_info *fb_info, struct list_head *pageli
         // display if we're updating the entire display since full-display
         // updates are more efficient than an area-update of the full display.
         //
+        // The update runs with fbdefio's lock held, so note that we're the
+        // ones holding it for einkfb_dirty_take().
+        //
+        einkfb_defio_task = current;
+        
         if ( fb_info->var.yres == (maxy - miny) )
             EINKFB_IOCTL(FBIO_EINK_UPDATE_DISPLAY, fx_update_partial);
         else
@@ -58,6 +124,8 @@ static void einkfb_deferred_io(struct fb_info *fb_info, struct list_head *pageli
             
             EINKFB_IOCTL(FBIO_EINK_UPDATE_DISPLAY_AREA, (unsigned long)&update_area);
         }
+        
+        einkfb_defio_task = NULL;
     }
 }
 
@@ -105,12 +173,16 @@ void *einkfb_malloc(size_t size, einkfb_dma_addr_t *phys, bool mmap)
         else
             result = vmalloc(size);
         
-        // Use the deferred I/O mechanism to handle our page mapping.
+        // Use the deferred I/O mechanism to handle our page mapping, and
+        // track which of those pages get written.
         //
         if ( mmap && result )
         {
             info.fbinfo->fbdefio = &einkfb_defio;
             fb_deferred_io_init(info.fbinfo);
+            
+            if ( !einkfb_dirty_init(result, size) )
+                einkfb_debug("no dirty map, full updates will compare everything\n");
         }
     }
     
@@ -126,6 +198,8 @@ void einkfb_free(void *ptr, einkfb_dma_addr_t *phys, bool mmap)
         
         if ( mmap )
         {
+            einkfb_dirty_done();
+            
             fb_deferred_io_cleanup(info.fbinfo);
             info.fbinfo->fbdefio = NULL;
         }
@@ -137,6 +211,117 @@ void einkfb_free(void *ptr, einkfb_dma_addr_t *phys, bool mmap)
     }
 }
 
+void einkfb_dirty_mark(unsigned long offset, unsigned long length)
+{
+    unsigned long flags;
+    
+    if ( length )
+    {
+        spin_lock_irqsave(&einkfb_dirty_lock, flags);
+        
+        if ( einkfb_dirty_live )
+        {
+            int tile = offset >> PAGE_SHIFT,
+                last = (offset + length - 1) >> PAGE_SHIFT;
+            
+            if ( last >= einkfb_dirty_tiles )
+                last = einkfb_dirty_tiles - 1;
+            
+            for ( ; tile <= last; tile++ )
+                __set_bit(tile, einkfb_dirty_live);
+        }
+        
+        spin_unlock_irqrestore(&einkfb_dirty_lock, flags);
+    }
+}
+
+void einkfb_dirty_mark_rows(int y1, int y2)
+{
+    struct einkfb_info info;
+    unsigned long rowbytes;
+    
+    einkfb_get_info(&info);
+    rowbytes = BPP_SIZE(info.xres, info.bpp);
+    
+    if ( y2 > y1 )
+        einkfb_dirty_mark(y1 * rowbytes, (y2 - y1) * rowbytes);
+}
+
+void einkfb_dirty_mark_all(void)
+{
+    unsigned long flags;
+    
+    spin_lock_irqsave(&einkfb_dirty_lock, flags);
+    einkfb_dirty_valid = false;
+    spin_unlock_irqrestore(&einkfb_dirty_lock, flags);
+}
+
+// Hands the caller the tiles written since the last take and assumes the
+// caller will bring the virtual framebuffer back in sync with start.  A NULL
+// return means the map can't be trusted and the whole framebuffer must be
+// synced.  Only the full-update path calls this, under the HAL's lock.
+//
+unsigned long *einkfb_dirty_take(void *start, int *tiles)
+{
+    struct fb_deferred_io *fbdefio;
+    unsigned long *result = NULL, flags;
+    bool pending = false, locked = false;
+    struct einkfb_info info;
+    
+    einkfb_get_info(&info);
+    fbdefio = info.fbinfo->fbdefio;
+    
+    // Pages written since deferred I/O last ran are still on fbdefio's page
+    // list, and haven't been marked yet.  Fold them in.  Deferred I/O issues
+    // updates with fbdefio's lock held, and we're called with the HAL's lock
+    // held, so we can't wait on fbdefio's lock here.  If we can't get it and
+    // it's not ours, assume that everything is dirty.
+    //
+    if ( fbdefio && (current != einkfb_defio_task) )
+    {
+        if ( mutex_trylock(&fbdefio->lock) )
+        {
+            struct page *page;
+            
+            list_for_each_entry(page, &fbdefio->pagelist, lru)
+                einkfb_dirty_mark(page->index << PAGE_SHIFT, PAGE_SIZE);
+            
+            locked = true;
+        }
+        else
+            pending = true;
+    }
+    
+    spin_lock_irqsave(&einkfb_dirty_lock, flags);
+    
+    if ( einkfb_dirty_live )
+    {
+        int longs = BITS_TO_LONGS(einkfb_dirty_tiles);
+        
+        if ( einkfb_dirty_valid && !pending && (start == einkfb_dirty_base) )
+        {
+            memcpy(einkfb_dirty_snap, einkfb_dirty_live, longs * sizeof(unsigned long));
+            result = einkfb_dirty_snap;
+        }
+        
+        memset(einkfb_dirty_live, 0, longs * sizeof(unsigned long));
+        
+        // Syncing from anything other than the real framebuffer (e.g., the
+        // shim's override buffer) leaves the virtual framebuffer out of step
+        // with the real one everywhere.
+        //
+        einkfb_dirty_valid = start == einkfb_dirty_base;
+        *tiles = einkfb_dirty_tiles;
+    }
+    
+    spin_unlock_irqrestore(&einkfb_dirty_lock, flags);
+    
+    if ( locked )
+        mutex_unlock(&fbdefio->lock);
+    
+    return ( result );
+}
+
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,31))
 static void einkfb_memcpy_schedule(u8 *dst, const u8 *src, size_t dst_length, size_t src_length)
 {
@@ -228,3 +413,6 @@ EXPORT_SYMBOL(einkfb_malloc);
 EXPORT_SYMBOL(einkfb_free);
 EXPORT_SYMBOL(einkfb_memcpy);
 EXPORT_SYMBOL(einkfb_memset);
+EXPORT_SYMBOL(einkfb_dirty_mark);
+EXPORT_SYMBOL(einkfb_dirty_mark_rows);
+EXPORT_SYMBOL(einkfb_dirty_mark_all);
@@ -20,6 +20,7 @@
 #define EINKFB_PROC_UPDATE_DISPLAY      "update_display"
 #define EINKFB_PROC_POWER_LEVEL         "power_level"
 #define EINKFB_PROC_VIRTUALFB           "virtual_fb"
+#define EINKFB_PROC_FX_BENCH            "fx_bench"
 
 #define EINKFB_PROC_WAVEFORM_VERSION    "waveform_version"
 #define EINKFB_PROC_WAVEFORM_FILE       "waveform_file"
@@ -29,6 +30,7 @@ static struct proc_dir_entry *einkfb_proc_parent            = NULL;
 static struct proc_dir_entry *einkfb_proc_update_display    = NULL;
 static struct proc_dir_entry *einkfb_proc_power_level       = NULL;
 static struct proc_dir_entry *einkfb_proc_virtualfb         = NULL;
+static struct proc_dir_entry *einkfb_proc_fx_bench          = NULL;
 
 static struct proc_dir_entry *einkfb_proc_waveform_version  = NULL;
 static struct proc_dir_entry *einkfb_proc_waveform_file     = NULL;
@@ -332,6 +334,18 @@ static int virtualfb_read(char *page, char **start, off_t off, int count, int *e
     return ( EINKFB_PROC_SYSFS_RW_NO_LOCK(page, start, off, count, eof, info.size, read_virtualfb) );
 }
 
+// /proc/eink_fb/fx_bench (read-only)
+//
+static int read_fx_bench(char *page, unsigned long off, int count)
+{
+    return ( einkfb_fx_bench(page) );
+}
+
+static int fx_bench_read(char *page, char **start, off_t off, int count, int *eof, void *data)
+{
+    return EINKFB_PROC_SYSFS_RW_NO_LOCK(page, NULL, off, 0, eof, 0, read_fx_bench);
+}
+
 // /proc/eink_fb/waveform_version (read/write)
 //
 static int read_waveform_version(char *page, unsigned long off, int count)
@@ -723,6 +737,13 @@ static ssize_t show_einkfb_display_paused(FB_DSHOW_PARAMS)
     return ( sprintf(buf, "%d\n", einkfb_get_display_paused()) );
 }
 
+// /sys/devices/platform/eink_fb0/events_dropped (read-only)
+//
+static ssize_t show_einkfb_events_dropped(FB_DSHOW_PARAMS)
+{
+    return ( sprintf(buf, "%lu\n", einkfb_get_events_dropped()) );
+}
+
 #if PRAGMAS
     #pragma mark -
     #pragma mark Local Utilities
@@ -744,6 +765,7 @@ static DEVICE_ATTR(reset,               DEVICE_MODE_RW,   show_einkfb_reset,
 
 static DEVICE_ATTR(display_paused,      DEVICE_MODE_R,    show_einkfb_display_paused,      NULL);
 static DEVICE_ATTR(ioctl_time,          DEVICE_MODE_R,    show_einkfb_ioctl_time,          NULL);
+static DEVICE_ATTR(events_dropped,      DEVICE_MODE_R,    show_einkfb_events_dropped,      NULL);
 
 static void einkfb_create_hal_proc_entries(void)
 {
@@ -760,6 +782,9 @@ static void einkfb_create_hal_proc_entries(void)
     einkfb_proc_virtualfb = einkfb_create_proc_entry(EINKFB_PROC_VIRTUALFB, EINKFB_PROC_CHILD_R,
         virtualfb_read, NULL);
     
+    einkfb_proc_fx_bench = einkfb_create_proc_entry(EINKFB_PROC_FX_BENCH, EINKFB_PROC_CHILD_R,
+        fx_bench_read, NULL);
+    
     if ( hal_ops.hal_waveform_version_io )
         einkfb_proc_waveform_version = einkfb_create_proc_entry(EINKFB_PROC_WAVEFORM_VERSION, EINKFB_PROC_CHILD_RW,
             waveform_version_read, waveform_version_write);
@@ -783,6 +808,7 @@ static void einkfb_create_hal_proc_entries(void)
     
     FB_DEVICE_CREATE_FILE(&info.dev->dev, &dev_attr_display_paused);
     FB_DEVICE_CREATE_FILE(&info.dev->dev, &dev_attr_ioctl_time);
+    FB_DEVICE_CREATE_FILE(&info.dev->dev, &dev_attr_events_dropped);
 }
 
 static void einkfb_remove_hal_proc_entries(void)
@@ -794,6 +820,7 @@ static void einkfb_remove_hal_proc_entries(void)
     einkfb_remove_proc_entry(EINKFB_PROC_UPDATE_DISPLAY, einkfb_proc_update_display);
     einkfb_remove_proc_entry(EINKFB_PROC_POWER_LEVEL, einkfb_proc_power_level);
     einkfb_remove_proc_entry(EINKFB_PROC_VIRTUALFB, einkfb_proc_virtualfb);
+    einkfb_remove_proc_entry(EINKFB_PROC_FX_BENCH, einkfb_proc_fx_bench);
     
     if ( hal_ops.hal_waveform_version_io )
         einkfb_remove_proc_entry(EINKFB_PROC_WAVEFORM_VERSION, einkfb_proc_waveform_version);
@@ -815,6 +842,7 @@ static void einkfb_remove_hal_proc_entries(void)
     
     device_remove_file(&info.dev->dev, &dev_attr_display_paused);
     device_remove_file(&info.dev->dev, &dev_attr_ioctl_time);
+    device_remove_file(&info.dev->dev, &dev_attr_events_dropped);
 }
 
 #if PRAGMAS
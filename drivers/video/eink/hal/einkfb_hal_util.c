@@ -386,6 +386,9 @@ einkfb_power_level saved_power_level = einkfb_power_level_init;
 static int einkfb_fast_page_turn_counter = 0;
 static u8  *einkfb_posterize_table = NULL;
 static u8  *einkfb_contrast_table = NULL;
+static bool einkfb_fx_invert = false;
+static bool einkfb_fx_hooked = false;
+static u8   einkfb_fx_table[256];
 static atomic_t einkfb_lock_count = ATOMIC_INIT(0);
 static EINKFB_MUTEX(einkfb_lock);
 
@@ -415,14 +418,12 @@ struct vfb_blit_t
 };
 typedef struct vfb_blit_t vfb_blit_t;
 
-static void einkfb_vfb_blit(int x, int y, int rowbytes, int bytes, void *data)
+static void einkfb_vfb_blit(int x, int y, int rowbytes, int bytes, int span, void *data)
 {
     vfb_blit_t *vfb_blit = (vfb_blit_t *)data;
-    int dst_bytes  = (rowbytes * y) + x;
-    u8  old_pixels = vfb_blit->dst[dst_bytes];
     
-    vfb_blit->dst[dst_bytes] = vfb_blit->src[bytes];
-    vfb_blit->buffers_equal &= old_pixels == vfb_blit->dst[dst_bytes];
+    if ( !einkfb_span_copy_cmp(&vfb_blit->dst[(rowbytes * y) + x], &vfb_blit->src[bytes], span) )
+        vfb_blit->buffers_equal = false;
 }
 
 static bool einkfb_buffers_equal(bool buffers_equal, fx_type update_mode)
@@ -483,7 +484,13 @@ static bool einkfb_update_vfb_area(update_area_t *update_area)
     vfb_blit.src = area_start;
     vfb_blit.dst = fb_start;
     
-    einkfb_blit(x_start, x_end, y_start, y_end, einkfb_vfb_blit, (void *)&vfb_blit);
+    einkfb_blit_rows(x_start, x_end, y_start, y_end, einkfb_vfb_blit, (void *)&vfb_blit);
+    
+    // The virtual framebuffer now holds this area's data, which may not be
+    // what's in the real framebuffer, so the next full update must look at
+    // these rows again.
+    //
+    einkfb_dirty_mark_rows(y_start, y_end);
 
     // Say that an update-display event has occurred if the buffers aren't equal.
     //
@@ -502,6 +509,74 @@ static bool einkfb_update_vfb_area(update_area_t *update_area)
     return ( einkfb_buffers_equal(vfb_blit.buffers_equal, update_area->which_fx) );
 }
 
+// Tiles synced into the virtual framebuffer through an fx can only be reused
+// while the same compiled fx table stays in effect.  Other fx (the shim's, for
+// instance) can't be vouched for at all.
+//
+static fb_apply_fx_t einkfb_dirty_fx = NULL;
+static u8 einkfb_dirty_fx_table[256];
+
+static bool einkfb_dirty_fx_matches(fb_apply_fx_t fb_apply_fx)
+{
+    bool result = false;
+    
+    if ( fb_apply_fx == einkfb_dirty_fx )
+    {
+        if ( !fb_apply_fx )
+            result = true;
+        else
+            if ( einkfb_apply_fx_table == fb_apply_fx )
+                result = 0 == memcmp(einkfb_dirty_fx_table, einkfb_fx_table, sizeof(einkfb_fx_table));
+    }
+    
+    einkfb_dirty_fx = fb_apply_fx;
+    
+    if ( einkfb_apply_fx_table == fb_apply_fx )
+        memcpy(einkfb_dirty_fx_table, einkfb_fx_table, sizeof(einkfb_fx_table));
+    
+    return ( result );
+}
+
+static bool einkfb_update_vfb_range(struct einkfb_info *info, fb_apply_fx_t fb_apply_fx, int start, int end)
+{
+    bool buffers_equal = true;
+    int i;
+    
+    if ( einkfb_apply_fx_table == fb_apply_fx )
+    {
+        // Copy, apply, and compare in a single pass with the compiled table.
+        //
+        buffers_equal = einkfb_fx_copy_cmp(&info->vfb[start], &info->start[start], end - start);
+    }
+    else if ( fb_apply_fx )
+    {
+        u8 old_pixels, *vfb = info->vfb, *fb = info->start;
+        
+        for ( i = start; i < end; i++ )
+        {
+            old_pixels = vfb[i];
+            vfb[i] = fb_apply_fx(fb[i], i);
+            
+            buffers_equal &= old_pixels == vfb[i];
+            EINKFB_SCHEDULE_BLIT(i+1);
+        }
+    }
+    else
+    {
+        u32 old_pixels, *vfb = (u32 *)info->vfb, *fb = (u32 *)info->start;
+        
+        for ( i = start >> 2; i < (end >> 2); i++ )
+        {
+            old_pixels = vfb[i];
+            vfb[i] = fb[i];
+            
+            buffers_equal &= old_pixels == vfb[i];
+        }
+    }
+    
+    return ( buffers_equal );
+}
+
 static bool einkfb_update_vfb(fx_type update_mode)
 {
     bool buffers_equal = true;
@@ -522,36 +597,41 @@ static bool einkfb_update_vfb(fx_type update_mode)
     else
     {    
         fb_apply_fx_t fb_apply_fx = get_fb_apply_fx();
-        int i, len;
-
-        if ( fb_apply_fx )
+        bool per_byte = fb_apply_fx && (einkfb_apply_fx_table != fb_apply_fx);
+        unsigned long *dirty;
+        int tiles = 0, tile, beg, end, synced = 0;
+        
+        // Only copy and compare the tiles that have been written since the
+        // last full update, unless the dirty map can't vouch for the rest.
+        //
+        dirty = einkfb_dirty_take(info.start, &tiles);
+        
+        if ( !einkfb_dirty_fx_matches(fb_apply_fx) )
+            dirty = NULL;
+        
+        if ( dirty )
         {
-            u8 old_pixels, *vfb = info.vfb, *fb = info.start;
-            len = info.size;
-            
-            for ( i = 0; i < len; i++ )
+            for ( tile = find_first_bit(dirty, tiles); tile < tiles; tile = find_next_bit(dirty, tiles, tile + 1) )
             {
-                old_pixels = vfb[i];
-                vfb[i] = fb_apply_fx(fb[i], i);
+                beg = tile << PAGE_SHIFT;
+                end = min(beg + (int)PAGE_SIZE, (int)info.size);
+                
+                if ( beg >= end )
+                    break;
+                
+                buffers_equal &= einkfb_update_vfb_range(&info, fb_apply_fx, beg, end);
                 
-                buffers_equal &= old_pixels == vfb[i];
-                EINKFB_SCHEDULE_BLIT(i+1);
+                if ( !per_byte && ((synced / EINKFB_MEMCPY_MIN) != ((synced + end - beg) / EINKFB_MEMCPY_MIN)) )
+                    EINKFB_SCHEDULE();
+                
+                synced += end - beg;
             }
         }
         else
         {
-            u32 old_pixels, *vfb = (u32 *)info.vfb, *fb = (u32 *)info.start;
-            len = info.size >> 2;
+            buffers_equal = einkfb_update_vfb_range(&info, fb_apply_fx, 0, info.size);
             
-            for ( i = 0; i < len; i++ )
-            {
-                old_pixels = vfb[i];
-                vfb[i] = fb[i];
-                
-                buffers_equal &= old_pixels == vfb[i];
-            }
-            
-            if ( EINKFB_MEMCPY_MIN < i )
+            if ( !per_byte && (EINKFB_MEMCPY_MIN < (info.size >> 2)) )
                 EINKFB_SCHEDULE();
         }
     }
@@ -792,6 +872,141 @@ void einkfb_blit(int xstart, int xend, int ystart, int yend, einkfb_blit_t blit,
     }
 }
 
+// Row-oriented version of einkfb_blit():  one callback per row instead of
+// one per byte, yielding at row boundaries about as often as einkfb_blit().
+//
+void einkfb_blit_rows(int xstart, int xend, int ystart, int yend, einkfb_blit_row_t blit, void *data)
+{
+    if ( blit )
+    {
+        int y, rowbytes, span, bytes;
+        
+        struct einkfb_info info;
+        einkfb_get_info(&info);
+    
+        // Make bpp-related adjustments.
+        //
+        xstart   = BPP_SIZE(xstart,    info.bpp);
+        xend     = BPP_SIZE(xend,      info.bpp);
+        rowbytes = BPP_SIZE(info.xres, info.bpp);
+        span     = xend - xstart;
+        
+        if ( 0 >= span )
+            return;
+    
+        // Blit a row at a time, yielding whenever we cross another
+        // EINKFB_MEMCPY_MIN bytes.
+        //
+        for ( bytes = 0, y = ystart; y < yend; y++, bytes += span )
+        {
+            (*blit)(xstart, y, rowbytes, bytes, span, data);
+            
+            if ( (bytes / EINKFB_MEMCPY_MIN) != ((bytes + span) / EINKFB_MEMCPY_MIN) )
+                EINKFB_SCHEDULE();
+        }
+    }
+}
+
+// Span kernels:  a word at a time when the pointers allow it, a byte at
+// a time otherwise and for the tail.  NEON isn't used, as the kernel
+// doesn't preserve NEON state for kernel-mode use.
+//
+bool einkfb_span_copy_cmp(u8 *dst, u8 *src, int len)
+{
+    u32 diff = 0;
+    int i = 0;
+    
+    if ( 0 == (((unsigned long)dst | (unsigned long)src) & 3) )
+    {
+        u32 *dst32 = (u32 *)dst, *src32 = (u32 *)src;
+        
+        for ( ; (i + 4) <= len; i += 4 )
+        {
+            diff |= *dst32 ^ *src32;
+            *dst32++ = *src32++;
+        }
+    }
+    
+    for ( ; i < len; i++ )
+    {
+        diff |= dst[i] ^ src[i];
+        dst[i] = src[i];
+    }
+    
+    return ( 0 == diff );
+}
+
+void einkfb_span_invert(u8 *buf, int len)
+{
+    int i = 0;
+    
+    if ( 0 == ((unsigned long)buf & 3) )
+    {
+        u32 *buf32 = (u32 *)buf;
+        
+        for ( ; (i + 4) <= len; i += 4, buf32++ )
+            *buf32 = ~*buf32;
+    }
+    
+    for ( ; i < len; i++ )
+        buf[i] = ~buf[i];
+}
+
+static void einkfb_span_lookup(u8 *buf, int len, u8 *table)
+{
+    int i = 0;
+    
+    if ( 0 == ((unsigned long)buf & 3) )
+    {
+        u32 *buf32 = (u32 *)buf, data;
+        
+        for ( ; (i + 4) <= len; i += 4, buf32++ )
+        {
+            data = *buf32;
+            *buf32 = table[data & 0xFF]                 |
+                    (table[(data >>  8) & 0xFF] <<  8)  |
+                    (table[(data >> 16) & 0xFF] << 16)  |
+                    (table[data >> 24]          << 24);
+        }
+    }
+    
+    for ( ; i < len; i++ )
+        buf[i] = table[buf[i]];
+}
+
+static bool einkfb_span_lookup_copy_cmp(u8 *dst, u8 *src, int len, u8 *table)
+{
+    u32 diff = 0;
+    int i = 0;
+    
+    if ( 0 == (((unsigned long)dst | (unsigned long)src) & 3) )
+    {
+        u32 *dst32 = (u32 *)dst, *src32 = (u32 *)src, data;
+        
+        for ( ; (i + 4) <= len; i += 4 )
+        {
+            data = *src32++;
+            data = table[data & 0xFF]                   |
+                  (table[(data >>  8) & 0xFF] <<  8)    |
+                  (table[(data >> 16) & 0xFF] << 16)    |
+                  (table[data >> 24]          << 24);
+            
+            diff |= *dst32 ^ data;
+            *dst32++ = data;
+        }
+    }
+    
+    for ( ; i < len; i++ )
+    {
+        u8 data = table[src[i]];
+        
+        diff |= dst[i] ^ data;
+        dst[i] = data;
+    }
+    
+    return ( 0 == diff );
+}
+
 static einkfb_bounds_failure bounds_failure = einkfb_bounds_failure_none;
 
 einkfb_bounds_failure einkfb_get_last_bounds_failure(void)
@@ -976,6 +1191,71 @@ unsigned char einkfb_stretch_nybble(unsigned char nybble, unsigned long bpp)
     return ( result );
 }
 
+// Posterization, contrast, and inversion are all byte-to-byte mappings, so
+// whichever of them are active get composed into a single 256-entry table
+// that's applied in one pass.  Only posterization and contrast hook the FX
+// mechanism for full-screen updates; inversion is for area data only.
+//
+static void einkfb_fx_compile(void)
+{
+    bool hook = einkfb_posterize_table || einkfb_contrast_table;
+    int i;
+    
+    for ( i = 0; i < 256; i++ )
+    {
+        u8 data = (u8)i;
+        
+        if ( einkfb_posterize_table )
+            data = einkfb_posterize_table[data];
+        
+        if ( einkfb_contrast_table )
+            data = einkfb_contrast_table[data];
+        
+        if ( einkfb_fx_invert )
+            data = ~data;
+        
+        einkfb_fx_table[i] = data;
+    }
+    
+    if ( hook )
+        set_fb_apply_fx(einkfb_apply_fx_table);
+    else
+        if ( einkfb_fx_hooked )
+            set_fb_apply_fx(NULL);
+    
+    einkfb_fx_hooked = hook;
+}
+
+void einkfb_invert_begin(void)
+{
+    einkfb_fx_invert = true;
+    einkfb_fx_compile();
+}
+
+void einkfb_invert_end(void)
+{
+    if ( einkfb_fx_invert )
+    {
+        einkfb_fx_invert = false;
+        einkfb_fx_compile();
+    }
+}
+
+u8 einkfb_apply_fx_table(u8 data, int i)
+{
+    return ( einkfb_fx_table[data] );
+}
+
+void einkfb_fx_span(u8 *buf, int len)
+{
+    einkfb_span_lookup(buf, len, einkfb_fx_table);
+}
+
+bool einkfb_fx_copy_cmp(u8 *dst, u8 *src, int len)
+{
+    return ( einkfb_span_lookup_copy_cmp(dst, src, len, einkfb_fx_table) );
+}
+
 void einkfb_posterize_to_1bpp_begin(void)
 {
     // Ensure that we're truly starting over.
@@ -1021,16 +1301,15 @@ void einkfb_posterize_to_1bpp_begin(void)
     // We exploit the FX mechanism in order to get posterization to work for full-screen
     // updates.
     //
-    if ( einkfb_posterize_table )
-        set_fb_apply_fx(einkfb_posterize_to_1bpp);
+    einkfb_fx_compile();
 }
 
 void einkfb_posterize_to_1bpp_end(void)
 {
     if ( einkfb_posterize_table )
     {
-        set_fb_apply_fx(NULL);
         einkfb_posterize_table = NULL;
+        einkfb_fx_compile();
     }
 }
 
@@ -1044,6 +1323,12 @@ u8 einkfb_posterize_to_1bpp(u8 data, int i)
     return ( result );
 }
 
+void einkfb_posterize_to_1bpp_span(u8 *buf, int len)
+{
+    if ( einkfb_posterize_table )
+        einkfb_span_lookup(buf, len, einkfb_posterize_table);
+}
+
 void einkfb_contrast_begin(void)
 {
     struct einkfb_info info;
@@ -1103,8 +1388,7 @@ void einkfb_contrast_begin(void)
         // We exploit the FX mechanism in order to get contrast to work for full-screen
         // updates.
         //
-        if ( einkfb_contrast_table )
-            set_fb_apply_fx(einkfb_apply_contrast);
+        einkfb_fx_compile();
     }
 }
 
@@ -1112,8 +1396,8 @@ void einkfb_contrast_end(void)
 {
     if ( einkfb_contrast_table )
     {
-        set_fb_apply_fx(NULL);
         einkfb_contrast_table = NULL;
+        einkfb_fx_compile();
     }
 }
 
@@ -1127,6 +1411,93 @@ u8 einkfb_apply_contrast(u8 data, int i)
     return ( result );
 }
 
+void einkfb_apply_contrast_span(u8 *buf, int len)
+{
+    if ( einkfb_contrast_table )
+        einkfb_span_lookup(buf, len, einkfb_contrast_table);
+}
+
+// Times the separate-pass effects against the compiled table over a
+// framebuffer's worth of scratch data.  The table is composed locally so
+// that the live FX state isn't disturbed.
+//
+static u8 einkfb_fx_bench_fx(u8 data, int i)
+{
+    return ( ~contrast_table_medium[data] );
+}
+
+int einkfb_fx_bench(char *page)
+{
+    fb_apply_fx_t volatile fb_apply_fx = einkfb_fx_bench_fx; // Stays an indirect call, as through get_fb_apply_fx().
+    s64 old_area, new_area, old_full, new_full;
+    bool old_equal = true, new_equal;
+    u8 *src, *dst, table[256];
+    int i, len, result = 0;
+    ktime_t start;
+    
+    struct einkfb_info info;
+    einkfb_get_info(&info);
+    
+    len = info.size;
+    src = vmalloc(len);
+    dst = vmalloc(len);
+    
+    if ( src && dst )
+    {
+        for ( i = 0; i < 256; i++ )
+            table[i] = ~contrast_table_medium[i];
+        
+        for ( i = 0; i < len; i++ )
+            src[i] = (u8)((i * 0x9D) ^ (i >> 8));
+        
+        // Area data:  a lookup pass followed by an invert pass vs. one pass.
+        //
+        memcpy(dst, src, len);
+        start = ktime_get();
+        einkfb_span_lookup(dst, len, contrast_table_medium);
+        einkfb_span_invert(dst, len);
+        old_area = ktime_us_delta(ktime_get(), start);
+        
+        memcpy(dst, src, len);
+        start = ktime_get();
+        einkfb_span_lookup(dst, len, table);
+        new_area = ktime_us_delta(ktime_get(), start);
+        
+        // Full-screen:  per-byte FX callback vs. fused copy/lookup/compare.
+        //
+        memcpy(dst, src, len);
+        start = ktime_get();
+        
+        for ( i = 0; i < len; i++ )
+        {
+            u8 old_pixels = dst[i];
+            dst[i] = fb_apply_fx(src[i], i);
+            
+            old_equal &= old_pixels == dst[i];
+        }
+        
+        old_full = ktime_us_delta(ktime_get(), start);
+        
+        memcpy(dst, src, len);
+        start = ktime_get();
+        new_equal = einkfb_span_lookup_copy_cmp(dst, src, len, table);
+        new_full = ktime_us_delta(ktime_get(), start);
+        
+        result  = sprintf(page,          "bytes: %d\n", len);
+        result += sprintf(&page[result], "area: %lld us separate, %lld us fused\n", old_area, new_area);
+        result += sprintf(&page[result], "full: %lld us per-byte, %lld us fused (%s)\n", old_full, new_full,
+            (old_equal == new_equal) ? "match" : "MISMATCH");
+    }
+    
+    if ( dst )
+        vfree(dst);
+    
+    if ( src )
+        vfree(src);
+    
+    return ( result );
+}
+
 void einkfb_display_grayscale_ramp(void)
 {
     int row, num_rows, row_bytes, row_size, row_height, height, adj_count, adj_start;
@@ -1194,6 +1565,7 @@ void einkfb_display_grayscale_ramp(void)
         einkfb_memset(row_start, row_gray, row_size);
         row_start += row_size;
     }
+    einkfb_dirty_mark_all();
 
     // Now, update the display with our grayscale ramp.
     //
@@ -1492,6 +1864,7 @@ void einkfb_clear_display(fx_type update_mode)
 {
     struct einkfb_info info; einkfb_get_info(&info);
     einkfb_memset(info.start, einkfb_white(info.bpp), info.size);
+    einkfb_dirty_mark_all();
     
     einkfb_update_display(update_mode);
 }
@@ -1518,6 +1891,8 @@ bool einkfb_set_display_orientation(orientation_t orientation)
             einkfb_event_t event;
             einkfb_init_event(&event);
             
+            einkfb_dirty_mark_all();
+            
             event.event = einkfb_event_rotate_display;
             event.orientation = orientation;
             
@@ -1909,6 +2284,9 @@ EXPORT_SYMBOL(einkfb_lock_release);
 EXPORT_SYMBOL(einkfb_lock_entry);
 EXPORT_SYMBOL(einkfb_lock_exit);
 EXPORT_SYMBOL(einkfb_blit);
+EXPORT_SYMBOL(einkfb_blit_rows);
+EXPORT_SYMBOL(einkfb_span_copy_cmp);
+EXPORT_SYMBOL(einkfb_span_invert);
 EXPORT_SYMBOL(einkfb_stretch_nybble);
 EXPORT_SYMBOL(einkfb_get_last_bounds_failure);
 EXPORT_SYMBOL(einkfb_bounds_are_acceptable);
@@ -34,6 +34,8 @@ static void buffer_copy(int which);
 #define CHECK_FRAMEWORK_RUNNING()			(FRAMEWORK_STARTED() && !FRAMEWORK_RUNNING())
 
 #define ALREADY_UNCOMPRESSED				(-1)
+#define ASSET_CACHE_ENTRIES				16
+#define ASSET_CACHE_MAX_SIZE				(1024 * 1024)
 #define PROGRESSBAR_Y					(-1)
 #define PROGRESSBAR_X					(-1)
 
@@ -68,6 +70,25 @@ static int shim_picture_len = 0;
 static u_long picture_buffer_size = 0;
 static u8 *picture_buffer = NULL;
 
+// Compiled-in pictures, already uncompressed and converted to the framebuffer's
+// depth.  The shim draws unrotated (the HAL rotates), so the converted bytes
+// only depend on the depth and on whether the picture is overlaid or blitted.
+//
+struct asset_cache_t
+{
+	u8	*picture;	// Compressed picture (key).
+	u32	bpp;		// Framebuffer depth (key).
+	bool	overlay;	// Overlaid vs. blitted (key).
+	int	xres, yres;	// The whole picture, including any overlay mask.
+	int	size;
+	u8	*start;
+};
+typedef struct asset_cache_t asset_cache_t;
+
+static asset_cache_t asset_cache[ASSET_CACHE_ENTRIES];
+static int asset_cache_count = 0;
+static int asset_cache_size = 0;
+
 static bool kernelbuffer_local = false;
 static u_long kernelbuffer_size = 0;
 static u8 *kernelbuffer = NULL;
@@ -121,10 +142,10 @@ struct buffer_blit_t
 };
 typedef struct buffer_blit_t buffer_blit_t;
 
-static void blit_buffer(int x, int y, int rowbytes, int bytes, void *data)
+static void blit_buffer(int x, int y, int rowbytes, int bytes, int span, void *data)
 {
 	buffer_blit_t *buffer_blit = (buffer_blit_t *)data;
-	buffer_blit->dst[(rowbytes * y) + x] = buffer_blit->src[bytes];
+	memcpy(&buffer_blit->dst[(rowbytes * y) + x], &buffer_blit->src[bytes], span);
 }
 
 static void update_display_area_buffer(update_area_t *update_area)
@@ -158,7 +179,9 @@ static void update_display_area_buffer(update_area_t *update_area)
 	buffer_blit.src = area_start;
 	buffer_blit.dst = fb_start;
 	
-	einkfb_blit(x_start, x_end, y_start, y_end, blit_buffer, (void *)&buffer_blit);
+	einkfb_blit_rows(x_start, x_end, y_start, y_end, blit_buffer, (void *)&buffer_blit);
+	einkfb_dirty_mark_rows(y_start, y_end);
+	
 	memcpy_from_framebuffer_to_kernelbuffer();
 }
 
@@ -219,12 +242,18 @@ static void buffer_copy(int which)
 	}
 	
 	if ( src && dst )
+	{
 		EINKFB_MEMCPYK(dst, src, kernelbuffer_size);
+		
+		if ( framebuffer == dst )
+			einkfb_dirty_mark_all();
+	}
 }
 
 static void clear_frame_buffer(void)
 {
 	einkfb_memset(framebuffer, einkfb_white(framebuffer_bpp), framebuffer_size);
+	einkfb_dirty_mark_all();
 }
 
 static void clear_kernel_buffer(void)
@@ -245,6 +274,7 @@ static void clear_vfb(u8 clear)
 {
 	struct einkfb_info info; einkfb_get_info(&info);
 	einkfb_memset(info.vfb, clear, info.size);
+	einkfb_dirty_mark_all();
 }
 
 void clear_buffers(bool force_buffers_not_equal)
@@ -973,6 +1003,105 @@ static void blit_splash_screen(int x, int y, int rowbytes, int bytes, void *data
 	kernelbuffer[(rowbytes * y) + x] = get_picture_byte(blit_picture->start, blit_picture->bpp, bytes);
 }
 
+static asset_cache_t *add_picture_asset(picture_info_type *picture_info, int picture_len, u8 *picture, bool overlay)
+{
+	asset_cache_t *asset = NULL;
+	raw_image_t *raw = uncompress_picture(picture_len, picture);
+	
+	if ( raw && picture_is_acceptable(picture_info, raw) )
+	{
+		int	picture_bpp  = raw->bpp,
+			picture_size = BPP_SIZE((raw->xres * raw->yres), picture_bpp),
+			size = BPP_SIZE((raw->xres * raw->yres), framebuffer_bpp),
+			slack = 0, i;
+		u8	*start = NULL;
+		
+		// When a blitted picture isn't byte aligned, each of its rows can span one
+		// more framebuffer byte than its own rowbytes; leave (white) room for that.
+		//
+		if ( !overlay )
+			slack = raw->yres;
+		
+		// Don't let the cache grow without bound.
+		//
+		if ( (asset_cache_size + size + slack) <= ASSET_CACHE_MAX_SIZE )
+			start = vmalloc(size + slack);
+		
+		if ( start )
+		{
+			// Convert the picture the way it would have been on the way to the screen:
+			// overlays are stretched as a whole, and blitted pictures a byte at a time.
+			//
+			if ( overlay )
+			{
+				if ( picture_bpp != framebuffer_bpp )
+					stretch_bits(raw->start, &picture_bpp, &picture_size);
+				
+				EINKFB_MEMCPYK(start, raw->start, picture_size);
+			}
+			else
+			{
+				for ( i = 0; i < size; i++ )
+				{
+					start[i] = get_picture_byte(raw->start, picture_bpp, i);
+					EINKFB_SCHEDULE_BLIT(i+1);
+				}
+				
+				einkfb_memset(&start[size], einkfb_white(framebuffer_bpp), slack);
+				size += slack;
+			}
+			
+			asset = &asset_cache[asset_cache_count++];
+			
+			asset->picture	= picture;
+			asset->bpp	= framebuffer_bpp;
+			asset->overlay	= overlay;
+			asset->xres	= raw->xres;
+			asset->yres	= raw->yres;
+			asset->size	= size;
+			asset->start	= start;
+			
+			asset_cache_size += size;
+		}
+	}
+	
+	return ( asset );
+}
+
+static asset_cache_t *get_picture_asset(picture_info_type *picture_info, int picture_len, u8 *picture)
+{
+	asset_cache_t *asset = NULL;
+	
+	// Only compressed pictures with headers get cached.  Anything else was
+	// either built on the fly or is already in a form we can use as is.
+	//
+	if ( picture && (0 < picture_len) && !picture_info->headerless )
+	{
+		bool overlay = (update_overlay == picture_info->update) || (update_overlay_mask == picture_info->update);
+		int i;
+		
+		for ( i = 0; (i < asset_cache_count) && !asset; i++ )
+			if ( (picture == asset_cache[i].picture) && (framebuffer_bpp == asset_cache[i].bpp) && (overlay == asset_cache[i].overlay) )
+				asset = &asset_cache[i];
+		
+		if ( !asset && (ASSET_CACHE_ENTRIES > asset_cache_count) )
+			asset = add_picture_asset(picture_info, picture_len, picture, overlay);
+	}
+	
+	return ( asset );
+}
+
+static void free_picture_assets(void)
+{
+	int i;
+	
+	for ( i = 0; i < asset_cache_count; i++ )
+		vfree(asset_cache[i].start);
+	
+	asset_cache_count = 0;
+	asset_cache_size = 0;
+}
+
 static void display_splash_screen(splash_screen_type which_screen)
 {
 	// Whether we're being asked to draw the same screen or not,
@@ -987,6 +1116,7 @@ static void display_splash_screen(splash_screen_type which_screen)
 	{
 		picture_info_type *picture_info = NULL;
 		reboot_behavior_t reboot_behavior;
+		asset_cache_t *asset = NULL;
 		raw_image_t *picture = NULL;
 		int splash_screen = 1;
 		int picture_len = 0;
@@ -1026,7 +1156,12 @@ static void display_splash_screen(splash_screen_type which_screen)
 			break;
 		}
 				
-		if ( splash_screen && (NULL != (picture = uncompress_picture(picture_len, (u8 *)picture))) )
+		// Use the cached copy of the picture if we have (or can make) one.
+		//
+		if ( splash_screen )
+			asset = get_picture_asset(picture_info, picture_len, (u8 *)picture);
+		
+		if ( asset || (splash_screen && (NULL != (picture = uncompress_picture(picture_len, (u8 *)picture)))) )
 		{
 			update_type update = picture_info->update;
 
@@ -1034,18 +1169,26 @@ static void display_splash_screen(splash_screen_type which_screen)
 			// source picture, and are, otherwise, exactly the same size as the source
 			// picture.  Thus, their xres is the same but their yres is double.
 			//
-			if ( update_overlay_mask == update )
+			if ( !asset && (update_overlay_mask == update) )
 				picture->yres /= 2;
 			
-			if ( picture_is_acceptable(picture_info, picture) )
+			if ( asset || picture_is_acceptable(picture_info, picture) )
 			{
 				int	picture_xres, picture_yres, picture_bpp;
 				u32	x_start, x_end, y_start, y_end;
 				u8  	*picture_start;
 
-				// If the picture is headerless, get the header information from picture_info.
+				// Cached pictures are already at the framebuffer's depth.  If the picture
+				// is headerless, get the header information from picture_info.
 				//
-				if ( picture_info->headerless )
+				if ( asset )
+				{
+					picture_xres  = asset->xres;
+					picture_yres  = (update_overlay_mask == update) ? (asset->yres / 2) : asset->yres;
+					picture_bpp   = asset->bpp;
+					picture_start = asset->start;
+				}
+				else if ( picture_info->headerless )
 				{
 					picture_xres  = picture_info->xres;
 					picture_yres  = picture_info->yres;
@@ -1101,18 +1244,30 @@ static void display_splash_screen(splash_screen_type which_screen)
 				else
 				{
 					blit_picture_t blit_picture;
+					buffer_blit_t buffer_blit;
 					
 					// Clear background when we're doing full updates
 					//
 					if ( (update_full == update) || (update_full_refresh == update) )
 						clear_kernel_buffer();
 					
-					// Blit to kernelbuffer and update the display.
+					// Blit to kernelbuffer and update the display.  Cached pictures
+					// are already converted, so they're just row copies.
 					//
-					blit_picture.start = picture_start;
-					blit_picture.bpp   = picture_bpp;
-
-					einkfb_blit(x_start, x_end, y_start, y_end, blit_splash_screen, (void *)&blit_picture);
+					if ( asset )
+					{
+						buffer_blit.src = picture_start;
+						buffer_blit.dst = kernelbuffer;
+						
+						einkfb_blit_rows(x_start, x_end, y_start, y_end, blit_buffer, (void *)&buffer_blit);
+					}
+					else
+					{
+						blit_picture.start = picture_start;
+						blit_picture.bpp   = picture_bpp;
+	
+						einkfb_blit(x_start, x_end, y_start, y_end, blit_splash_screen, (void *)&blit_picture);
+					}
 		
 					if ( picture_info->to_screen )
 						update_display((update_full_refresh == update) ? fx_update_full : fx_update_partial);
@@ -2149,6 +2304,8 @@ static void einkfb_shim_dealloc(void)
 {
 	// Perform memory deallocations and unmappings.
 	//
+	free_picture_assets();
+	
 	if ( kernelbuffer )
 	{
 		if ( kernelbuffer_local )
@@ -57,18 +57,58 @@ static void done_z_inflate_workspace(void)
 	}
 }
 
-static int panel_gunzip(unsigned char *dst, int dstlen, unsigned char *src, unsigned long *lenp)
+/*
+ * Streaming gunzip:  compressed input is pulled a chunk at a time from a
+ * reader, inflated as it arrives, and checked against the gzip trailer's
+ * CRC-32 and length as the output is produced.
+ */
+#define PANEL_GUNZIP_CHUNK_SIZE	(16 * 1024)
+#define GZIP_HEADER_SIZE	10
+#define GZIP_TRAILER_SIZE	8
+
+#define GZIP_LE32(b)		((unsigned long)(b)[0] | ((unsigned long)(b)[1] << 8) | \
+				((unsigned long)(b)[2] << 16) | ((unsigned long)(b)[3] << 24))
+
+/* Returns the number of bytes at *chunk, 0 at end of input, < 0 on error. */
+typedef int (*panel_read_chunk_t)(void *ctx, unsigned char **chunk);
+
+struct panel_mem_reader {
+	unsigned char *src;
+	unsigned long len;
+};
+
+static int panel_read_mem_chunk(void *ctx, unsigned char **chunk)
 {
-	z_stream s;
-	int r, i, flags;
+	struct panel_mem_reader *reader = ctx;
+	int len = reader->len;
 
-	if (!init_z_inflate_workspace()) {
-		pr_debug ("Error: gunzip failed to allocate workspace\n");
+	*chunk = reader->src;
+	reader->src += len;
+	reader->len = 0;
+
+	return (len);
+}
+
+struct panel_file_reader {
+	int file;
+	unsigned char *buf;
+};
+
+static int panel_read_file_chunk(void *ctx, unsigned char **chunk)
+{
+	struct panel_file_reader *reader = ctx;
+
+	*chunk = reader->buf;
+	return (sys_read(reader->file, reader->buf, PANEL_GUNZIP_CHUNK_SIZE));
+}
+
+static int panel_gunzip_header(unsigned char *src, int len)
+{
+	int i = GZIP_HEADER_SIZE, flags;
+
+	if (len < GZIP_HEADER_SIZE)
 		return (-1);
-	}
-	
-	/* skip header */
-	i = 10;
+
 	flags = src[3];
 	if (src[2] != DEFLATED || (flags & RESERVED) != 0) {
 		pr_debug ("Error: Bad gzipped data\n");
@@ -77,40 +117,139 @@ static int panel_gunzip(unsigned char *dst, int dstlen, unsigned char *src, unsi
 	if ((flags & EXTRA_FIELD) != 0)
 		i = 12 + src[10] + (src[11] << 8);
 	if ((flags & ORIG_NAME) != 0)
-		while (src[i++] != 0)
+		while (i < len && src[i++] != 0)
 			;
 	if ((flags & COMMENT) != 0)
-		while (src[i++] != 0)
+		while (i < len && src[i++] != 0)
 			;
 	if ((flags & HEAD_CRC) != 0)
 		i += 2;
-	if (i >= *lenp) {
+	if (i >= len) {
 		pr_debug ("Error: gunzip out of data in header\n");
 		return (-1);
 	}
 
+	return (i);
+}
+
+static int panel_gunzip_stream(unsigned char *dst, int dstlen, panel_read_chunk_t read_chunk,
+	void *ctx, unsigned long *lenp)
+{
+	unsigned char trailer[GZIP_TRAILER_SIZE], *chunk, *out;
+	unsigned long crc = 0, isize;
+	int r, i, len, have = 0, result = -1;
+	z_stream s;
+
+	if (!init_z_inflate_workspace()) {
+		pr_debug ("Error: gunzip failed to allocate workspace\n");
+		return (-1);
+	}
+
+	/* The header is expected to arrive with the first chunk. */
+	len = read_chunk(ctx, &chunk);
+	i = panel_gunzip_header(chunk, len);
+	if (i < 0)
+		goto done;
+
 	/* Initialize ourself. */
 	s.workspace = z_inflate_workspace;
 	r = zlib_inflateInit2(&s, -MAX_WBITS);
 	if (r != Z_OK) {
 		pr_debug ("Error: zlib_inflateInit2() returned %d\n", r);
-		return (-1);
+		goto done;
 	}
-	s.next_in = src + i;
-	s.avail_in = *lenp - i;
+	s.next_in = chunk + i;
+	s.avail_in = len - i;
 	s.next_out = dst;
 	s.avail_out = dstlen;
-	r = zlib_inflate(&s, Z_FINISH);
-	if (r != Z_OK && r != Z_STREAM_END) {
-		pr_debug ("Error: zlib_inflate() returned %d\n", r);
-		return (-1);
+
+	do {
+		if (s.avail_in == 0) {
+			len = read_chunk(ctx, &chunk);
+			if (len <= 0) {
+				pr_debug ("Error: gunzip out of data\n");
+				goto end;
+			}
+			s.next_in = chunk;
+			s.avail_in = len;
+		}
+
+		out = s.next_out;
+		r = zlib_inflate(&s, Z_SYNC_FLUSH);
+		crc = update_crc(crc, out, s.next_out - out);
+
+		if (r != Z_OK && r != Z_STREAM_END) {
+			pr_debug ("Error: zlib_inflate() returned %d\n", r);
+			goto end;
+		}
+		if (r == Z_OK && s.avail_out == 0) {
+			pr_debug ("Error: gunzip out of room\n");
+			goto end;
+		}
+	} while (r != Z_STREAM_END);
+
+	/* The trailer follows the deflate data, possibly in the next chunk(s). */
+	while (have < GZIP_TRAILER_SIZE) {
+		if (s.avail_in == 0) {
+			len = read_chunk(ctx, &chunk);
+			if (len <= 0) {
+				pr_debug ("Error: gunzip out of data in trailer\n");
+				goto end;
+			}
+			s.next_in = chunk;
+			s.avail_in = len;
+		}
+		trailer[have++] = *s.next_in++;
+		s.avail_in--;
+	}
+
+	*lenp = s.next_out - dst;
+	isize = GZIP_LE32(&trailer[4]);
+
+	if (crc != GZIP_LE32(&trailer[0]) || isize != *lenp) {
+		printk(KERN_ERR "gunzip: CRC or length mismatch\n");
+		goto end;
 	}
-	*lenp = s.next_out - (unsigned char *) dst;
-	zlib_inflateEnd(&s);
 
+	result = 0;
+end:
+	zlib_inflateEnd(&s);
+done:
 	done_z_inflate_workspace();
 
-	return (0);
+	return (result);
+}
+
+static int panel_gunzip(unsigned char *dst, int dstlen, unsigned char *src, unsigned long *lenp)
+{
+	struct panel_mem_reader reader = { src, *lenp };
+
+	return (panel_gunzip_stream(dst, dstlen, panel_read_mem_chunk, &reader, lenp));
+}
+
+static int panel_gunzip_file(unsigned char *dst, int dstlen, char *path, unsigned long *lenp)
+{
+	struct panel_file_reader reader;
+	mm_segment_t saved_fs;
+	int result = -1;
+
+	reader.buf = kmalloc(PANEL_GUNZIP_CHUNK_SIZE, GFP_KERNEL);
+	if (!reader.buf)
+		return (-1);
+
+	saved_fs = get_fs();
+	set_fs(get_ds());
+
+	reader.file = sys_open(path, O_RDONLY, 0);
+	if (0 <= reader.file) {
+		result = panel_gunzip_stream(dst, dstlen, panel_read_file_chunk, &reader, lenp);
+		sys_close(reader.file);
+	}
+
+	set_fs(saved_fs);
+	kfree(reader.buf);
+
+	return (result);
 }
 
 /**
@@ -130,11 +269,46 @@ static u8 *panel_get_waveform_from_flash(int offset, u8 *buffer, int buffer_size
         set_flash_select(saved_flash_select);
     }
     else
-        memset(&buffer[offset], 0, buffer_size);
+        memset(buffer, 0, buffer_size);
     
     return ( buffer );
 }
 
+// Read the rest of the waveform in after its header a chunk at a time,
+// running its checksum over each chunk as it comes in instead of making
+// another pass over the whole thing afterwards.
+//
+#define PANEL_WAVEFORM_CHUNK_SIZE (16 * 1024)
+
+static void panel_stream_waveform_from_flash(u8 *buffer, int filesize)
+{
+    unsigned long *long_buffer = (unsigned long *)buffer, embedded_checksum, checksum;
+    bool has_crc = 0 != long_buffer[EINK_ADDR_FILESIZE >> 2];
+    int offset, chunk_size;
+    
+    if ( EINK_WAVEFORM_FILESIZE < filesize )
+        filesize = EINK_WAVEFORM_FILESIZE;
+    
+    // The checksum covers the whole file with its own four bytes zeroed.
+    //
+    embedded_checksum = long_buffer[EINK_ADDR_CHECKSUM >> 2];
+    long_buffer[EINK_ADDR_CHECKSUM >> 2] = 0;
+    checksum = update_crc(0, buffer, WFM_HDR_SIZE);
+    long_buffer[EINK_ADDR_CHECKSUM >> 2] = embedded_checksum;
+    
+    for ( offset = WFM_HDR_SIZE; offset < filesize; offset += chunk_size )
+    {
+        chunk_size = min(filesize - offset, PANEL_WAVEFORM_CHUNK_SIZE);
+        
+        panel_get_waveform_from_flash(offset, &buffer[offset], chunk_size);
+        checksum = update_crc(checksum, &buffer[offset], chunk_size);
+    }
+    
+    if ( has_crc && (checksum != embedded_checksum) )
+        printk(KERN_ERR "waveform checksum mismatch (0x%08lX != 0x%08lX)\n",
+            checksum, embedded_checksum);
+}
+
 static void panel_get_waveform(u8 *buffer, int buffer_size)
 {
     pr_debug("%s: begin\n", __FUNCTION__);
@@ -148,6 +322,7 @@ static void panel_get_waveform(u8 *buffer, int buffer_size)
         
 	pr_debug("%s: reading waveform\n", __FUNCTION__);
 
+        einkwf_index_clr();
         memcpy(panel_waveform_buffer, which_buffer, which_size);
         einkwf_set_buffer_size(which_size);
         einkwf_set_buffer(panel_waveform_buffer);
@@ -169,9 +344,7 @@ static void panel_get_waveform(u8 *buffer, int buffer_size)
 
 		pr_debug("%s: reading waveform from flash\n", __FUNCTION__);
 
-                panel_get_waveform_from_flash(WFM_HDR_SIZE,
-                    (which_buffer + WFM_HDR_SIZE),
-                    (waveform_info.filesize - WFM_HDR_SIZE));
+                panel_stream_waveform_from_flash(which_buffer, waveform_info.filesize);
 	    }
 
 	    pr_debug("%s: read waveform size %ld\n", __FUNCTION__, waveform_info.filesize);
@@ -329,40 +502,30 @@ u8 *panel_read_waveform_from_file(char *waveform_file_path, int *waveform_proxy_
 
 static u8 *use_panel_proxy(int *waveform_proxy_size)
 {
-    u8 *result = NULL, *waveform_proxy_gzipped = NULL;
-    *waveform_proxy_size = EINK_WAVEFORM_FILESIZE;
+    u8 *result = vmalloc(EINK_WAVEFORM_PROXY_SIZE);
     
-    // First, attempt to read the gzipped waveform proxy file in.
-    //
-    waveform_proxy_gzipped = read_waveform_file_proxy(WAVEFORM_PROXY_GZIPPED_PATH, waveform_proxy_size);
-
-    if ( waveform_proxy_gzipped )
+    if ( result )
     {
-        result = vmalloc(EINK_WAVEFORM_PROXY_SIZE);
+        unsigned long proxy_size = 0;
         
-        if ( result )
+        // Inflate the gzipped waveform proxy file as it's read in rather than
+        // reading all of it in first.
+        //
+        if ( panel_gunzip_file(result, EINK_WAVEFORM_PROXY_SIZE, WAVEFORM_PROXY_GZIPPED_PATH, &proxy_size) == 0 )
         {
-            // Now, attempt to gunzip the waveform proxy file.
+            pr_debug("using stored waveform\n");
+            *waveform_proxy_size = proxy_size;
+            
+            // Say that we just need the waveform header information from the panel.
             //
-            if ( panel_gunzip(result, EINK_WAVEFORM_PROXY_SIZE, waveform_proxy_gzipped, (unsigned long *)waveform_proxy_size) == 0 )
-            {
-                pr_debug("using stored waveform\n");
-                
-                // Say that we just need the waveform header information from the panel.
-                //
-                panel_waveform_header_only = true;
-                panel_set_waveform(NULL, 0);
-            }
-            else
-            {
-                vfree(result);
-                result = NULL;
-            }
+            panel_waveform_header_only = true;
+            panel_set_waveform(NULL, 0);
+        }
+        else
+        {
+            vfree(result);
+            result = NULL;
         }
-        
-        // Free the gzipped buffer as we no longer need it.
-        //
-        vfree(waveform_proxy_gzipped);
     }
     
     return ( result );
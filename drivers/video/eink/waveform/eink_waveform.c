@@ -516,6 +516,188 @@ unsigned long eink_get_computed_waveform_checksum(unsigned char *buffer)
     return ( checksum );
 }
 
+// Mode and temperature tables hold 3-byte little-endian addresses, each followed by a checksum byte.
+//
+#define EINK_WAVEFORM_ADDR_OK(a, n) (((a) + (n)) <= (unsigned long)einkwf_get_buffer_size())
+
+static unsigned long eink_read_waveform_addr(unsigned long addr)
+{
+    unsigned char addr0, addr1, addr2;
+    
+    eink_read_byte(addr + 0, &addr0);
+    eink_read_byte(addr + 1, &addr1);
+    eink_read_byte(addr + 2, &addr2);
+    
+    return ( (addr2 << 16) | (addr1 << 8) | addr0 );
+}
+
+// Frame data is a byte of four 2-bit drive values (low bits first) followed, while
+// run-length encoding is on, by a repeat count.  EINK_WAVEFORM_RLE_TOGGLE switches
+// the encoding, and EINK_WAVEFORM_RLE_END ends the data.  Without frames to fill in,
+// the drive values are just counted.
+//
+static unsigned long eink_decode_waveform_lut(unsigned long addr, unsigned char *frames, int num_entries, int *entries)
+{
+    unsigned long start = addr, end = einkwf_get_buffer_size();
+    unsigned char data, count;
+    int entry, repeat;
+    bool rle = true;
+    
+    for ( entry = 0; (addr < end) && (entry < num_entries); )
+    {
+        eink_read_byte(addr++, &data);
+        
+        if ( EINK_WAVEFORM_RLE_TOGGLE == data )
+        {
+            rle = !rle;
+            continue;
+        }
+        
+        if ( rle )
+        {
+            if ( (EINK_WAVEFORM_RLE_END == data) || (addr >= end) )
+                break;
+            
+            eink_read_byte(addr++, &count);
+        }
+        else
+            count = 0;
+        
+        // The repeat byte counts extra copies, so 0xFF means 256 of them.
+        //
+        for ( repeat = count + 1; repeat && (entry < num_entries); repeat-- )
+        {
+            if ( frames )
+            {
+                frames[entry + 0] = (data >> 0) & 3;
+                frames[entry + 1] = (data >> 2) & 3;
+                frames[entry + 2] = (data >> 4) & 3;
+                frames[entry + 3] = (data >> 6) & 3;
+            }
+            
+            entry += 4;
+        }
+    }
+    
+    *entries = entry;
+    
+    return ( addr - start );
+}
+
+void eink_index_waveform(eink_waveform_index_t *index)
+{
+    unsigned char mode_count, temp_range_count;
+    int i, num_bounds;
+    
+    memset(index, 0, sizeof(eink_waveform_index_t));
+    
+    eink_get_waveform_info(&index->info);
+    
+    strlcpy(index->version_string, eink_get_waveform_version_string(eink_waveform_version_string),
+        EINK_WF_VERSION_STRING_MAX);
+    strlcpy(index->filename, eink_get_waveform_version_string(eink_waveform_filename),
+        EINK_WF_VERSION_STRING_MAX);
+    
+    index->valid = eink_waveform_valid();
+    
+    // Index the temperature ranges, clipping them to what we have room for.
+    //
+    eink_read_byte(EINK_ADDR_MODE_COUNT,       &mode_count);
+    eink_read_byte(EINK_ADDR_TEMP_RANGE_COUNT, &temp_range_count);
+    
+    index->num_modes = mode_count + 1;
+    num_bounds = min(temp_range_count + 2, EINK_WF_INDEX_TEMP_RANGES + 1);
+    
+    if ( EINK_WAVEFORM_ADDR_OK(EINK_ADDR_TEMP_RANGE_TABLE, num_bounds) )
+    {
+        for ( i = 0; i < num_bounds; i++ )
+            eink_read_byte(EINK_ADDR_TEMP_RANGE_TABLE + i, &index->temp_bounds[i]);
+        
+        einkwf_index_temp_ranges(&index->temps, index->temp_bounds, num_bounds);
+    }
+}
+
+void eink_index_waveform_luts(eink_waveform_index_t *index)
+{
+    unsigned long addr, mode_table, temp_table;
+    int mode, num_modes, temp_range, entries;
+    eink_waveform_lut_info_t *lut_info;
+    unsigned char luts;
+    
+    index->luts_indexed = true;
+    eink_read_byte(EINK_ADDR_LUTS, &luts);
+    
+    // Only 4-bit (16 gray level) waveforms are indexed.
+    //
+    if ( EINK_WAVEFORM_LUTS_5BIT(luts) || !EINK_WAVEFORM_ADDR_OK(EINK_ADDR_MODE_TABLE, EINK_WAVEFORM_PTR_SIZE) )
+    {
+        pr_debug("unsupported waveform LUTs (luts = 0x%02X)\n", luts);
+        return;
+    }
+    
+    // Mode table -> temperature table -> frame data.
+    //
+    mode_table = eink_read_waveform_addr(EINK_ADDR_MODE_TABLE);
+    num_modes  = min(index->num_modes, EINK_WF_INDEX_MODES);
+    
+    for ( mode = 0; mode < num_modes; mode++ )
+    {
+        addr = mode_table + (mode * EINK_WAVEFORM_PTR_SIZE);
+        
+        if ( !EINK_WAVEFORM_ADDR_OK(addr, EINK_WAVEFORM_PTR_SIZE) )
+            break;
+        
+        temp_table = eink_read_waveform_addr(addr);
+        
+        for ( temp_range = 0; temp_range < index->temps.num_temp_ranges; temp_range++ )
+        {
+            addr = temp_table + (temp_range * EINK_WAVEFORM_PTR_SIZE);
+            
+            if ( !EINK_WAVEFORM_ADDR_OK(addr, EINK_WAVEFORM_PTR_SIZE) )
+                break;
+            
+            lut_info = &index->luts[mode][temp_range];
+            lut_info->offset = eink_read_waveform_addr(addr);
+            lut_info->size = eink_decode_waveform_lut(lut_info->offset, NULL,
+                (INT_MAX & ~(EINK_WF_LUT_FRAME_SIZE - 1)), &entries);
+            lut_info->num_frames = entries / EINK_WF_LUT_FRAME_SIZE;
+        }
+    }
+}
+
+bool eink_get_waveform_lut(eink_waveform_index_t *index, eink_waveform_lut_t *lut, int mode, int temperature)
+{
+    eink_waveform_lut_info_t *lut_info;
+    int entries;
+    
+    if ( !index || !lut || !lut->frames )
+        return ( false );
+    
+    lut->num_modes       = index->num_modes;
+    lut->num_temp_ranges = index->temps.num_temp_ranges;
+    lut->num_frames      = 0;
+    
+    if ( !IN_RANGE(mode, 0, min(index->num_modes, EINK_WF_INDEX_MODES) - 1) || !lut->num_temp_ranges )
+    {
+        pr_debug("unindexed waveform LUT (mode = %d)\n", mode);
+        return ( false );
+    }
+    
+    lut->temp_range = EINK_WF_TEMP_RANGE(&index->temps, temperature);
+    lut->temp_min   = index->temp_bounds[lut->temp_range + 0];
+    lut->temp_max   = index->temp_bounds[lut->temp_range + 1];
+    lut_info        = &index->luts[mode][lut->temp_range];
+    
+    if ( lut_info->num_frames )
+    {
+        eink_decode_waveform_lut(lut_info->offset, lut->frames,
+            (lut->frames_size & ~(EINK_WF_LUT_FRAME_SIZE - 1)), &entries);
+        lut->num_frames = entries / EINK_WF_LUT_FRAME_SIZE;
+    }
+    
+    return ( 0 != lut->num_frames );
+}
+
 bool eink_waveform_valid(void)
 {
     char *waveform_version = eink_get_waveform_version_string(eink_waveform_version_string);
@@ -39,6 +39,18 @@
 
 #define EINK_ADDR_FPL_RATE              0x00017 // 1 byte  (0x50=50Hz, 0x60=60Hz, 0x85=85Hz)
 
+#define EINK_ADDR_MODE_TABLE            0x0020  // 3 bytes (little-endian, address of the mode table)
+#define EINK_ADDR_LUTS                  0x0024  // 1 byte  (0x04 in bits 2..3 -> 5-bit waveform)
+#define EINK_ADDR_MODE_COUNT            0x0025  // 1 byte  (number of modes - 1)
+#define EINK_ADDR_TEMP_RANGE_COUNT      0x0026  // 1 byte  (number of temperature ranges - 1)
+#define EINK_ADDR_TEMP_RANGE_TABLE      0x0030  // (number of temperature ranges + 1) bytes of range bounds
+
+#define EINK_WAVEFORM_PTR_SIZE          4       // 3-byte address, 1-byte checksum
+#define EINK_WAVEFORM_LUTS_5BIT(l)      (0x04 == ((l) & 0x0C))
+
+#define EINK_WAVEFORM_RLE_TOGGLE        0xFC    // Switches run-length encoding off/on.
+#define EINK_WAVEFORM_RLE_END           0xFF    // Ends run-length encoded frame data.
+
 // PVI/EIH panel values
 #define EINK_MFG_CODE_EIH_E40           0x33    // ED060SCF (V220 6” Tequila)
 #define EINK_MFG_CODE_EIH_E48           0x34    // ED060SCFH1 (V220 Tequila Hydis – Line 2)
@@ -76,6 +88,10 @@ extern bool eink_waveform_valid(void);
 extern int  eink_write_waveform_to_file(char *waveform_file_path);
 extern int  eink_read_waveform_from_file(char *waveform_file_path);
 
+extern void eink_index_waveform(eink_waveform_index_t *index);
+extern void eink_index_waveform_luts(eink_waveform_index_t *index);
+extern bool eink_get_waveform_lut(eink_waveform_index_t *index, eink_waveform_lut_t *lut, int mode, int temperature);
+
 extern unsigned long eink_get_embedded_waveform_checksum(unsigned char *buffer);
 extern unsigned long eink_get_computed_waveform_checksum(unsigned char *buffer);
 
@@ -47,6 +47,20 @@ static unsigned char  *buffer_byte  = NULL;
 static unsigned short *buffer_short = NULL;
 static unsigned long  *buffer_long  = NULL;
 
+static eink_waveform_index_t wf_index;
+static char *wf_index_buffer      = NULL;
+static int   wf_index_buffer_size = 0;
+
+#define WF_INDEX_CURRENT()  ((wf_index_buffer == wf_buffer) && (wf_index_buffer_size == wf_buffer_size))
+
+// The index is only keyed on the buffer's address and size, so whoever puts new
+// contents into a buffer that may already be indexed must clear it.
+//
+void einkwf_index_clr(void)
+{
+    wf_index_buffer = NULL;
+}
+
 // ----------------------------------------------- //
 
 // CRC-32 algorithm from:
@@ -222,39 +236,61 @@ static void einkwf_buffers_clr(void)
     buffer_long  = NULL;
 }
 
-void einkwf_get_waveform_info(eink_waveform_info_t *info)
+eink_waveform_index_t *einkwf_get_waveform_index(bool index_luts)
 {
-    einkwf_buffers_set();
+    // The header is indexed once per waveform put into the buffer, and the LUTs
+    // are only walked the first time someone asks for them.
+    //
+    if ( !WF_INDEX_CURRENT() )
+    {
+        einkwf_buffers_set();
+        eink_index_waveform(&wf_index);
+        einkwf_buffers_clr();
+        
+        wf_index_buffer      = wf_buffer;
+        wf_index_buffer_size = wf_buffer_size;
+    }
     
-    eink_get_waveform_info(info);
+    if ( index_luts && !wf_index.luts_indexed )
+    {
+        einkwf_buffers_set();
+        eink_index_waveform_luts(&wf_index);
+        einkwf_buffers_clr();
+    }
     
-    einkwf_buffers_clr();
+    return ( &wf_index );
 }
 
-char *einkwf_get_waveform_version_string(eink_waveform_version_string_t which_string)
+void einkwf_get_waveform_info(eink_waveform_info_t *info)
 {
-    char *version_string = NULL;
-
-    einkwf_buffers_set();
-
-    version_string = eink_get_waveform_version_string(which_string);
-
-    einkwf_buffers_clr();
+    if ( info )
+        *info = einkwf_get_waveform_index(false)->info;
+}
 
-    return ( version_string );
+char *einkwf_get_waveform_version_string(eink_waveform_version_string_t which_string)
+{
+    eink_waveform_index_t *index = einkwf_get_waveform_index(false);
+    
+    return ( (eink_waveform_filename == which_string) ? index->filename : index->version_string );
 }
 
 bool einkwf_waveform_valid(void)
 {
+    return ( einkwf_get_waveform_index(false)->valid );
+}
+
+bool einkwf_get_waveform_lut(eink_waveform_lut_t *lut, int mode, int temperature)
+{
+    eink_waveform_index_t *index = einkwf_get_waveform_index(true);
     bool result = false;
     
     einkwf_buffers_set();
     
-    result = eink_waveform_valid();
+    result = eink_get_waveform_lut(index, lut, mode, temperature);
     
     einkwf_buffers_clr();
     
-    return ( result );    
+    return ( result );
 }
 
 int einkwf_write_waveform_to_file(char *waveform_file_path)
@@ -264,6 +300,10 @@ int einkwf_write_waveform_to_file(char *waveform_file_path)
 
 int einkwf_read_waveform_from_file(char *waveform_file_path)
 {
+    // Whatever the buffer held before, it's about to be overwritten.
+    //
+    einkwf_index_clr();
+    
     return ( eink_read_waveform_from_file(waveform_file_path) );
 }
 
@@ -1200,6 +1240,9 @@ EXPORT_SYMBOL(einkwf_get_buffer);
 EXPORT_SYMBOL(einkwf_get_waveform_info);
 EXPORT_SYMBOL(einkwf_get_waveform_version_string);
 EXPORT_SYMBOL(einkwf_waveform_valid);
+EXPORT_SYMBOL(einkwf_get_waveform_lut);
+EXPORT_SYMBOL(einkwf_get_waveform_index);
+EXPORT_SYMBOL(einkwf_index_clr);
 EXPORT_SYMBOL(einkwf_write_waveform_to_file);
 EXPORT_SYMBOL(einkwf_read_waveform_from_file);
 EXPORT_SYMBOL(einkwf_get_wavform_proxy_from_waveform);
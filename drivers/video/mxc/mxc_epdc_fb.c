@@ -50,10 +50,21 @@
 #include <linux/regulator/driver.h>
 #include <linux/fsl_devices.h>
 #include <linux/bitops.h>
+#include <linux/math64.h>
+#include <linux/random.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/pagemap.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/sort.h>
+#include <linux/ktime.h>
+#include <linux/einkwf.h>
 
 #include <mach/boardid.h>
 
 #include "epdc_regs.h"
+#include "mxc_epdc_merge.h"
 
 #define NUM_SCREENS_MIN	2
 #define EPDC_NUM_LUTS 16
@@ -69,9 +80,89 @@
 #define POWER_STATE_OFF	0
 #define POWER_STATE_ON	1
 
-#define MERGE_OK	0
-#define MERGE_FAIL	1
-#define MERGE_BLOCK	2
+/* Adaptive power-down decision for the current idle gap */
+#define EPDC_PWR_NONE		0	/* Not predicted (learning/fixed) */
+#define EPDC_PWR_HOLD		1	/* Rails held up through the gap */
+#define EPDC_PWR_OFF		2	/* Rails down, pre-power pending */
+#define EPDC_PWR_PREPOWERED	3	/* Rails brought up ahead of update */
+
+/* Update dependency graph: panel is indexed as a GRID x GRID cell bitmap */
+#define EPDC_SCHED_GRID	8
+
+/*
+ * RGB565 updates up to this many pixels are converted to luma on the CPU
+ * while copying, so the PxP runs them as GREY input with no CSC.
+ */
+#define EPDC_CPU_CONVERT_MAX_PIXELS	(256 * 256)
+
+/*
+ * Default size limit for updates run on the CPU PxP engine (pxp_sw)
+ * rather than waking the PxP; set through mxc_epdc_pxp_sw, 0 = never.
+ */
+#define EPDC_PXP_SW_MAX_PIXELS	(64 * 64)
+
+/*
+ * Updates that may sit PxP-processed, waiting for the working buffer or
+ * a LUT, while the next update is run through the PxP.
+ */
+#define EPDC_PXP_PIPELINE_DEPTH	2
+
+/* Userspace buffers that may be pinned for alt-buffer updates at once */
+#define EPDC_MAX_USER_BUFFERS	8
+
+/*
+ * Adaptive power-down: idle gaps are learned once this many have been
+ * seen; rails are only dropped when the expected gap is this many times
+ * the measured ramp-up time; and rails are never held up speculatively
+ * for longer than the max hold.
+ */
+#define EPDC_PWR_MIN_SAMPLES	4
+#define EPDC_PWR_RAMP_RATIO	4
+#define EPDC_PWR_MAX_HOLD_MS	2000
+#define EPDC_PWR_MARGIN_MS	20
+#define EPDC_PWR_MAX_GAP_MS	120000
+
+/*
+ * Deferred-IO damage tracking: dirty pages are diffed against a shadow
+ * copy in tiles of this many pixels square.  The budget bounds the bytes
+ * compared per pass (the framebuffer is write-combined, so reading it
+ * back is slow); dirty pages past the budget are taken whole.  Above the
+ * rect limit the damage is sent as its bounding box.
+ */
+#define EPDC_DAMAGE_TILE	32
+#define EPDC_DAMAGE_BUDGET_KB	256
+#define EPDC_DAMAGE_MAX_RECTS	8
+
+/* Latency trace ring (power of 2) and waveform modes summarised */
+#define EPDC_LAT_RING_SIZE	256
+#define EPDC_LAT_MODES		16
+
+/* Update pipeline stages timestamped for latency tracing */
+enum {
+	EPDC_LAT_SEND,		/* Accepted by send_update */
+	EPDC_LAT_PXP_START,	/* Submitted to the PxP */
+	EPDC_LAT_PXP_DONE,	/* PxP processing complete */
+	EPDC_LAT_SUBMIT,	/* Handed to a LUT */
+	EPDC_LAT_DONE,		/* LUT complete */
+	EPDC_LAT_STAGES,
+};
+
+/*
+ * One record per LUT pass, exported as-is through debugfs.  An update
+ * that collides and is resubmitted produces one record per pass.
+ */
+struct epdc_lat_record {
+	u32 seq;		/* Ring sequence number, 0 if slot unused */
+	u32 update_marker;
+	u32 update_order;
+	u32 waveform_mode;	/* Resolved mode, never AUTO */
+	u32 area;		/* Panel pixels */
+	s32 lut;
+	u64 stamp_ns[EPDC_LAT_STAGES];
+};
+
+#define CREATE_TRACE_POINTS
+#include "mxc_epdc_trace.h"
 
 static unsigned long default_bpp = 16;
 static int mxc_epdc_paused = 0;
@@ -88,12 +179,42 @@ struct update_marker_data {
 	unsigned long long start_time;
 };
 
+/*
+ * Userspace buffer pinned for use as an update source.  Pages are held
+ * with get_user_pages() and mapped once with vmap() for CPU access; if
+ * they turn out to be physically contiguous the PxP reads them directly.
+ *
+ * A buffer belongs to the thread group that registered it; only that
+ * group can use or unregister it.  Once the owner exits, the buffer is
+ * orphaned and freed as soon as no queued update still reads from it.
+ */
+struct epdc_user_buf {
+	struct list_head list;
+	u32 handle;
+	unsigned long uaddr;
+	u32 size;
+	int npages;
+	struct page **pages;
+	void *vaddr;		/* Kernel mapping of uaddr */
+	dma_addr_t phys;	/* Valid if contiguous */
+	bool contiguous;
+	atomic_t users;		/* Queued updates referencing this buffer */
+	struct pid *owner;	/* Registering thread group */
+	bool orphaned;		/* Owner gone, free once users reaches 0 */
+};
+
 struct update_desc_list {
 	struct list_head list;
 	struct mxcfb_update_data upd_data;/* Update parameters */
 	u32 epdc_offs;		/* Added to buffer ptr to resolve alignment */
 	struct list_head upd_marker_list; /* List of markers for this update */
 	u32 update_order;	/* Numeric ordering value for update */
+	struct mxcfb_rect panel_region;	/* Update region in panel coordinates */
+	u64 cells;		/* Dependency graph cells covered by update */
+	u32 blocking_luts;	/* In-flight LUTs this update must wait on */
+	unsigned long queue_time;	/* jiffies when update was queued */
+	struct epdc_user_buf *user_buf;	/* Source buffer, if user buffer */
+	u64 lat_ns[EPDC_LAT_STAGES];	/* Pipeline stage timestamps */
 };
 
 /* This structure represents a list node containing both
@@ -112,6 +233,79 @@ struct update_data_list {
 						/* Represents other LUTs that we collide with */
 };
 
+/* Software shadow of the region owned by an in-flight LUT */
+struct epdc_lut_shadow {
+	struct mxcfb_rect region;	/* Panel coordinates */
+	u64 cells;			/* Dependency graph cells covered */
+	bool busy;
+	bool traced;			/* lat holds this LUT's update */
+	struct epdc_lat_record lat;
+};
+
+/* Idle-gap predictor state and counters, exported through sysfs */
+struct epdc_pwr_pred {
+	bool idle;		/* No update since the last idle point */
+	unsigned long idle_start;	/* jiffies at the last idle point */
+	int state;		/* EPDC_PWR_* decision for this gap */
+	u32 samples;
+	s32 gap_avg_ms;		/* Smoothed idle gap */
+	s32 gap_dev_ms;		/* Smoothed mean deviation of the gap */
+	u32 ramp_us;		/* Smoothed rail power-up time */
+	u32 predictions;	/* Idle points decided by the predictor */
+	u32 holds;		/* ...that kept the rails up */
+	u32 prepowers;		/* ...that powered down and pre-powered */
+	u32 hits;		/* Update arrived with rails already up */
+	u32 misses_cold;	/* Update arrived with rails down */
+	u32 misses_wasted;	/* Rails held/pre-powered, no update came */
+};
+
+/* Deferred-IO damage tracker state and counters */
+struct epdc_damage {
+	struct mutex lock;	/* Serializes defio against sysfs/updates */
+	u8 *shadow;		/* Visible screen as last seen by defio */
+	u32 shadow_size;
+	u32 shadow_offs;	/* fb_offset the shadow was taken at */
+	bool valid;
+	u32 budget_kb;		/* Bytes compared per pass, 0 = page bands */
+	int tiles_x;
+	int tiles_y;
+	unsigned long *tiles;	/* Dirty tile bitmap for the current pass */
+	u32 passes;
+	u64 bytes_diffed;
+	u32 pages_whole;	/* Dirty pages taken whole, over budget */
+	u32 pages_clean;	/* Dirty pages with no actual change */
+	u32 rects;
+	u64 pixels_band;	/* Pixels full-width page bands would send */
+	u64 pixels_sent;
+};
+
+/* Update scheduler counters, exported through sysfs */
+struct epdc_sched_stats {
+	u32 queue_depth;	/* Updates currently in the pending list */
+	u32 queue_depth_max;
+	u32 queued;		/* Updates accepted into the pending list */
+	u32 dispatched;		/* Updates handed to a LUT */
+	u32 dispatched_ready;	/* ...that had no in-flight blockers */
+	u32 released;		/* Updates unblocked by a retiring LUT */
+	u32 wait_ms_max;	/* Longest queue->LUT wait */
+	u64 wait_ms_total;
+	u32 merges;		/* Updates folded into another update */
+	u32 merges_declined;	/* Disjoint merges rejected by cost model */
+	u32 superseded;		/* Pending updates covered by a newer one */
+	u64 pixels_requested;	/* Sum of update areas as queued */
+	u64 pixels_processed;	/* Sum of update areas sent to PxP */
+	u32 pxp_passes;		/* PxP passes run from the submit work */
+	u32 pxp_overlapped;	/* ...while an earlier update was on the panel */
+	u64 pxp_us_total;
+	u64 pxp_overlap_us_total;
+	u32 parked;		/* Processed updates parked for the EPDC */
+	u32 parked_max;
+	u32 held;		/* ...held back for a predicted collision */
+	u32 reordered;		/* Submitted ahead of an older held update */
+	u32 collisions;		/* Collisions reported by the EPDC */
+	u32 resubmits;		/* ...that sent the update round again */
+};
+
 struct mxc_epdc_fb_data {
 	struct fb_info info;
 	struct fb_var_screeninfo epdc_fb_var;
@@ -156,6 +350,7 @@ struct mxc_epdc_fb_data {
 	int trt_entries;
 	int temp_index;
 	u8 *temp_range_bounds;
+	eink_waveform_temps_t temps;	/* temperature -> TRT index */
 	struct mxcfb_waveform_modes wv_modes;
 	u32 *waveform_buffer_virt;
 	u32 waveform_buffer_phys;
@@ -166,9 +361,20 @@ struct mxc_epdc_fb_data {
 	u32 order_cnt;
 	struct list_head full_marker_list;
 	u32 lut_update_order[EPDC_NUM_LUTS];
+	struct epdc_lut_shadow lut_shadow[EPDC_NUM_LUTS];
+	struct epdc_sched_stats sched_stats;
+	struct epdc_lat_record *lat_ring;
+	atomic_t lat_head;
+	struct dentry *lat_dir;
+	struct list_head user_buf_list;
+	struct mutex user_buf_mutex;	/* protects user_buf_list */
+	u32 user_buf_handle;
 	u32 luts_complete_wb;
 	struct completion updates_done;
 	struct delayed_work epdc_done_work;
+	struct delayed_work epdc_prepower_work;
+	struct epdc_pwr_pred pwr_pred;
+	struct epdc_damage damage;
 	struct workqueue_struct *epdc_submit_workqueue;
 	struct work_struct epdc_submit_work;
 	bool waiting_for_wb;
@@ -186,10 +392,14 @@ struct mxc_epdc_fb_data {
 	/* FB elements related to PxP DMA */
 	struct completion pxp_tx_cmpl;
 	struct pxp_channel *pxp_chan;
+	struct pxp_channel *pxp_sw_chan;	/* held alongside pxp_chan */
 	struct pxp_config_data pxp_conf;
 	struct dma_async_tx_descriptor *txd;
 	dma_cookie_t cookie;
 	struct scatterlist sg[2];
+	void *pxp_vaddr[2];	/* CPU view of sg[0]/sg[1], NULL if none */
+	u32 pxp_sw_max_pixels;	/* largest update sent to pxp_sw */
+	u32 pxp_sw_jobs;
 	struct mutex pxp_mutex; /* protects access to PxP */
 
 	/* Lab126 */
@@ -489,6 +699,7 @@ static inline void dump_all_updates(struct mxc_epdc_fb_data *fb_data) {}
 
 #endif
 
+#include "mxc_epdc_fb_pixel.c"
 
 /********************************************************
  * Start Low-Level EPDC Functions
@@ -903,6 +1114,8 @@ static void epdc_powerup(struct mxc_epdc_fb_data *fb_data)
 {
 	int ret = 0;
 	u32 reg_val; /* Lab126 */
+	ktime_t ramp_start;
+	s32 ramp_us;
 	mutex_lock(&fb_data->power_mutex);
 
 	/*
@@ -929,6 +1142,7 @@ static void epdc_powerup(struct mxc_epdc_fb_data *fb_data)
 	__raw_writel(EPDC_CTRL_CLKGATE, EPDC_CTRL_CLEAR);
 
 	/* Enable power to the EPD panel */
+	ramp_start = ktime_get();
 	ret = regulator_enable(fb_data->display_regulator);
 	if (IS_ERR((void *)ret)) {
 		dev_err(fb_data->dev, "Unable to enable DISPLAY regulator."
@@ -945,6 +1159,14 @@ static void epdc_powerup(struct mxc_epdc_fb_data *fb_data)
 		return;
 	}
 
+	/* Rail ramp cost feeds the adaptive power-down decision */
+	ramp_us = ktime_us_delta(ktime_get(), ramp_start);
+	if (fb_data->pwr_pred.ramp_us)
+		fb_data->pwr_pred.ramp_us = fb_data->pwr_pred.ramp_us +
+			(ramp_us - (s32)fb_data->pwr_pred.ramp_us) / 4;
+	else
+		fb_data->pwr_pred.ramp_us = ramp_us;
+
 	/* Lab126: Enable PWRCOM */
 	reg_val = __raw_readl(EPDC_GPIO) | EPDC_GPIO_PWRCOM;
 	__raw_writel(reg_val, EPDC_GPIO);
@@ -999,6 +1221,137 @@ static void epdc_powerdown(struct mxc_epdc_fb_data *fb_data)
 	mutex_unlock(&fb_data->power_mutex);
 }
 
+/********************************************************
+ * Start Power Prediction Functions
+ ********************************************************/
+
+/*
+ * With pwrdown_delay set to FB_POWERDOWN_ADAPTIVE, the fixed power-down
+ * timer is replaced by a prediction of the idle gap before the next
+ * burst of updates (e.g. the next page turn).  At each idle point we
+ * either hold the rails up through the expected gap, or, when the gap is
+ * long compared with the measured rail ramp-up time, power down at once
+ * and schedule a pre-power-up just ahead of the expected update.  Rails
+ * brought up speculatively are dropped again if nothing arrives.
+ *
+ * The gap is smoothed like a TCP RTT estimate: a 1/8 running average and
+ * a 1/4 running mean deviation.
+ */
+
+/* First update after an idle point.  Called with queue_lock held. */
+static void epdc_pwr_note_arrival(struct mxc_epdc_fb_data *fb_data)
+{
+	struct epdc_pwr_pred *pred = &fb_data->pwr_pred;
+	s32 gap, err;
+
+	if (!pred->idle)
+		return;
+	pred->idle = false;
+
+	cancel_delayed_work(&fb_data->epdc_prepower_work);
+
+	gap = min_t(u32, jiffies_to_msecs(jiffies - pred->idle_start),
+		EPDC_PWR_MAX_GAP_MS);
+	if (pred->samples++ == 0) {
+		pred->gap_avg_ms = gap;
+		pred->gap_dev_ms = gap / 2;
+	} else {
+		err = gap - pred->gap_avg_ms;
+		pred->gap_avg_ms += err / 8;
+		pred->gap_dev_ms += (abs(err) - pred->gap_dev_ms) / 4;
+	}
+
+	if (pred->state == EPDC_PWR_NONE)
+		return;
+
+	if (fb_data->power_state == POWER_STATE_ON)
+		pred->hits++;
+	else
+		pred->misses_cold++;
+	pred->state = EPDC_PWR_NONE;
+}
+
+/* Expected arrival window for the next update, in ms after idle */
+static inline s32 epdc_pwr_early(struct epdc_pwr_pred *pred)
+{
+	return max(pred->gap_avg_ms - 2 * pred->gap_dev_ms, 0);
+}
+
+static inline s32 epdc_pwr_late(struct epdc_pwr_pred *pred)
+{
+	return pred->gap_avg_ms + 2 * pred->gap_dev_ms;
+}
+
+/*
+ * All updates are done.  Called with queue_lock held; returns how long
+ * to wait before powering down, in ms.
+ */
+static int epdc_pwr_predict_idle(struct mxc_epdc_fb_data *fb_data)
+{
+	struct epdc_pwr_pred *pred = &fb_data->pwr_pred;
+	s32 early, ramp_ms;
+
+	pred->idle = true;
+	pred->idle_start = jiffies;
+	pred->state = EPDC_PWR_NONE;
+
+	/* Until the cadence is known, power down right away */
+	if (pred->samples < EPDC_PWR_MIN_SAMPLES)
+		return 0;
+
+	pred->predictions++;
+	early = epdc_pwr_early(pred);
+	ramp_ms = DIV_ROUND_UP(pred->ramp_us, 1000);
+
+	if (early < ramp_ms * EPDC_PWR_RAMP_RATIO) {
+		/* Gap too short to be worth a power cycle */
+		pred->holds++;
+		pred->state = EPDC_PWR_HOLD;
+		return min(epdc_pwr_late(pred), EPDC_PWR_MAX_HOLD_MS);
+	}
+
+	pred->prepowers++;
+	pred->state = EPDC_PWR_OFF;
+	cancel_delayed_work(&fb_data->epdc_prepower_work);
+	schedule_delayed_work(&fb_data->epdc_prepower_work,
+		msecs_to_jiffies(max(early - ramp_ms - EPDC_PWR_MARGIN_MS, 0)));
+
+	return 0;
+}
+
+static void epdc_prepower_work_func(struct work_struct *work)
+{
+	struct mxc_epdc_fb_data *fb_data =
+		container_of(work, struct mxc_epdc_fb_data,
+			epdc_prepower_work.work);
+	struct epdc_pwr_pred *pred = &fb_data->pwr_pred;
+	unsigned long flags;
+	s32 hold;
+
+	if (!pred->idle || (pred->state != EPDC_PWR_OFF) ||
+		fb_data->waiting_for_idle ||
+		(fb_data->blank != FB_BLANK_UNBLANK))
+		return;
+
+	epdc_powerup(fb_data);
+
+	/* Drop the rails again at the end of the window if nothing came */
+	mutex_lock(&fb_data->power_mutex);
+	spin_lock_irqsave(&fb_data->queue_lock, flags);
+	if (pred->idle && (pred->state == EPDC_PWR_OFF)) {
+		pred->state = EPDC_PWR_PREPOWERED;
+		hold = epdc_pwr_late(pred) -
+			jiffies_to_msecs(jiffies - pred->idle_start);
+		hold = clamp_t(s32, hold, EPDC_PWR_MARGIN_MS,
+			EPDC_PWR_MAX_HOLD_MS);
+		fb_data->powering_down = true;
+		schedule_delayed_work(&fb_data->epdc_done_work,
+			msecs_to_jiffies(hold));
+	}
+	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+	mutex_unlock(&fb_data->power_mutex);
+}
+
 static void epdc_init_sequence(struct mxc_epdc_fb_data *fb_data)
 {
 	/* Initialize EPDC, passing pointer to EPDC registers */
@@ -1040,6 +1393,27 @@ static int mxc_epdc_fb_mmap(struct fb_info *info, struct vm_area_struct *vma)
 	return 0;
 }
 
+#ifdef CONFIG_FB_MXC_EINK_AUTO_UPDATE_MODE
+static int (*mxc_epdc_defio_mmap)(struct fb_info *info,
+				  struct vm_area_struct *vma);
+
+/*
+ * Deferred-IO mapping, kept write-combined like the plain one so that
+ * user writes are visible through the kernel's uncached alias, which is
+ * what the PxP and the damage tracker read.
+ */
+static int mxc_epdc_fb_defio_mmap(struct fb_info *info,
+				  struct vm_area_struct *vma)
+{
+	int ret = mxc_epdc_defio_mmap(info, vma);
+
+	if (!ret)
+		vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
+
+	return ret;
+}
+#endif
+
 static int mxc_epdc_fb_setcolreg(u_int regno, u_int red, u_int green,
 				 u_int blue, u_int transp, struct fb_info *info)
 {
@@ -1160,6 +1534,473 @@ static void adjust_coordinates(struct mxc_epdc_fb_data *fb_data,
 		}
 }
 
+/********************************************************
+ * Start Latency Trace Functions
+ ********************************************************/
+
+/*
+ * Each update carries a timestamp per pipeline stage.  When its LUT
+ * completes the timestamps are committed as one record into a ring,
+ * which debugfs exports both raw (mxc_epdc/latency) and summarised
+ * per waveform mode (mxc_epdc/latency_summary).  Writers only claim a
+ * slot with an atomic increment, so recording is safe from the IRQ
+ * handler; readers skip slots that change under them.
+ */
+static inline void epdc_lat_stamp(struct update_desc_list *upd_desc,
+				  int stage, int lut)
+{
+	upd_desc->lat_ns[stage] = ktime_to_ns(ktime_get());
+	trace_mxc_epdc_update_stage(upd_desc->update_order,
+		upd_desc->upd_data.update_marker, stage, lut);
+}
+
+/* Update handed to a LUT: park its timestamps with the LUT */
+static void epdc_lat_lut_start(struct mxc_epdc_fb_data *fb_data,
+			       struct update_desc_list *upd_desc,
+			       int lut, struct mxcfb_rect *region)
+{
+	struct epdc_lat_record *rec = &fb_data->lut_shadow[lut].lat;
+
+	epdc_lat_stamp(upd_desc, EPDC_LAT_SUBMIT, lut);
+
+	rec->update_marker = upd_desc->upd_data.update_marker;
+	rec->update_order = upd_desc->update_order;
+	rec->waveform_mode = upd_desc->upd_data.waveform_mode;
+	rec->area = region->width * region->height;
+	rec->lut = lut;
+	memcpy(rec->stamp_ns, upd_desc->lat_ns, sizeof(rec->stamp_ns));
+	fb_data->lut_shadow[lut].traced = true;
+}
+
+/* LUT complete: commit its record to the ring */
+static void epdc_lat_lut_done(struct mxc_epdc_fb_data *fb_data, int lut)
+{
+	struct epdc_lut_shadow *shadow = &fb_data->lut_shadow[lut];
+	struct epdc_lat_record *slot;
+	u32 seq;
+
+	if (!shadow->traced || !fb_data->lat_ring)
+		return;
+	shadow->traced = false;
+
+	shadow->lat.stamp_ns[EPDC_LAT_DONE] = ktime_to_ns(ktime_get());
+	trace_mxc_epdc_update_stage(shadow->lat.update_order,
+		shadow->lat.update_marker, EPDC_LAT_DONE, lut);
+
+	seq = atomic_inc_return(&fb_data->lat_head);
+	if (seq == 0)
+		seq = atomic_inc_return(&fb_data->lat_head);
+	slot = &fb_data->lat_ring[seq & (EPDC_LAT_RING_SIZE - 1)];
+
+	/* shadow->lat.seq is always 0, so the slot reads as unused */
+	slot->seq = 0;
+	smp_wmb();
+	*slot = shadow->lat;
+	smp_wmb();
+	slot->seq = seq;
+}
+
+/*
+ * Copy out every complete record, oldest first.  Returns the number of
+ * records copied into out, which must hold EPDC_LAT_RING_SIZE entries.
+ */
+static int epdc_lat_snapshot(struct mxc_epdc_fb_data *fb_data,
+			     struct epdc_lat_record *out)
+{
+	struct epdc_lat_record *slot;
+	u32 head = atomic_read(&fb_data->lat_head);
+	u32 seq;
+	int i, n = 0;
+
+	for (i = EPDC_LAT_RING_SIZE - 1; i >= 0; i--) {
+		seq = head - i;
+		slot = &fb_data->lat_ring[seq & (EPDC_LAT_RING_SIZE - 1)];
+		if (!seq || (slot->seq != seq))
+			continue;
+		smp_rmb();
+		out[n] = *slot;
+		smp_rmb();
+		if (slot->seq != seq)
+			continue;
+		n++;
+	}
+
+	return n;
+}
+
+struct epdc_lat_snap {
+	int count;
+	struct epdc_lat_record rec[EPDC_LAT_RING_SIZE];
+};
+
+static int mxc_epdc_lat_open(struct inode *inode, struct file *file)
+{
+	struct mxc_epdc_fb_data *fb_data = inode->i_private;
+	struct epdc_lat_snap *snap;
+
+	snap = vmalloc(sizeof(struct epdc_lat_snap));
+	if (!snap)
+		return -ENOMEM;
+
+	snap->count = epdc_lat_snapshot(fb_data, snap->rec);
+	file->private_data = snap;
+
+	return 0;
+}
+
+static ssize_t mxc_epdc_lat_read(struct file *file, char __user *buf,
+				 size_t count, loff_t *ppos)
+{
+	struct epdc_lat_snap *snap = file->private_data;
+
+	return simple_read_from_buffer(buf, count, ppos, snap->rec,
+		snap->count * sizeof(struct epdc_lat_record));
+}
+
+static int mxc_epdc_lat_release(struct inode *inode, struct file *file)
+{
+	vfree(file->private_data);
+	return 0;
+}
+
+static const struct file_operations mxc_epdc_lat_fops = {
+	.owner		= THIS_MODULE,
+	.open		= mxc_epdc_lat_open,
+	.read		= mxc_epdc_lat_read,
+	.release	= mxc_epdc_lat_release,
+};
+
+static int epdc_lat_cmp(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* Sort v[0..n) in place and return its p-th percentile */
+static u32 epdc_lat_pct(u32 *v, int n, int p)
+{
+	sort(v, n, sizeof(u32), epdc_lat_cmp, NULL);
+	return v[(n - 1) * p / 100];
+}
+
+static const char *epdc_lat_span_names[] = {
+	"total", "queue", "pxp", "lut_wait", "display",
+};
+
+static int mxc_epdc_lat_summary_show(struct seq_file *m, void *unused)
+{
+	struct epdc_lat_snap *snap = m->private;
+	struct epdc_lat_record *rec;
+	u32 *v, p50, p99;
+	int mode, span, i, n;
+	u64 from, to;
+
+	v = kmalloc(EPDC_LAT_RING_SIZE * sizeof(u32), GFP_KERNEL);
+	if (!v)
+		return -ENOMEM;
+
+	seq_printf(m, "%-4s %-8s %5s %8s %8s %8s  (usec)\n",
+		"mode", "span", "n", "p50", "p99", "max");
+
+	for (mode = 0; mode < EPDC_LAT_MODES; mode++) {
+		for (span = 0; span < ARRAY_SIZE(epdc_lat_span_names);
+			span++) {
+			n = 0;
+			for (i = 0; i < snap->count; i++) {
+				rec = &snap->rec[i];
+				if (min_t(u32, rec->waveform_mode,
+					EPDC_LAT_MODES - 1) != mode)
+					continue;
+				/* total spans SEND..DONE, others one stage */
+				from = rec->stamp_ns[span ? span - 1 :
+					EPDC_LAT_SEND];
+				to = rec->stamp_ns[span ? span :
+					EPDC_LAT_DONE];
+				v[n++] = (to > from) ?
+					div_u64(to - from, NSEC_PER_USEC) : 0;
+			}
+			if (!n)
+				break;
+
+			/* Sort before reading max; argument order is unspecified */
+			p50 = epdc_lat_pct(v, n, 50);
+			p99 = epdc_lat_pct(v, n, 99);
+
+			seq_printf(m, "%-4d %-8s %5d %8u %8u %8u\n", mode,
+				epdc_lat_span_names[span], n, p50, p99,
+				v[n - 1]);
+		}
+	}
+
+	kfree(v);
+	return 0;
+}
+
+static int mxc_epdc_lat_summary_open(struct inode *inode, struct file *file)
+{
+	struct epdc_lat_snap *snap;
+	int ret;
+
+	ret = mxc_epdc_lat_open(inode, file);
+	if (ret)
+		return ret;
+
+	snap = file->private_data;
+	ret = single_open(file, mxc_epdc_lat_summary_show, snap);
+	if (ret)
+		vfree(snap);
+
+	return ret;
+}
+
+static int mxc_epdc_lat_summary_release(struct inode *inode,
+					struct file *file)
+{
+	struct seq_file *m = file->private_data;
+
+	vfree(m->private);
+	return single_release(inode, file);
+}
+
+static const struct file_operations mxc_epdc_lat_summary_fops = {
+	.owner		= THIS_MODULE,
+	.open		= mxc_epdc_lat_summary_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= mxc_epdc_lat_summary_release,
+};
+
+static void mxc_epdc_lat_init(struct mxc_epdc_fb_data *fb_data)
+{
+	atomic_set(&fb_data->lat_head, 0);
+	fb_data->lat_ring = kzalloc(EPDC_LAT_RING_SIZE *
+		sizeof(struct epdc_lat_record), GFP_KERNEL);
+	if (!fb_data->lat_ring)
+		return;
+
+	fb_data->lat_dir = debugfs_create_dir("mxc_epdc", NULL);
+	if (IS_ERR(fb_data->lat_dir) || !fb_data->lat_dir) {
+		fb_data->lat_dir = NULL;
+		return;
+	}
+	debugfs_create_file("latency", 0444, fb_data->lat_dir, fb_data,
+		&mxc_epdc_lat_fops);
+	debugfs_create_file("latency_summary", 0444, fb_data->lat_dir,
+		fb_data, &mxc_epdc_lat_summary_fops);
+}
+
+static void mxc_epdc_lat_exit(struct mxc_epdc_fb_data *fb_data)
+{
+	if (fb_data->lat_dir)
+		debugfs_remove_recursive(fb_data->lat_dir);
+	kfree(fb_data->lat_ring);
+	fb_data->lat_ring = NULL;
+}
+
+/********************************************************
+ * Start Update Scheduler Functions
+ ********************************************************/
+
+/*
+ * Pending updates and in-flight LUTs form a dependency graph: a pending
+ * update depends on every in-flight LUT whose region it overlaps, since
+ * submitting it before that LUT retires would only produce a collision
+ * and a resubmit.  Regions are indexed by a coarse EPDC_SCHED_GRID^2 cell
+ * bitmap so that most non-overlapping pairs are rejected with one AND.
+ *
+ * All functions below must be called with queue_lock held.
+ */
+static u64 epdc_sched_cells(struct mxc_epdc_fb_data *fb_data,
+			    struct mxcfb_rect *region)
+{
+	u32 cell_w = DIV_ROUND_UP(fb_data->native_width, EPDC_SCHED_GRID);
+	u32 cell_h = DIV_ROUND_UP(fb_data->native_height, EPDC_SCHED_GRID);
+	u32 x0, x1, y0, y1, y;
+	u64 row, cells = 0;
+
+	if (!region->width || !region->height || !cell_w || !cell_h)
+		return 0;
+
+	x0 = min_t(u32, region->left / cell_w, EPDC_SCHED_GRID - 1);
+	x1 = min_t(u32, (region->left + region->width - 1) / cell_w,
+		EPDC_SCHED_GRID - 1);
+	y0 = min_t(u32, region->top / cell_h, EPDC_SCHED_GRID - 1);
+	y1 = min_t(u32, (region->top + region->height - 1) / cell_h,
+		EPDC_SCHED_GRID - 1);
+
+	row = ((1ULL << (x1 - x0 + 1)) - 1) << x0;
+	for (y = y0; y <= y1; y++)
+		cells |= row << (y * EPDC_SCHED_GRID);
+
+	return cells;
+}
+
+/* Return mask of in-flight LUTs overlapping a panel region */
+static u32 epdc_sched_blockers(struct mxc_epdc_fb_data *fb_data,
+			       struct mxcfb_rect *region, u64 cells)
+{
+	struct epdc_lut_shadow *shadow;
+	u32 mask = 0;
+	int i;
+
+	for (i = 0; i < EPDC_NUM_LUTS; i++) {
+		shadow = &fb_data->lut_shadow[i];
+		if (!shadow->busy || !(shadow->cells & cells))
+			continue;
+		if (epdc_rects_overlap(&shadow->region, region))
+			mask |= 1 << i;
+	}
+
+	return mask;
+}
+
+/* (Re)compute the graph node for a pending update descriptor */
+static void epdc_sched_refresh(struct mxc_epdc_fb_data *fb_data,
+			       struct update_desc_list *upd_desc)
+{
+	adjust_coordinates(fb_data, &upd_desc->upd_data.update_region,
+		&upd_desc->panel_region);
+	upd_desc->cells = epdc_sched_cells(fb_data, &upd_desc->panel_region);
+	upd_desc->blocking_luts = epdc_sched_blockers(fb_data,
+		&upd_desc->panel_region, upd_desc->cells);
+}
+
+/* New update added to the pending list */
+static void epdc_sched_enqueue(struct mxc_epdc_fb_data *fb_data,
+			       struct update_desc_list *upd_desc)
+{
+	struct epdc_sched_stats *stats = &fb_data->sched_stats;
+
+	epdc_sched_refresh(fb_data, upd_desc);
+	upd_desc->queue_time = jiffies;
+
+	stats->queued++;
+	stats->pixels_requested += upd_desc->panel_region.width *
+		upd_desc->panel_region.height;
+	stats->queue_depth++;
+	if (stats->queue_depth > stats->queue_depth_max)
+		stats->queue_depth_max = stats->queue_depth;
+}
+
+/* Update removed from the pending list (selected or merged away) */
+static void epdc_sched_dequeue(struct mxc_epdc_fb_data *fb_data,
+			       struct update_desc_list *upd_desc)
+{
+	if (fb_data->sched_stats.queue_depth)
+		fb_data->sched_stats.queue_depth--;
+}
+
+/* Update handed to a LUT; region is in panel coordinates */
+static void epdc_sched_lut_start(struct mxc_epdc_fb_data *fb_data,
+				 struct update_desc_list *upd_desc,
+				 int lut, struct mxcfb_rect *region)
+{
+	struct epdc_sched_stats *stats = &fb_data->sched_stats;
+	struct epdc_lut_shadow *shadow = &fb_data->lut_shadow[lut];
+	struct update_desc_list *next_desc;
+	u32 wait_ms;
+
+	shadow->region = *region;
+	shadow->cells = epdc_sched_cells(fb_data, region);
+	shadow->busy = true;
+	epdc_lat_lut_start(fb_data, upd_desc, lut, region);
+
+	/* Anything still pending on top of this region now waits for it */
+	list_for_each_entry(next_desc, &fb_data->upd_pending_list, list) {
+		if (!(next_desc->cells & shadow->cells))
+			continue;
+		if (epdc_rects_overlap(&next_desc->panel_region, region))
+			next_desc->blocking_luts |= 1 << lut;
+	}
+
+	stats->dispatched++;
+	stats->pixels_processed += region->width * region->height;
+	if (!upd_desc->blocking_luts)
+		stats->dispatched_ready++;
+
+	wait_ms = jiffies_to_msecs(jiffies - upd_desc->queue_time);
+	stats->wait_ms_total += wait_ms;
+	if (wait_ms > stats->wait_ms_max)
+		stats->wait_ms_max = wait_ms;
+}
+
+/*
+ * LUT retired: drop the edges to it.  Returns true if at least one pending
+ * update became ready, in which case the caller should kick the submit work.
+ */
+static bool epdc_sched_lut_retire(struct mxc_epdc_fb_data *fb_data, int lut)
+{
+	struct update_desc_list *next_desc;
+	bool released = false;
+
+	fb_data->lut_shadow[lut].busy = false;
+	epdc_lat_lut_done(fb_data, lut);
+
+	list_for_each_entry(next_desc, &fb_data->upd_pending_list, list) {
+		if (!(next_desc->blocking_luts & (1 << lut)))
+			continue;
+		next_desc->blocking_luts &= ~(1 << lut);
+		if (!next_desc->blocking_luts) {
+			fb_data->sched_stats.released++;
+			released = true;
+		}
+	}
+
+	return released;
+}
+
+/*
+ * Pick the oldest pending update that is ready to go.  An update is ready
+ * when it has no in-flight blockers and does not share a cell with an
+ * older pending update that is held back (which could reorder the two on
+ * the panel).  Returns NULL if every pending update is blocked.
+ */
+static struct update_desc_list *epdc_sched_next_ready(
+	struct mxc_epdc_fb_data *fb_data)
+{
+	struct update_desc_list *next_desc;
+	u64 held_cells = 0;
+
+	list_for_each_entry(next_desc, &fb_data->upd_pending_list, list) {
+		if (!next_desc->blocking_luts &&
+			!(next_desc->cells & held_cells))
+			return next_desc;
+		held_cells |= next_desc->cells;
+	}
+
+	return NULL;
+}
+
+/*
+ * Pick the oldest parked (PxP-processed) update that can go to the EPDC
+ * without colliding.  Blockers are recomputed against the LUT shadow, and
+ * an update may only overtake older held ones it does not overlap.
+ * Returns NULL if every parked update would collide.
+ */
+static struct update_data_list *epdc_sched_next_parked(
+	struct mxc_epdc_fb_data *fb_data)
+{
+	struct update_data_list *plist;
+	struct update_desc_list *upd_desc;
+	u64 held_cells = 0;
+
+	list_for_each_entry(plist, &fb_data->upd_buf_queue, list) {
+		upd_desc = plist->update_desc;
+		upd_desc->blocking_luts = epdc_sched_blockers(fb_data,
+			&upd_desc->panel_region, upd_desc->cells);
+		if (!upd_desc->blocking_luts &&
+			!(upd_desc->cells & held_cells)) {
+			if (held_cells)
+				fb_data->sched_stats.reordered++;
+			return plist;
+		}
+		held_cells |= upd_desc->cells;
+	}
+
+	return NULL;
+}
+
 /*
  * Set fixed framebuffer parameters based on variable settings.
  *
@@ -1497,8 +2338,7 @@ EXPORT_SYMBOL(mxc_epdc_fb_set_waveform_modes);
 
 static int mxc_epdc_fb_get_temp_index(struct mxc_epdc_fb_data *fb_data, int temp)
 {
-	int i;
-	int index = -1;
+	int index;
 
 	if (fb_data->trt_entries == 0) {
 		dev_err(fb_data->dev,
@@ -1506,21 +2346,11 @@ static int mxc_epdc_fb_get_temp_index(struct mxc_epdc_fb_data *fb_data, int temp
 		return DEFAULT_TEMP_INDEX;
 	}
 
-	/* Search temperature ranges for a match */
-	for (i = 0; i < fb_data->trt_entries - 1; i++) {
-		if ((temp >= fb_data->temp_range_bounds[i])) {
-			index = i;
-			if ((temp < fb_data->temp_range_bounds[i+1])) {
-				break;
-      }
-		}
-	}
-
-	if (index < 0) {
-		dev_dbg(fb_data->dev,
-			"No TRT index match...using default temp index\n");
-		return DEFAULT_TEMP_INDEX;
-	}
+	/*
+	 * The TRT was indexed when the waveform was loaded; temperatures
+	 * below every range map to DEFAULT_TEMP_INDEX (the first range).
+	 */
+	index = EINK_WF_TEMP_RANGE(&fb_data->temps, temp);
 
 	dev_dbg(fb_data->dev, "Using temperature index %d\n", index);
 
@@ -1555,61 +2385,281 @@ int mxc_epdc_fb_set_auto_update(u32 auto_mode, struct fb_info *info)
 	case AUTO_UPDATE_MODE_AUTOMATIC_MODE_FULL:
 	case AUTO_UPDATE_MODE_AUTOMATIC_MODE_PART:
 		fb_data->auto_mode = auto_mode;
+		/* Screen may have changed without defio seeing it */
+		mutex_lock(&fb_data->damage.lock);
+		fb_data->damage.valid = false;
+		mutex_unlock(&fb_data->damage.lock);
+		break;
+		
+	default:
+		dev_err(fb_data->dev, "Invalid auto update mode parameter.\n");
+		return -EINVAL;
+	}
+
+	return 0;
+}
+EXPORT_SYMBOL(mxc_epdc_fb_set_auto_update);
+
+int mxc_epdc_fb_set_upd_scheme(u32 upd_scheme, struct fb_info *info)
+{
+	struct mxc_epdc_fb_data *fb_data = info ?
+		(struct mxc_epdc_fb_data *)info:g_fb_data;
+
+	dev_dbg(fb_data->dev, "Setting optimization level to %d\n", upd_scheme);
+
+	/*
+	 * Can't change the scheme while until current updates have completed.
+	 * This function returns when all active updates are done.
+	 */
+	mxc_epdc_fb_flush_updates(fb_data);
+
+	if ((upd_scheme == UPDATE_SCHEME_SNAPSHOT)
+		|| (upd_scheme == UPDATE_SCHEME_QUEUE)
+		|| (upd_scheme == UPDATE_SCHEME_QUEUE_AND_MERGE))
+		fb_data->upd_scheme = upd_scheme;
+	else {
+		dev_err(fb_data->dev, "Invalid update scheme specified.\n");
+		return -EINVAL;
+	}
+
+	return 0;
+}
+EXPORT_SYMBOL(mxc_epdc_fb_set_upd_scheme);
+
+/********************************************************
+ * Start User Buffer Functions
+ ********************************************************/
+
+static void epdc_user_buf_free(struct epdc_user_buf *buf)
+{
+	int i;
+
+	if (buf->vaddr)
+		vunmap((void *)((unsigned long)buf->vaddr & PAGE_MASK));
+	for (i = 0; i < buf->npages; i++)
+		page_cache_release(buf->pages[i]);
+	put_pid(buf->owner);
+	kfree(buf->pages);
+	kfree(buf);
+}
+
+static inline bool epdc_user_buf_owned(struct epdc_user_buf *buf)
+{
+	return !buf->orphaned && (buf->owner == task_tgid(current));
+}
+
+/*
+ * Orphan the buffers of owners that are exiting or already gone, then
+ * free every orphan that no queued update still references.  Called
+ * with user_buf_mutex held.
+ */
+static void epdc_user_buf_reap(struct mxc_epdc_fb_data *fb_data)
+{
+	struct epdc_user_buf *buf, *next;
+
+	list_for_each_entry_safe(buf, next, &fb_data->user_buf_list, list) {
+		if (!buf->orphaned) {
+			rcu_read_lock();
+			if (!pid_task(buf->owner, PIDTYPE_PID) ||
+				((buf->owner == task_tgid(current)) &&
+				(current->flags & PF_EXITING)))
+				buf->orphaned = true;
+			rcu_read_unlock();
+		}
+
+		if (buf->orphaned && !atomic_read(&buf->users)) {
+			dev_dbg(fb_data->dev, "releasing user buffer %d\n",
+				buf->handle);
+			list_del(&buf->list);
+			epdc_user_buf_free(buf);
+		}
+	}
+}
+
+static int mxc_epdc_fb_register_user_buf(struct mxc_epdc_fb_data *fb_data,
+					 struct mxcfb_user_buffer *ubuf)
+{
+	struct epdc_user_buf *buf, *next;
+	unsigned long first, last;
+	int count = 0;
+	int i, ret;
+
+	if (!ubuf->size || (ubuf->size > fb_data->map_size))
+		return -EINVAL;
+
+	buf = kzalloc(sizeof(struct epdc_user_buf), GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	first = ubuf->addr >> PAGE_SHIFT;
+	last = (ubuf->addr + ubuf->size - 1) >> PAGE_SHIFT;
+	buf->uaddr = ubuf->addr;
+	buf->size = ubuf->size;
+	buf->pages = kzalloc((last - first + 1) * sizeof(struct page *),
+		GFP_KERNEL);
+	if (!buf->pages) {
+		kfree(buf);
+		return -ENOMEM;
+	}
+
+	/* PxP and CPU only read from the buffer */
+	down_read(&current->mm->mmap_sem);
+	ret = get_user_pages(current, current->mm, ubuf->addr & PAGE_MASK,
+		last - first + 1, 0, 0, buf->pages, NULL);
+	up_read(&current->mm->mmap_sem);
+	if (ret < 0) {
+		buf->npages = 0;
+		epdc_user_buf_free(buf);
+		return ret;
+	}
+	buf->npages = ret;
+	if (buf->npages != last - first + 1) {
+		epdc_user_buf_free(buf);
+		return -EFAULT;
+	}
+
+	buf->vaddr = vmap(buf->pages, buf->npages, VM_MAP, PAGE_KERNEL);
+	if (!buf->vaddr) {
+		epdc_user_buf_free(buf);
+		return -ENOMEM;
+	}
+	buf->vaddr += offset_in_page(ubuf->addr);
+
+	buf->contiguous = true;
+	for (i = 1; i < buf->npages; i++)
+		if (page_to_phys(buf->pages[i]) !=
+			page_to_phys(buf->pages[0]) + i * PAGE_SIZE) {
+			buf->contiguous = false;
+			break;
+		}
+	buf->phys = page_to_phys(buf->pages[0]) + offset_in_page(ubuf->addr);
+	atomic_set(&buf->users, 0);
+	buf->owner = get_pid(task_tgid(current));
+
+	mutex_lock(&fb_data->user_buf_mutex);
+	epdc_user_buf_reap(fb_data);
+	list_for_each_entry(next, &fb_data->user_buf_list, list)
+		count++;
+	if (count >= EPDC_MAX_USER_BUFFERS) {
+		mutex_unlock(&fb_data->user_buf_mutex);
+		epdc_user_buf_free(buf);
+		return -ENOSPC;
+	}
+	if (++fb_data->user_buf_handle == 0)
+		fb_data->user_buf_handle = 1;
+	buf->handle = fb_data->user_buf_handle;
+	list_add_tail(&buf->list, &fb_data->user_buf_list);
+	mutex_unlock(&fb_data->user_buf_mutex);
+
+	dev_dbg(fb_data->dev, "user buffer %d: %d pages, %scontiguous\n",
+		buf->handle, buf->npages, buf->contiguous ? "" : "not ");
+
+	ubuf->handle = buf->handle;
+	return 0;
+}
+
+static int mxc_epdc_fb_unregister_user_buf(struct mxc_epdc_fb_data *fb_data,
+					   u32 handle)
+{
+	struct epdc_user_buf *buf;
+	int ret = -EINVAL;
+
+	mutex_lock(&fb_data->user_buf_mutex);
+	list_for_each_entry(buf, &fb_data->user_buf_list, list) {
+		if (buf->handle != handle)
+			continue;
+		if (!epdc_user_buf_owned(buf)) {
+			ret = -EPERM;
+			break;
+		}
+		if (atomic_read(&buf->users)) {
+			ret = -EBUSY;
+			break;
+		}
+		list_del(&buf->list);
+		epdc_user_buf_free(buf);
+		ret = 0;
+		break;
+	}
+	mutex_unlock(&fb_data->user_buf_mutex);
+
+	return ret;
+}
+
+/*
+ * Look up a registered buffer for an update and take a reference, which
+ * is held until the PxP has read the update.  The alt buffer geometry
+ * must lie within the registered range.
+ */
+static struct epdc_user_buf *epdc_user_buf_get(struct mxc_epdc_fb_data *fb_data,
+					       struct mxcfb_update_data *upd_data)
+{
+	struct mxcfb_alt_buffer_data *alt = &upd_data->alt_buffer_data;
+	struct epdc_user_buf *buf, *found = NULL;
+	u32 stride = alt->width * fb_data->info.var.bits_per_pixel / 8;
+
+	if ((alt->alt_update_region.left + alt->alt_update_region.width >
+		alt->width) ||
+		(alt->alt_update_region.top + alt->alt_update_region.height >
+		alt->height))
+		return NULL;
+
+	mutex_lock(&fb_data->user_buf_mutex);
+	list_for_each_entry(buf, &fb_data->user_buf_list, list) {
+		if (buf->handle != alt->phys_addr)
+			continue;
+		if (epdc_user_buf_owned(buf) && (u64)stride * alt->height <= buf->size) {
+			atomic_inc(&buf->users);
+			found = buf;
+		}
 		break;
-		
-	default:
-		dev_err(fb_data->dev, "Invalid auto update mode parameter.\n");
-		return -EINVAL;
 	}
+	mutex_unlock(&fb_data->user_buf_mutex);
 
-	return 0;
+	return found;
 }
-EXPORT_SYMBOL(mxc_epdc_fb_set_auto_update);
 
-int mxc_epdc_fb_set_upd_scheme(u32 upd_scheme, struct fb_info *info)
+static inline void epdc_user_buf_put(struct update_desc_list *upd_desc)
 {
-	struct mxc_epdc_fb_data *fb_data = info ?
-		(struct mxc_epdc_fb_data *)info:g_fb_data;
-
-	dev_dbg(fb_data->dev, "Setting optimization level to %d\n", upd_scheme);
-
-	/*
-	 * Can't change the scheme while until current updates have completed.
-	 * This function returns when all active updates are done.
-	 */
-	mxc_epdc_fb_flush_updates(fb_data);
-
-	if ((upd_scheme == UPDATE_SCHEME_SNAPSHOT)
-		|| (upd_scheme == UPDATE_SCHEME_QUEUE)
-		|| (upd_scheme == UPDATE_SCHEME_QUEUE_AND_MERGE))
-		fb_data->upd_scheme = upd_scheme;
-	else {
-		dev_err(fb_data->dev, "Invalid update scheme specified.\n");
-		return -EINVAL;
+	if (upd_desc->user_buf) {
+		atomic_dec(&upd_desc->user_buf->users);
+		upd_desc->user_buf = NULL;
 	}
+}
 
-	return 0;
+/*
+ * Free an update descriptor, dropping any user buffer reference it still
+ * holds.  An orphaned buffer left unused is freed by the next reap.
+ */
+static inline void epdc_update_desc_free(struct update_desc_list *upd_desc)
+{
+	epdc_user_buf_put(upd_desc);
+	kfree(upd_desc);
 }
-EXPORT_SYMBOL(mxc_epdc_fb_set_upd_scheme);
 
-static void copy_before_process(struct mxc_epdc_fb_data *fb_data,
-	struct update_data_list *upd_data_list)
+/*
+ * CPU address of the first pixel of an update's source region, along with
+ * that region and the source stride in bytes.
+ */
+static u8 *epdc_update_src(struct mxc_epdc_fb_data *fb_data,
+	struct update_desc_list *upd_desc, struct mxcfb_rect **region,
+	int *stride)
 {
-	struct mxcfb_update_data *upd_data =
-		&upd_data_list->update_desc->upd_data;
-	int i;
-	unsigned char *temp_buf_ptr = upd_data_list->virt_addr_copybuf;
-	unsigned char *src_ptr;
+	struct mxcfb_update_data *upd_data = &upd_desc->upd_data;
 	struct mxcfb_rect *src_upd_region;
-	int temp_buf_stride;
+	unsigned char *src_ptr;
 	int src_stride;
 	int bpp = fb_data->info.var.bits_per_pixel;
-	int left_offs, right_offs;
-	int x_trailing_bytes, y_trailing_bytes;
 	int alt_buf_offset;
 
 	/* Set source buf pointer based on input source, panning, etc. */
-	if (upd_data->flags & EPDC_FLAG_USE_ALT_BUFFER) {
+	if (upd_desc->user_buf) {
+		src_upd_region = &upd_data->alt_buffer_data.alt_update_region;
+		src_stride =
+			upd_data->alt_buffer_data.width * bpp/8;
+		src_ptr = upd_desc->user_buf->vaddr
+			+ src_upd_region->top * src_stride;
+	} else if (upd_data->flags & EPDC_FLAG_USE_ALT_BUFFER) {
 		src_upd_region = &upd_data->alt_buffer_data.alt_update_region;
 		src_stride =
 			upd_data->alt_buffer_data.width * bpp/8;
@@ -1624,35 +2674,33 @@ static void copy_before_process(struct mxc_epdc_fb_data *fb_data,
 			+ src_upd_region->top * src_stride;
 	}
 
-	temp_buf_stride = ALIGN(src_upd_region->width, 8) * bpp/8;
-	left_offs = src_upd_region->left * bpp/8;
-	right_offs = src_upd_region->width * bpp/8;
-	x_trailing_bytes = (ALIGN(src_upd_region->width, 8)
-		- src_upd_region->width) * bpp/8;
-
-	for (i = 0; i < src_upd_region->height; i++) {
-		/* Copy the full line */
-		memcpy(temp_buf_ptr, src_ptr + left_offs,
-			src_upd_region->width * bpp/8);
+	*region = src_upd_region;
+	*stride = src_stride;
+	return src_ptr + src_upd_region->left * bpp/8;
+}
 
-		/* Clear any unwanted pixels at the end of each line */
-		if (src_upd_region->width & 0x7) {
-			memset(temp_buf_ptr + right_offs, 0x0,
-				x_trailing_bytes);
-		}
+/* Returns the level mask of the update if op converted it, else 0 */
+static u32 copy_before_process(struct mxc_epdc_fb_data *fb_data,
+	struct update_data_list *upd_data_list, enum epdc_pixel_op op)
+{
+	unsigned char *src_ptr;
+	struct mxcfb_rect *src_upd_region;
+	int temp_buf_stride;
+	int src_stride;
+	int bpp = fb_data->info.var.bits_per_pixel;
 
-		temp_buf_ptr += temp_buf_stride;
-		src_ptr += src_stride;
-	}
+	src_ptr = epdc_update_src(fb_data, upd_data_list->update_desc,
+		&src_upd_region, &src_stride);
 
-	/* Clear any unwanted pixels at the bottom of the end of each line */
-	if (src_upd_region->height & 0x7) {
-		y_trailing_bytes = (ALIGN(src_upd_region->height, 8)
-			- src_upd_region->height) *
-			ALIGN(src_upd_region->width, 8) * bpp/8;
+	/* Converted output is always one byte per pixel */
+	if (op == EPDC_PIXEL_COPY)
+		temp_buf_stride = ALIGN(src_upd_region->width, 8) * bpp/8;
+	else
+		temp_buf_stride = ALIGN(src_upd_region->width, 8);
 
-		memset(temp_buf_ptr, 0x0, y_trailing_bytes);
-	}
+	return epdc_copy_pad_rows(upd_data_list->virt_addr_copybuf,
+		temp_buf_stride, src_ptr, src_stride, src_upd_region->width,
+		src_upd_region->height, bpp/8, op);
 }
 
 static int epdc_process_update(struct update_data_list *upd_data_list,
@@ -1670,8 +2718,15 @@ static int epdc_process_update(struct update_data_list *upd_data_list,
 	bool line_overflow = false;
 	int pix_per_line_added;
 	bool use_temp_buf = false;
+	bool cpu_convert;
+	bool cpu_hist, pad_in_place;
+	u32 levels = 0;
+	enum epdc_pixel_op pixel_op = EPDC_PIXEL_COPY;
+	u32 s0_pixel_fmt;
 	struct mxcfb_rect temp_buf_upd_region;
 	struct update_desc_list *upd_desc_list = upd_data_list->update_desc;
+	bool auto_wf = (upd_desc_list->upd_data.waveform_mode ==
+		WAVEFORM_MODE_AUTO);
 
 	int ret;
 
@@ -1737,15 +2792,55 @@ static int epdc_process_update(struct update_data_list *upd_data_list,
 	               ALIGN(src_upd_region->width + pix_per_line_added, 8)))
 	       line_overflow = true;
 
+	/*
+	 * Small RGB565 regions are cheaper to convert to luma on the CPU
+	 * than to push through the PxP CSC, so take the copy path for them
+	 * even when aligned.  The EPDC buffer is P4N, so only the top nibble
+	 * reaches the panel; for AUTO updates we replicate it into the low
+	 * nibble so the PxP histogram sees the levels the panel will show.
+	 */
+	cpu_convert = !fb_data->epdc_fb_var.grayscale && (bytes_per_pixel == 2);
+	if (cpu_convert)
+		pixel_op = auto_wf ? EPDC_PIXEL_RGB565_Y4 :
+			EPDC_PIXEL_RGB565_Y8;
+	else if ((bytes_per_pixel == 1) && auto_wf)
+		pixel_op = EPDC_PIXEL_Y8_Y4;
+
+	/*
+	 * Auto waveform is classified on the CPU over the exact update
+	 * region, so the PxP's 8x8 padding no longer skews the choice and an
+	 * update whose only problem is an unaligned width/height can be
+	 * processed in place, provided the padded block stays inside the
+	 * source.  Unaligned input addresses (case 2) still take the copy.
+	 */
+	cpu_hist = auto_wf &&
+		!(upd_desc_list->upd_data.flags & EPDC_FLAG_FORCE_MONOCHROME) &&
+		((bytes_per_pixel == 1) || ((bytes_per_pixel == 2) &&
+		!fb_data->epdc_fb_var.grayscale));
+	pad_in_place = (!auto_wf || cpu_hist) &&
+		(src_upd_region->left + ALIGN(src_upd_region->width, 8) <=
+			src_width) &&
+		(src_upd_region->top + ALIGN(src_upd_region->height, 8) <=
+			src_height);
+	if (pad_in_place) {
+		width_unaligned = 0;
+		height_unaligned = 0;
+	}
+
+	/* Scattered user pages can only be read by the CPU */
        if ((width_unaligned || height_unaligned || input_unaligned) 
-	       || line_overflow) {
+	       || line_overflow || (upd_desc_list->user_buf &&
+	       !upd_desc_list->user_buf->contiguous) || (cpu_convert &&
+	       (epdc_rect_area(src_upd_region) <= EPDC_CPU_CONVERT_MAX_PIXELS))) {
 		dev_dbg(fb_data->dev, "Copying update before processing.\n");
 
 		/* Update to reflect what the new source buffer will be */
 		src_width = ALIGN(src_upd_region->width, 8);
 		src_height = ALIGN(src_upd_region->height, 8);
 
-		copy_before_process(fb_data, upd_data_list);
+		levels = copy_before_process(fb_data, upd_data_list, pixel_op);
+		if (pixel_op != EPDC_PIXEL_COPY)
+			bytes_per_pixel = 1;
 
 		/*
 		 * src_upd_region should now describe
@@ -1758,6 +2853,16 @@ static int epdc_process_update(struct update_data_list *upd_data_list,
 		src_upd_region = &temp_buf_upd_region;
 
 		use_temp_buf = true;
+	} else if (cpu_hist && ((src_upd_region->width & 0x7) ||
+		(src_upd_region->height & 0x7))) {
+		/* PxP will see padding pixels; classify the real ones here */
+		struct mxcfb_rect *region;
+		int stride;
+		u8 *src = epdc_update_src(fb_data, upd_desc_list, &region,
+			&stride);
+
+		levels = epdc_levels_rect(src, stride, region->width,
+			region->height, bytes_per_pixel);
 	}
 
 	/*
@@ -1827,12 +2932,30 @@ static int epdc_process_update(struct update_data_list *upd_data_list,
 
 	mutex_lock(&fb_data->pxp_mutex);
 
+	/* CPU-converted copy is already luma; run it as GREY for this job */
+	s0_pixel_fmt = fb_data->pxp_conf.s0_param.pixel_fmt;
+	if (use_temp_buf && (pixel_op != EPDC_PIXEL_COPY))
+		fb_data->pxp_conf.s0_param.pixel_fmt = PXP_PIX_FMT_GREY;
+
 	/* Source address either comes from alternate buffer
 	   provided in update data, or from the framebuffer. */
-	if (use_temp_buf)
+	fb_data->pxp_vaddr[0] = NULL;
+	if (use_temp_buf) {
 		sg_dma_address(&fb_data->sg[0]) =
 			upd_data_list->phys_addr_copybuf;
-	else if (upd_desc_list->upd_data.flags & EPDC_FLAG_USE_ALT_BUFFER)
+		fb_data->pxp_vaddr[0] = upd_data_list->virt_addr_copybuf;
+	} else if (upd_desc_list->user_buf) {
+		/* Contiguous user buffer: PxP reads it in place */
+		struct epdc_user_buf *buf = upd_desc_list->user_buf;
+		u32 len = src_upd_region->height * src_width * bytes_per_pixel;
+
+		dmac_clean_range(buf->vaddr + pxp_input_offs,
+			buf->vaddr + pxp_input_offs + len);
+		outer_clean_range(buf->phys + pxp_input_offs,
+			buf->phys + pxp_input_offs + len);
+		sg_dma_address(&fb_data->sg[0]) = buf->phys + pxp_input_offs;
+		fb_data->pxp_vaddr[0] = buf->vaddr + pxp_input_offs;
+	} else if (upd_desc_list->upd_data.flags & EPDC_FLAG_USE_ALT_BUFFER)
 		sg_dma_address(&fb_data->sg[0]) =
 			upd_desc_list->upd_data.alt_buffer_data.phys_addr
 				+ pxp_input_offs;
@@ -1844,6 +2967,8 @@ static int epdc_process_update(struct update_data_list *upd_data_list,
 			virt_to_page(fb_data->info.screen_base),
 			fb_data->info.fix.smem_len,
 			offset_in_page(fb_data->info.screen_base));
+		fb_data->pxp_vaddr[0] = fb_data->info.screen_base
+			+ fb_data->fb_offset + pxp_input_offs;
 	}
 
 	/* Update sg[1] to point to output of PxP proc task */
@@ -1852,6 +2977,7 @@ static int epdc_process_update(struct update_data_list *upd_data_list,
 	sg_set_page(&fb_data->sg[1], virt_to_page(upd_data_list->virt_addr),
 		    upd_data_list->size,
 		    offset_in_page(upd_data_list->virt_addr));
+	fb_data->pxp_vaddr[1] = upd_data_list->virt_addr + pxp_output_shift;
 
 	/*
 	 * Set PxP LUT transform type based on update flags.
@@ -1871,11 +2997,14 @@ static int epdc_process_update(struct update_data_list *upd_data_list,
 		fb_data->pxp_conf.proc_data.lut_transform ^= PXP_LUT_INVERT;
 
 	/* This is a blocking call, so upon return PxP tx should be done */
+	epdc_lat_stamp(upd_desc_list, EPDC_LAT_PXP_START, INVALID_LUT);
 	ret = pxp_process_update(fb_data, src_width, src_height,
 		&pxp_upd_region);
+	fb_data->pxp_conf.s0_param.pixel_fmt = s0_pixel_fmt;
 	if (ret) {
 		dev_err(fb_data->dev, "Unable to submit PxP update task.\n");
 		mutex_unlock(&fb_data->pxp_mutex);
+		epdc_user_buf_put(upd_desc_list);
 		return ret;
 	}
 
@@ -1890,13 +3019,27 @@ static int epdc_process_update(struct update_data_list *upd_data_list,
 	if (ret) {
 		dev_err(fb_data->dev, "Unable to complete PxP update task: %d\n", ret);
 		mutex_unlock(&fb_data->pxp_mutex);
+		epdc_user_buf_put(upd_desc_list);
 		return ret;
 	}
+	epdc_lat_stamp(upd_desc_list, EPDC_LAT_PXP_DONE, INVALID_LUT);
 
 	mutex_unlock(&fb_data->pxp_mutex);
 
-	/* Update waveform mode from PxP histogram results */
+	/* PxP is done reading the source; free it if its owner is gone */
+	if (upd_desc_list->user_buf && upd_desc_list->user_buf->orphaned) {
+		epdc_user_buf_put(upd_desc_list);
+		mutex_lock(&fb_data->user_buf_mutex);
+		epdc_user_buf_reap(fb_data);
+		mutex_unlock(&fb_data->user_buf_mutex);
+	} else
+		epdc_user_buf_put(upd_desc_list);
+
+	/* Update waveform mode from CPU or PxP histogram results */
 	if (upd_desc_list->upd_data.waveform_mode == WAVEFORM_MODE_AUTO) {
+		if (cpu_hist && levels)
+			hist_stat = epdc_levels_to_hist(levels);
+
 		if (hist_stat & 0x1)
 			upd_desc_list->upd_data.waveform_mode =
 				fb_data->wv_modes.mode_du;
@@ -1924,74 +3067,74 @@ static int epdc_process_update(struct update_data_list *upd_data_list,
 
 }
 
-static int epdc_submit_merge(struct update_desc_list *upd_desc_list,
-				struct update_desc_list *update_to_merge)
+/* Per-update merge overhead given the LUTs free right now */
+static u32 epdc_update_overhead(struct mxc_epdc_fb_data *fb_data)
+{
+	int i, luts_busy = 0;
+
+	for (i = 0; i < EPDC_NUM_LUTS; i++)
+		if (fb_data->lut_shadow[i].busy)
+			luts_busy++;
+
+	return epdc_merge_overhead(EPDC_NUM_LUTS - luts_busy);
+}
+
+/*
+ * Merge update_to_merge into upd_desc_list if that is cheaper than
+ * running the two separately.
+ *
+ * Overlapping updates are always merged: submitting them separately
+ * would collide in HW and force a resubmit anyway.  Disjoint updates are
+ * merged into their bounding box only if the weighted pixel cost of the
+ * box does not exceed the cost of both updates plus the per-update
+ * overhead, and the box does not reach into cells held by blocked
+ * updates (held_cells, see epdc_sched_next_ready()).
+ */
+static int epdc_submit_merge(struct mxc_epdc_fb_data *fb_data,
+				struct update_desc_list *upd_desc_list,
+				struct update_desc_list *update_to_merge,
+				u64 held_cells)
 {
 	struct mxcfb_update_data *a, *b;
 	struct mxcfb_rect *arect, *brect;
-	struct mxcfb_rect combine;
+	struct mxcfb_rect combine, panel_combine;
+	u32 merged_mode;
+	int ret;
 
 	a = &upd_desc_list->upd_data;
 	b = &update_to_merge->upd_data;
 	arect = &upd_desc_list->upd_data.update_region;
 	brect = &update_to_merge->upd_data.update_region;
 
-	/*
-	 * Updates with different flags must be executed sequentially.
-	* Halt the merge process to ensure this.
-	*/
-	if (a->flags != b->flags)
-		return MERGE_BLOCK;
-
-	if (arect->left > (brect->left + brect->width) || 
-			brect->left > (arect->left + arect->width) ||
-			arect->top > (brect->top + brect->height) ||
-			brect->top > (arect->top + arect->height))
-	{
-		return MERGE_FAIL;
-	}
+	ret = epdc_merge_mode(&fb_data->wv_modes, a, b, &merged_mode);
+	if (ret != MERGE_OK)
+		return ret;
 
-	if (a->waveform_mode == b->waveform_mode)
-	{
-		// Just merge MERGE_OK
-	}
-	else if (a->waveform_mode == g_fb_data->wv_modes.mode_a2 ||
-			b->waveform_mode == g_fb_data->wv_modes.mode_a2 ||
-			a->waveform_mode == g_fb_data->wv_modes.mode_gl16 ||
-			b->waveform_mode == g_fb_data->wv_modes.mode_gl16)
-	{
-		// A2 and GL16 should not be merge unless both have same waveform
-		return MERGE_FAIL;
-	}
-	else if (a->waveform_mode == g_fb_data->wv_modes.mode_gc16 ||
-			b->waveform_mode == g_fb_data->wv_modes.mode_gc16)
-	{
-		// GC16 takes precedence over anything else (except A2 and GL16)
-		a->waveform_mode = g_fb_data->wv_modes.mode_gc16;
-	}
-	else
-	{
-		// AUTO with anything else should stay an AUTO (except A2 GL16 and GC16)
-		a->update_mode = WAVEFORM_MODE_AUTO;
+	epdc_rect_union(arect, brect, &combine);
+
+	if (!epdc_rects_overlap(arect, brect)) {
+		if (!epdc_merge_cheaper(&fb_data->wv_modes, a, b, &combine,
+				merged_mode, epdc_update_overhead(fb_data))) {
+			fb_data->sched_stats.merges_declined++;
+			return MERGE_FAIL;
+		}
+
+		/* Box must not swallow regions that are waiting their turn */
+		adjust_coordinates(fb_data, &combine, &panel_combine);
+		if (epdc_sched_cells(fb_data, &panel_combine) & held_cells) {
+			fb_data->sched_stats.merges_declined++;
+			return MERGE_FAIL;
+		}
 	}
 
+	a->waveform_mode = merged_mode;
+
 	if (a->update_mode == UPDATE_MODE_FULL ||
 			b->update_mode == UPDATE_MODE_FULL)
 	{
 		// If any of the two updates are FULL, make it a FULL update
 		a->update_mode = UPDATE_MODE_FULL;
 	}
-  
-	combine.left = arect->left < brect->left ? arect->left : brect->left;
-	combine.top = arect->top < brect->top ? arect->top : brect->top;
-	combine.width = (arect->left + arect->width) >
-			(brect->left + brect->width) ?
-			(arect->left + arect->width - combine.left) :
-			(brect->left + brect->width - combine.left);
-	combine.height = (arect->top + arect->height) >
-			(brect->top + brect->height) ?
-			(arect->top + arect->height - combine.top) :
-			(brect->top + brect->height - combine.top);
 
 	*arect = combine;
 
@@ -2004,9 +3147,80 @@ static int epdc_submit_merge(struct update_desc_list *upd_desc_list,
 		(upd_desc_list->update_order > update_to_merge->update_order) ?
 		upd_desc_list->update_order : update_to_merge->update_order;
 
+	/* Merged update has waited since the earlier of the two was queued */
+	if (time_before(update_to_merge->queue_time, upd_desc_list->queue_time))
+		upd_desc_list->queue_time = update_to_merge->queue_time;
+	if (update_to_merge->lat_ns[EPDC_LAT_SEND] <
+		upd_desc_list->lat_ns[EPDC_LAT_SEND])
+		upd_desc_list->lat_ns[EPDC_LAT_SEND] =
+			update_to_merge->lat_ns[EPDC_LAT_SEND];
+
+	fb_data->sched_stats.merges++;
+
 	return MERGE_OK;
 }
 
+/*
+ * A newly queued update that supersedes an older pending one (see
+ * epdc_update_supersedes()) makes the older one redundant.  Fold such
+ * updates into the new one before they reach the PxP.  Called with queue_lock held, with
+ * upd_desc not yet on the pending list.
+ */
+static void epdc_collapse_superseded(struct mxc_epdc_fb_data *fb_data,
+				     struct update_desc_list *upd_desc)
+{
+	struct update_desc_list *next_desc, *temp_desc;
+
+	list_for_each_entry_safe(next_desc, temp_desc,
+		&fb_data->upd_pending_list, list) {
+		if (!epdc_update_supersedes(&fb_data->wv_modes,
+				&upd_desc->upd_data, &next_desc->upd_data))
+			continue;
+
+		dev_dbg(fb_data->dev, "Update %d superseded by update %d\n",
+			next_desc->update_order, upd_desc->update_order);
+
+		list_splice_tail(&next_desc->upd_marker_list,
+			&upd_desc->upd_marker_list);
+		if (time_before(next_desc->queue_time, upd_desc->queue_time))
+			upd_desc->queue_time = next_desc->queue_time;
+		if (next_desc->lat_ns[EPDC_LAT_SEND] <
+			upd_desc->lat_ns[EPDC_LAT_SEND])
+			upd_desc->lat_ns[EPDC_LAT_SEND] =
+				next_desc->lat_ns[EPDC_LAT_SEND];
+		list_del_init(&next_desc->list);
+		epdc_sched_dequeue(fb_data, next_desc);
+		epdc_update_desc_free(next_desc);
+
+		fb_data->sched_stats.superseded++;
+	}
+}
+
+/* Bitmask of LUTs with an update still running, per the LUT shadow */
+static u32 epdc_sched_luts_busy(struct mxc_epdc_fb_data *fb_data)
+{
+	u32 luts_busy = 0;
+	int i;
+
+	for (i = 0; i < EPDC_NUM_LUTS; i++)
+		if (fb_data->lut_shadow[i].busy)
+			luts_busy |= 1 << i;
+
+	return luts_busy;
+}
+
+/* Number of PxP-processed updates waiting for the EPDC */
+static int epdc_pxp_parked(struct mxc_epdc_fb_data *fb_data)
+{
+	struct update_data_list *plist;
+	int count = 0;
+
+	list_for_each_entry(plist, &fb_data->upd_buf_queue, list)
+		count++;
+
+	return count;
+}
+
 static void epdc_submit_work_func(struct work_struct *work)
 {
 	int temp_index;
@@ -2019,11 +3233,34 @@ static void epdc_submit_work_func(struct work_struct *work)
 	struct update_data_list *upd_data_list = NULL;
 	struct mxcfb_rect adj_update_region;
 	bool end_merge = false;
+	bool overlapped;
+	ktime_t pxp_start;
+	u32 pxp_us;
+	u64 held_cells = 0;
 	int ret;
 
 	/* Protect access to buffer queues and to update HW */
 	spin_lock_irqsave(&fb_data->queue_lock, flags);
 
+	/*
+	 * Updates already through the PxP go to the EPDC first, oldest
+	 * first.  If the EPDC still can't take one, use the time to run
+	 * the next update through the PxP, up to the pipeline depth.
+	 */
+	if (!list_empty(&fb_data->upd_buf_queue)) {
+		if (!fb_data->cur_update && epdc_any_luts_available())
+			upd_data_list = epdc_sched_next_parked(fb_data);
+		if (upd_data_list) {
+			list_del_init(&upd_data_list->list);
+			goto submit;
+		}
+
+		if (epdc_pxp_parked(fb_data) >= EPDC_PXP_PIPELINE_DEPTH) {
+			spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+			return;
+		}
+	}
+
 	/*
 	 * Are any of our collision updates able to go now?
 	 * Go through all updates in the collision list and check to see
@@ -2049,13 +3286,14 @@ static void epdc_submit_work_func(struct work_struct *work)
 				/* If not merging, we have our update */
 				break;
 		} else {
-			switch (epdc_submit_merge(upd_data_list->update_desc,
-						next_update->update_desc)) {
+			switch (epdc_submit_merge(fb_data,
+						upd_data_list->update_desc,
+						next_update->update_desc, 0)) {
 			case MERGE_OK:
 			       dev_dbg(fb_data->dev,
 			               "Update merged [collision]\n");
 				list_del_init(&next_update->update_desc->list);
-				kfree(next_update->update_desc);
+				epdc_update_desc_free(next_update->update_desc);
 				next_update->update_desc = NULL;
 			       list_del_init(&next_update->list);
 			       /* Add to free buffer list */
@@ -2096,32 +3334,55 @@ static void epdc_submit_work_func(struct work_struct *work)
 				return;
 		}
 
-		list_for_each_entry_safe(next_desc, temp_desc,
-			&fb_data->upd_pending_list, list) {
-
+		if (!upd_data_list &&
+			!list_empty(&fb_data->upd_pending_list)) {
 			dev_dbg(fb_data->dev, "Found a pending update!\n");
 
-			if (!upd_data_list) {
-				if (list_empty(&fb_data->upd_buf_free_list))
-					break;
-				upd_data_list =
-					list_entry(fb_data->upd_buf_free_list.next,
-						struct update_data_list, list);
-				list_del_init(&upd_data_list->list);
-				upd_data_list->update_desc = next_desc;
-				list_del_init(&next_desc->list);
-				if (fb_data->upd_scheme ==
-					UPDATE_SCHEME_QUEUE)
-					/* If not merging, we have an update */
-					break;
-			 } else {
-				switch (epdc_submit_merge(upd_data_list->update_desc,
-						next_desc)) {
+			/*
+			 * Prefer the oldest update whose blockers have all
+			 * retired; if everything is blocked, fall back to
+			 * strict queue order and let the HW sort out the
+			 * collision.
+			 */
+			next_desc = epdc_sched_next_ready(fb_data);
+			if (!next_desc)
+				next_desc = list_entry(
+					fb_data->upd_pending_list.next,
+					struct update_desc_list, list);
+
+			upd_data_list =
+				list_entry(fb_data->upd_buf_free_list.next,
+					struct update_data_list, list);
+			list_del_init(&upd_data_list->list);
+			upd_data_list->update_desc = next_desc;
+			list_del_init(&next_desc->list);
+			epdc_sched_dequeue(fb_data, next_desc);
+		}
+
+		if (upd_data_list &&
+			(fb_data->upd_scheme != UPDATE_SCHEME_QUEUE)) {
+			list_for_each_entry_safe(next_desc, temp_desc,
+				&fb_data->upd_pending_list, list) {
+
+				/*
+				 * Don't pull blocked updates (or anything
+				 * queued behind them) into this one.
+				 */
+				if (next_desc->blocking_luts ||
+					(next_desc->cells & held_cells)) {
+					held_cells |= next_desc->cells;
+					continue;
+				}
+
+				switch (epdc_submit_merge(fb_data,
+						upd_data_list->update_desc,
+						next_desc, held_cells)) {
 			       case MERGE_OK:
 			               dev_dbg(fb_data->dev,
 			                       "Update merged [queue]\n");
 					list_del_init(&next_desc->list);
-					kfree(next_desc);
+					epdc_sched_dequeue(fb_data, next_desc);
+					epdc_update_desc_free(next_desc);
 			               break;
 			       case MERGE_FAIL:
 			               dev_dbg(fb_data->dev,
@@ -2136,10 +3397,18 @@ static void epdc_submit_work_func(struct work_struct *work)
 
 			       if (end_merge)
 			               break;
-	               }
+			}
 		}
 	}
 
+	/* Region may have grown through merging; recompute its blockers */
+	if (upd_data_list)
+		epdc_sched_refresh(fb_data, upd_data_list->update_desc);
+
+	/* Is an earlier update still being driven to the panel? */
+	overlapped = (fb_data->cur_update != NULL) ||
+		(epdc_sched_luts_busy(fb_data) != 0);
+
 	/* Release buffer queues */
 	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
 
@@ -2148,12 +3417,15 @@ static void epdc_submit_work_func(struct work_struct *work)
 		return;
 
 	/* Perform PXP processing - EPDC power will also be enabled */
-	if (epdc_process_update(upd_data_list, fb_data)) {
+	pxp_start = ktime_get();
+	ret = epdc_process_update(upd_data_list, fb_data);
+	pxp_us = ktime_us_delta(ktime_get(), pxp_start);
+	if (ret) {
 		dev_dbg(fb_data->dev, "PXP processing error.\n");
 		/* Protect access to buffer queues and to update HW */
 		spin_lock_irqsave(&fb_data->queue_lock, flags);
 		list_del_init(&upd_data_list->update_desc->list);
-		kfree(upd_data_list->update_desc);
+		epdc_update_desc_free(upd_data_list->update_desc);
 		upd_data_list->update_desc = NULL;
 		/* Add to free buffer list */
 		list_add_tail(&upd_data_list->list,
@@ -2163,14 +3435,51 @@ static void epdc_submit_work_func(struct work_struct *work)
 		return;
 	}
 
+	/* Protect access to buffer queues and to update HW */
+	spin_lock_irqsave(&fb_data->queue_lock, flags);
+
+	fb_data->sched_stats.pxp_passes++;
+	fb_data->sched_stats.pxp_us_total += pxp_us;
+	if (overlapped) {
+		fb_data->sched_stats.pxp_overlapped++;
+		fb_data->sched_stats.pxp_overlap_us_total += pxp_us;
+	}
+
+	/*
+	 * Rather than blocking here until the working buffer or a LUT
+	 * frees up, park the processed update and go on to the next PxP
+	 * pass.  The same goes for an update that would collide with a LUT
+	 * still in flight: holding it until that LUT retires is cheaper
+	 * than the EPDC collision and resubmit.  The WB/LUT complete IRQs
+	 * requeue this work, which then submits parked updates in order.
+	 */
+	upd_data_list->update_desc->blocking_luts = epdc_sched_blockers(
+		fb_data, &upd_data_list->update_desc->panel_region,
+		upd_data_list->update_desc->cells);
+	if ((fb_data->cur_update != NULL) || !epdc_any_luts_available() ||
+		!list_empty(&fb_data->upd_buf_queue) ||
+		upd_data_list->update_desc->blocking_luts) {
+		dev_dbg(fb_data->dev, "EPDC busy, parking processed update\n");
+		list_add_tail(&upd_data_list->list, &fb_data->upd_buf_queue);
+		fb_data->sched_stats.parked++;
+		if (upd_data_list->update_desc->blocking_luts)
+			fb_data->sched_stats.held++;
+		if (epdc_pxp_parked(fb_data) > fb_data->sched_stats.parked_max)
+			fb_data->sched_stats.parked_max =
+				epdc_pxp_parked(fb_data);
+		if (!list_empty(&fb_data->upd_pending_list))
+			queue_work(fb_data->epdc_submit_workqueue,
+				&fb_data->epdc_submit_work);
+		spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+		return;
+	}
+
+submit:
 	/* Get rotation-adjusted coordinates */
 	adjust_coordinates(fb_data,
 		&upd_data_list->update_desc->upd_data.update_region,
 		&adj_update_region);
 
-	/* Protect access to buffer queues and to update HW */
-	spin_lock_irqsave(&fb_data->queue_lock, flags);
-
 	/*
 	 * Is the working buffer idle?
 	 * If the working buffer is busy, we must wait for the resource
@@ -2298,12 +3607,20 @@ static void epdc_submit_work_func(struct work_struct *work)
 				upd_data_list->update_desc->upd_data.waveform_mode,
 				upd_data_list->update_desc->upd_data.update_mode,
 				upd_data_list->update_desc->upd_data.temp);
+		epdc_sched_lut_start(fb_data, upd_data_list->update_desc,
+			upd_data_list->lut_num, &adj_update_region);
 		epdc_submit_update(upd_data_list->lut_num,
 			upd_data_list->update_desc->upd_data.waveform_mode,
 			upd_data_list->update_desc->upd_data.update_mode,
 			false, 0);
 	}
-		
+
+	/* Start the next PxP pass while this update is on the panel */
+	if (!list_empty(&fb_data->upd_buf_queue) ||
+		!list_empty(&fb_data->upd_pending_list))
+		queue_work(fb_data->epdc_submit_workqueue,
+			&fb_data->epdc_submit_work);
+
 	/* Release buffer queues */
 	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
 }
@@ -2334,8 +3651,8 @@ static long long timeofday_msec(void)
         return (long long)tv.tv_sec*1000 + tv.tv_usec/1000;
 }
 
-int mxc_epdc_fb_send_update(struct mxcfb_update_data *upd_data,
-				   struct fb_info *info)
+static int epdc_send_update(struct mxcfb_update_data *upd_data,
+			    struct fb_info *info)
 {
 	struct mxc_epdc_fb_data *fb_data = info ?
 		(struct mxc_epdc_fb_data *)info:g_fb_data;
@@ -2346,6 +3663,7 @@ int mxc_epdc_fb_send_update(struct mxcfb_update_data *upd_data,
 	int ret;
 	struct update_desc_list *upd_desc;
 	struct update_marker_data *marker_data, *next_marker, *temp_marker;
+	struct epdc_user_buf *user_buf = NULL;
 
 	if (mxc_epdc_paused) {
 		dev_err(fb_data->dev, "Updates paused ... not sending to epdc\n");
@@ -2394,11 +3712,21 @@ int mxc_epdc_fb_send_update(struct mxcfb_update_data *upd_data,
 				"match screen update region dimensions.\n");
 			return -EINVAL;
 		}
-		/* Validate physical address parameter */
-		if ((upd_data->alt_buffer_data.phys_addr <
+		if (upd_data->flags & EPDC_FLAG_USE_USER_BUFFER) {
+			/* phys_addr carries a registered buffer handle */
+			user_buf = epdc_user_buf_get(fb_data, upd_data);
+			if (!user_buf) {
+				dev_err(fb_data->dev,
+					"Invalid user buffer %d for alternate "
+					"buffer.  Aborting update...\n",
+					upd_data->alt_buffer_data.phys_addr);
+				return -EINVAL;
+			}
+		} else if ((upd_data->alt_buffer_data.phys_addr <
 			fb_data->info.fix.smem_start) ||
 			(upd_data->alt_buffer_data.phys_addr >
 			fb_data->info.fix.smem_start + fb_data->map_size)) {
+			/* Validate physical address parameter */
 			dev_err(fb_data->dev,
 				"Invalid physical address for alternate "
 				"buffer.  Aborting update...\n");
@@ -2417,6 +3745,8 @@ int mxc_epdc_fb_send_update(struct mxcfb_update_data *upd_data,
 		dev_err(fb_data->dev, "EPDC not active."
 			"Update request abort.\n");
 		spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+		if (user_buf)
+			atomic_dec(&user_buf->users);
 		return -EPERM;
 	}
 
@@ -2429,6 +3759,8 @@ int mxc_epdc_fb_send_update(struct mxcfb_update_data *upd_data,
                        dev_err(fb_data->dev,
                                "No free intermediate buffers available.\n");
                        spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+                       if (user_buf)
+                               atomic_dec(&user_buf->users);
                        return -ENOMEM;
                }
 
@@ -2452,6 +3784,8 @@ int mxc_epdc_fb_send_update(struct mxcfb_update_data *upd_data,
 				&fb_data->upd_buf_free_list);
 		}
 		spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+		if (user_buf)
+			atomic_dec(&user_buf->users);
 		return -EPERM;
 	}
 
@@ -2459,6 +3793,12 @@ int mxc_epdc_fb_send_update(struct mxcfb_update_data *upd_data,
 	INIT_LIST_HEAD(&upd_desc->upd_marker_list);
 	upd_desc->upd_data = *upd_data;
 	upd_desc->update_order = fb_data->order_cnt++;
+	upd_desc->user_buf = user_buf;
+	epdc_lat_stamp(upd_desc, EPDC_LAT_SEND, INVALID_LUT);
+	epdc_pwr_note_arrival(fb_data);
+	epdc_sched_enqueue(fb_data, upd_desc);
+	if (fb_data->upd_scheme == UPDATE_SCHEME_QUEUE_AND_MERGE)
+		epdc_collapse_superseded(fb_data, upd_desc);
 	list_add_tail(&upd_desc->list, &fb_data->upd_pending_list);
 
 	/* If marker specified, associate it with a completion */
@@ -2501,11 +3841,12 @@ int mxc_epdc_fb_send_update(struct mxcfb_update_data *upd_data,
 
 	/* Snapshot update scheme processing */
 
-	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
-
 	/* Set descriptor for current update, delete from pending list */
 	upd_data_list->update_desc = upd_desc;
 	list_del_init(&upd_desc->list);
+	epdc_sched_dequeue(fb_data, upd_desc);
+
+	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
 
 	/*
 	 * Hold on to original screen update region, which we
@@ -2605,6 +3946,8 @@ int mxc_epdc_fb_send_update(struct mxcfb_update_data *upd_data,
 			upd_desc->upd_data.waveform_mode,
 			upd_desc->upd_data.update_mode,
 			upd_desc->upd_data.temp);
+	epdc_sched_lut_start(fb_data, upd_desc, upd_data_list->lut_num,
+		screen_upd_region);
 	epdc_submit_update(upd_data_list->lut_num,
 			   upd_desc->upd_data.waveform_mode,
 			   upd_desc->upd_data.update_mode, false, 0);
@@ -2612,6 +3955,24 @@ int mxc_epdc_fb_send_update(struct mxcfb_update_data *upd_data,
 	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
 	return 0;
 }
+
+/*
+ * Updates sent from outside defio may show framebuffer writes defio
+ * never saw (fb_write, the cfb_* draw ops, blits into the mapping of
+ * another process), so the damage shadow can no longer be trusted.
+ */
+int mxc_epdc_fb_send_update(struct mxcfb_update_data *upd_data,
+				   struct fb_info *info)
+{
+	struct mxc_epdc_fb_data *fb_data = info ?
+		(struct mxc_epdc_fb_data *)info:g_fb_data;
+
+	mutex_lock(&fb_data->damage.lock);
+	fb_data->damage.valid = false;
+	mutex_unlock(&fb_data->damage.lock);
+
+	return epdc_send_update(upd_data, info);
+}
 EXPORT_SYMBOL(mxc_epdc_fb_send_update);
 
 int mxc_epdc_fb_wait_update_complete(u32 update_marker, struct fb_info *info)
@@ -2770,6 +4131,28 @@ static int mxc_epdc_fb_ioctl(struct fb_info *info, unsigned int cmd,
 			atomic_set(&mxc_clear_queue, 0);
 			break;
 		}
+	case MXCFB_REGISTER_USER_BUFFER:
+		{
+			struct mxcfb_user_buffer ubuf;
+
+			if (!copy_from_user(&ubuf, argp, sizeof(ubuf))) {
+				ret = mxc_epdc_fb_register_user_buf(fb_data,
+					&ubuf);
+				if (ret == 0 && copy_to_user(argp, &ubuf,
+							sizeof(ubuf)))
+					ret = -EFAULT;
+			} else
+				ret = -EFAULT;
+			break;
+		}
+	case MXCFB_UNREGISTER_USER_BUFFER:
+		{
+			u32 handle = 0;
+			if (!get_user(handle, (__u32 __user *) arg))
+				ret = mxc_epdc_fb_unregister_user_buf(fb_data,
+					handle);
+			break;
+		}
 	case MXCFB_WAIT_FOR_UPDATE_COMPLETE:
 		{
 			u32 update_marker = 0;
@@ -2847,35 +4230,195 @@ static void  mxc_epdc_fb_send_full_update(struct mxc_epdc_fb_data *fb_data)
 
 	mutex_unlock(&fb_data->pxp_mutex);
 
-	mxc_epdc_fb_send_update(&update, &fb_data->info);
+	epdc_send_update(&update, &fb_data->info);
+}
+
+static void mxc_epdc_fb_update_rects(struct mxc_epdc_fb_data *fb_data,
+				     struct mxcfb_rect *rects, int count)
+{
+	struct mxcfb_update_data update;
+	int i;
+
+	cancel_rearming_delayed_work(&ff_work);
+
+	update.waveform_mode = WAVEFORM_MODE_AUTO;
+	update.update_mode = UPDATE_MODE_PARTIAL;
+	update.update_marker = 0;
+//	update.temp = TEMP_USE_AMBIENT; //papyrus_temp;
+	update.temp = TEMP_USE_PAPYRUS;
+	update.flags = 0;
+
+	/* Set the scheme to QUEUE_AND_MERGE */
+	fb_data->upd_scheme = UPDATE_SCHEME_QUEUE_AND_MERGE;
+
+	for (i = 0; i < count; i++) {
+		update.update_region = rects[i];
+		epdc_send_update(&update, &fb_data->info);
+	}
+
+	schedule_delayed_work(&ff_work, msecs_to_jiffies(1000));
 }
 
 static void mxc_epdc_fb_update_pages(struct mxc_epdc_fb_data *fb_data,
 				     u16 y1, u16 y2)
 {
-	struct mxcfb_update_data update;
+	struct mxcfb_rect band;
+
+	/* Do partial screen update, Update full horizontal lines */
+	band.left = 0;
+	band.width = fb_data->epdc_fb_var.xres;
+	band.top = y1;
+	band.height = y2 - y1;
+
+	mxc_epdc_fb_update_rects(fb_data, &band, 1);
+}
+
+/********************************************************
+ * Start Damage Tracking Functions
+ ********************************************************/
+
+static void epdc_damage_free(struct epdc_damage *d)
+{
+	vfree(d->shadow);
+	kfree(d->tiles);
+	d->shadow = NULL;
+	d->tiles = NULL;
+	d->shadow_size = 0;
+	d->valid = false;
+}
+
+/* (Re)size the shadow and tile map for the current screen geometry */
+static int epdc_damage_prepare(struct mxc_epdc_fb_data *fb_data)
+{
+	struct epdc_damage *d = &fb_data->damage;
+	struct fb_info *info = &fb_data->info;
+	u32 size = info->fix.line_length * fb_data->epdc_fb_var.yres;
+	int tiles_x = DIV_ROUND_UP(fb_data->epdc_fb_var.xres,
+		EPDC_DAMAGE_TILE);
+	int tiles_y = DIV_ROUND_UP(fb_data->epdc_fb_var.yres,
+		EPDC_DAMAGE_TILE);
+
+	if (d->shadow && (d->shadow_size == size) &&
+		(d->tiles_x == tiles_x) && (d->tiles_y == tiles_y)) {
+		if (d->shadow_offs != fb_data->fb_offset)
+			d->valid = false;
+		return 0;
+	}
+
+	epdc_damage_free(d);
+
+	d->shadow = vmalloc(size);
+	d->tiles = kzalloc(BITS_TO_LONGS(tiles_x * tiles_y) *
+		sizeof(unsigned long), GFP_KERNEL);
+	if (!d->shadow || !d->tiles) {
+		epdc_damage_free(d);
+		return -ENOMEM;
+	}
+
+	d->shadow_size = size;
+	d->tiles_x = tiles_x;
+	d->tiles_y = tiles_y;
+	return 0;
+}
+
+/*
+ * Diff (or, over budget, just take) the bytes [beg, end] of the
+ * framebuffer, marking dirty tiles and refreshing the shadow.  Only the
+ * visible screen is tracked.  Returns true if anything was marked.
+ */
+static bool epdc_damage_range(struct mxc_epdc_fb_data *fb_data,
+			      u32 beg, u32 end, bool diff)
+{
+	struct epdc_damage *d = &fb_data->damage;
+	u32 line_length = fb_data->info.fix.line_length;
+	u32 bpp = fb_data->epdc_fb_var.bits_per_pixel;
+	u32 tile_bytes = EPDC_DAMAGE_TILE * bpp / 8;
+	u32 row_bytes = fb_data->epdc_fb_var.xres * bpp / 8;
+	u8 *screen = fb_data->info.screen_base + fb_data->fb_offset;
+	u32 off, col, len;
+	bool dirty = false;
+
+	if (end < fb_data->fb_offset)
+		return false;
+	beg = (beg > fb_data->fb_offset) ? beg - fb_data->fb_offset : 0;
+	end = min(end - fb_data->fb_offset + 1, d->shadow_size);
+
+	for (off = beg; off < end; off += len) {
+		col = off % line_length;
+		if (col >= row_bytes) {
+			/* Stride padding: skip to the next row */
+			len = line_length - col;
+			continue;
+		}
+
+		len = min(tile_bytes - col % tile_bytes, end - off);
+		len = min(len, row_bytes - col);
+
+		if (diff) {
+			d->bytes_diffed += len;
+			if (!memcmp(screen + off, d->shadow + off, len))
+				continue;
+		}
+
+		memcpy(d->shadow + off, screen + off, len);
+		set_bit((off / line_length / EPDC_DAMAGE_TILE) * d->tiles_x +
+			col / tile_bytes, d->tiles);
+		dirty = true;
+	}
 
-  
-	cancel_rearming_delayed_work(&ff_work);
+	return dirty;
+}
 
-	/* Do partial screen update, Update full horizontal lines */
-	update.update_region.left = 0;
-	update.update_region.width = fb_data->epdc_fb_var.xres;
-	update.update_region.top = y1;
-	update.update_region.height = y2 - y1;
-	update.waveform_mode = WAVEFORM_MODE_AUTO;
-	update.update_mode = UPDATE_MODE_PARTIAL;
-	update.update_marker = 0;
-//	update.temp = TEMP_USE_AMBIENT; //papyrus_temp;
-	update.temp = TEMP_USE_PAPYRUS;
-	update.flags = 0;
+/*
+ * Turn the dirty tile map into rectangles: runs of dirty tiles in each
+ * tile row, extended downwards while the row below has the same run.
+ * Returns the rect count, or -1 if more than max were needed.
+ */
+static int epdc_damage_rects(struct mxc_epdc_fb_data *fb_data,
+			     struct mxcfb_rect *rects, int max)
+{
+	struct epdc_damage *d = &fb_data->damage;
+	u32 xres = fb_data->epdc_fb_var.xres;
+	u32 yres = fb_data->epdc_fb_var.yres;
+	u32 left, top, width;
+	int count = 0;
+	int tx, ty, run, i;
 
-	/* Set the scheme to QUEUE_AND_MERGE */
-	fb_data->upd_scheme = UPDATE_SCHEME_QUEUE_AND_MERGE;
+	for (ty = 0; ty < d->tiles_y; ty++) {
+		top = ty * EPDC_DAMAGE_TILE;
 
-	mxc_epdc_fb_send_update(&update, &fb_data->info);
+		for (tx = 0; tx < d->tiles_x; tx += run) {
+			run = 1;
+			if (!test_bit(ty * d->tiles_x + tx, d->tiles))
+				continue;
+			while ((tx + run < d->tiles_x) &&
+				test_bit(ty * d->tiles_x + tx + run, d->tiles))
+				run++;
+
+			left = tx * EPDC_DAMAGE_TILE;
+			width = min_t(u32, run * EPDC_DAMAGE_TILE, xres - left);
+
+			/* Same run ending on the row above? Grow that rect. */
+			for (i = 0; i < count; i++)
+				if ((rects[i].left == left) &&
+					(rects[i].width == width) &&
+					(rects[i].top + rects[i].height == top))
+					break;
 
-	schedule_delayed_work(&ff_work, msecs_to_jiffies(1000));
+			if (i == count) {
+				if (count == max)
+					return -1;
+				rects[count].left = left;
+				rects[count].top = top;
+				rects[count].width = width;
+				count++;
+			}
+			rects[i].height = min_t(u32, top + EPDC_DAMAGE_TILE,
+				yres) - rects[i].top;
+		}
+	}
+
+	return count;
 }
 
 /* this is called back from the deferred io workqueue */
@@ -2883,9 +4426,13 @@ static void mxc_epdc_fb_deferred_io(struct fb_info *info,
 				    struct list_head *pagelist)
 {
 	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
+	struct epdc_damage *d = &fb_data->damage;
+	struct mxcfb_rect rects[EPDC_DAMAGE_MAX_RECTS];
 	struct page *page;
 	unsigned long beg, end;
 	int y1, y2, miny, maxy;
+	u32 budget;
+	int count, i;
 
 	/* Lab126 */
 	printk(KERN_INFO "MXC_EPDC_FB deferred_io\n");
@@ -2907,7 +4454,77 @@ static void mxc_epdc_fb_deferred_io(struct fb_info *info,
 			maxy = y2;
 	}
 
-	mxc_epdc_fb_update_pages(fb_data, miny, maxy);
+	if (maxy < miny)
+		return;
+
+	mutex_lock(&d->lock);
+
+	/* Without a usable shadow, fall back to full-width page bands */
+	if (!d->budget_kb || epdc_damage_prepare(fb_data)) {
+		mxc_epdc_fb_update_pages(fb_data, miny, maxy);
+		goto out;
+	}
+
+	if (!d->valid) {
+		memcpy(d->shadow, info->screen_base + fb_data->fb_offset,
+			d->shadow_size);
+		d->shadow_offs = fb_data->fb_offset;
+		d->valid = true;
+		mxc_epdc_fb_update_pages(fb_data, miny, maxy);
+		goto out;
+	}
+
+	d->passes++;
+	d->pixels_band += fb_data->epdc_fb_var.xres * (maxy - miny);
+	bitmap_zero(d->tiles, d->tiles_x * d->tiles_y);
+
+	budget = d->budget_kb * 1024;
+	list_for_each_entry(page, pagelist, lru) {
+		bool diff = (budget >= PAGE_SIZE);
+
+		if (diff)
+			budget -= PAGE_SIZE;
+		else
+			d->pages_whole++;
+
+		beg = page->index << PAGE_SHIFT;
+		if (!epdc_damage_range(fb_data, beg, beg + PAGE_SIZE - 1,
+			diff))
+			d->pages_clean++;
+	}
+
+	count = epdc_damage_rects(fb_data, rects, EPDC_DAMAGE_MAX_RECTS);
+	if (count < 0) {
+		/* Too fragmented: send the bounding box of the damage */
+		u32 x1 = fb_data->epdc_fb_var.xres, x2 = 0;
+		u32 by1 = fb_data->epdc_fb_var.yres, by2 = 0;
+		int t;
+
+		for (t = 0; t < d->tiles_x * d->tiles_y; t++) {
+			if (!test_bit(t, d->tiles))
+				continue;
+			x1 = min_t(u32, x1, (t % d->tiles_x) * EPDC_DAMAGE_TILE);
+			x2 = max_t(u32, x2,
+				(t % d->tiles_x + 1) * EPDC_DAMAGE_TILE);
+			by1 = min_t(u32, by1, (t / d->tiles_x) * EPDC_DAMAGE_TILE);
+			by2 = max_t(u32, by2,
+				(t / d->tiles_x + 1) * EPDC_DAMAGE_TILE);
+		}
+		rects[0].left = x1;
+		rects[0].top = by1;
+		rects[0].width = min(x2, fb_data->epdc_fb_var.xres) - x1;
+		rects[0].height = min(by2, fb_data->epdc_fb_var.yres) - by1;
+		count = 1;
+	}
+
+	for (i = 0; i < count; i++)
+		d->pixels_sent += rects[i].width * rects[i].height;
+	d->rects += count;
+
+	if (count)
+		mxc_epdc_fb_update_rects(fb_data, rects, count);
+out:
+	mutex_unlock(&d->lock);
 }
 
 void mxc_epdc_fb_flush_updates(struct mxc_epdc_fb_data *fb_data)
@@ -3024,8 +4641,27 @@ static int mxc_epdc_fb_pan_display(struct fb_var_screeninfo *var,
 	return 0;
 }
 
+/*
+ * Closing the framebuffer is the last chance to see a process that
+ * registered user buffers, so drop the buffers of any owner that is
+ * exiting or gone.
+ */
+static int mxc_epdc_fb_release(struct fb_info *info, int user)
+{
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
+
+	if (user) {
+		mutex_lock(&fb_data->user_buf_mutex);
+		epdc_user_buf_reap(fb_data);
+		mutex_unlock(&fb_data->user_buf_mutex);
+	}
+
+	return 0;
+}
+
 static struct fb_ops mxc_epdc_fb_ops = {
 	.owner = THIS_MODULE,
+	.fb_release = mxc_epdc_fb_release,
 	.fb_check_var = mxc_epdc_fb_check_var,
 	.fb_set_par = mxc_epdc_fb_set_par,
 	.fb_setcolreg = mxc_epdc_fb_setcolreg,
@@ -3048,6 +4684,19 @@ static void epdc_done_work_func(struct work_struct *work)
 	struct mxc_epdc_fb_data *fb_data =
 		container_of(work, struct mxc_epdc_fb_data,
 			epdc_done_work.work);
+	struct epdc_pwr_pred *pred = &fb_data->pwr_pred;
+	unsigned long flags;
+
+	/* Speculative power that no update used */
+	spin_lock_irqsave(&fb_data->queue_lock, flags);
+	if (pred->idle && fb_data->powering_down &&
+		((pred->state == EPDC_PWR_HOLD) ||
+		(pred->state == EPDC_PWR_PREPOWERED))) {
+		pred->misses_wasted++;
+		pred->state = EPDC_PWR_OFF;
+	}
+	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+
 	epdc_powerdown(fb_data);
 }
 
@@ -3164,6 +4813,14 @@ static irqreturn_t mxc_epdc_irq_handler(int irq, void *dev_id)
 
 		fb_data->lut_update_order[i] = 0;
 
+		/* Release pending updates that were waiting on this LUT */
+		if (epdc_sched_lut_retire(fb_data, i)) {
+			dev_dbg(fb_data->dev, "LUT %d released pending "
+				"updates\n", i);
+			queue_work(fb_data->epdc_submit_workqueue,
+				   &fb_data->epdc_submit_work);
+		}
+
 		/* Signal completion if submit workqueue needs a LUT */
 		if (fb_data->waiting_for_lut) {
 			complete(&fb_data->update_res_free);
@@ -3218,6 +4875,11 @@ static irqreturn_t mxc_epdc_irq_handler(int irq, void *dev_id)
 		!epdc_luts_active) {
 
 		if (fb_data->pwrdown_delay != FB_POWERDOWN_DISABLE) {
+			int pwrdown_delay = fb_data->pwrdown_delay;
+
+			if (pwrdown_delay == FB_POWERDOWN_ADAPTIVE)
+				pwrdown_delay = epdc_pwr_predict_idle(fb_data);
+
 			/*
 			 * Set variable to prevent overlapping
 			 * enable/disable requests
@@ -3226,7 +4888,7 @@ static irqreturn_t mxc_epdc_irq_handler(int irq, void *dev_id)
 
 			/* Schedule task to disable EPDC HW until next update */
 			schedule_delayed_work(&fb_data->epdc_done_work,
-				msecs_to_jiffies(fb_data->pwrdown_delay));
+				msecs_to_jiffies(pwrdown_delay));
 
 			/* Reset counter to reduce chance of overflow */
 			fb_data->order_cnt = 0;
@@ -3258,6 +4920,8 @@ static irqreturn_t mxc_epdc_irq_handler(int irq, void *dev_id)
 
 		/* Was there a collision? */
 		if (epdc_collision) {
+			fb_data->sched_stats.collisions++;
+
 			/* Check list of colliding LUTs, and add to our collision mask */
 			fb_data->cur_update->collision_mask =
 				epdc_colliding_luts;
@@ -3293,6 +4957,7 @@ static irqreturn_t mxc_epdc_irq_handler(int irq, void *dev_id)
 			}
 
 			if (!ignore_collision) {
+				fb_data->sched_stats.resubmits++;
 				free_update = false;
 				/*
 				 * If update has markers, clear the LUTs to
@@ -3333,7 +4998,7 @@ static irqreturn_t mxc_epdc_irq_handler(int irq, void *dev_id)
 				}
 
 			/* Free marker list and update descriptor */
-			kfree(fb_data->cur_update->update_desc);
+			epdc_update_desc_free(fb_data->cur_update->update_desc);
 
 			/* Add to free buffer list */
 			list_add_tail(&fb_data->cur_update->list,
@@ -3473,6 +5138,8 @@ static irqreturn_t mxc_epdc_irq_handler(int irq, void *dev_id)
 			fb_data->cur_update->update_desc->upd_data.waveform_mode,
 			fb_data->cur_update->update_desc->upd_data.update_mode,
 			fb_data->cur_update->update_desc->upd_data.temp);
+	epdc_sched_lut_start(fb_data, fb_data->cur_update->update_desc,
+		fb_data->cur_update->lut_num, next_upd_region);
 	epdc_submit_update(fb_data->cur_update->lut_num,
 			   fb_data->cur_update->update_desc->upd_data.waveform_mode,
 			   fb_data->cur_update->update_desc->upd_data.update_mode,
@@ -3571,6 +5238,8 @@ static int mxc_epdc_fb_init_hw(struct fb_info *info)
 
 	/* Copy TRT data */
 	memcpy(fb_data->temp_range_bounds, &wv_file->data, fb_data->trt_entries);
+	einkwf_index_temp_ranges(&fb_data->temps, fb_data->temp_range_bounds,
+				 fb_data->trt_entries);
 
 	/* Set default temperature index using TRT and room temp */
 	fb_data->temp_index = mxc_epdc_fb_get_temp_index(fb_data, DEFAULT_TEMP);
@@ -3797,6 +5466,252 @@ static ssize_t mxc_epdc_debug_store(struct device *dev, struct device_attribute
 
 static DEVICE_ATTR(mxc_epdc_debug, 0666, mxc_epdc_debug_show, mxc_epdc_debug_store);
 
+static ssize_t mxc_epdc_sched_stats_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct fb_info *info = dev_get_drvdata(dev);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
+	struct epdc_sched_stats stats;
+	u32 luts_busy;
+	unsigned long flags;
+
+	spin_lock_irqsave(&fb_data->queue_lock, flags);
+	stats = fb_data->sched_stats;
+	luts_busy = epdc_sched_luts_busy(fb_data);
+	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+
+	return sprintf(buf,
+		"queue_depth: %u\n"
+		"queue_depth_max: %u\n"
+		"queued: %u\n"
+		"dispatched: %u\n"
+		"dispatched_ready: %u\n"
+		"released: %u\n"
+		"wait_ms_avg: %u\n"
+		"wait_ms_max: %u\n"
+		"merges: %u\n"
+		"merges_declined: %u\n"
+		"superseded: %u\n"
+		"pixels_requested: %llu\n"
+		"pixels_processed: %llu\n"
+		"pxp_passes: %u\n"
+		"pxp_overlapped: %u\n"
+		"pxp_us_avg: %u\n"
+		"pxp_overlap_pct: %u\n"
+		"parked: %u\n"
+		"parked_max: %u\n"
+		"held: %u\n"
+		"reordered: %u\n"
+		"collisions: %u\n"
+		"resubmits: %u\n"
+		"luts_busy: 0x%04x\n",
+		stats.queue_depth, stats.queue_depth_max, stats.queued,
+		stats.dispatched, stats.dispatched_ready, stats.released,
+		stats.dispatched ?
+			(u32)div_u64(stats.wait_ms_total, stats.dispatched) : 0,
+		stats.wait_ms_max, stats.merges, stats.merges_declined,
+		stats.superseded, stats.pixels_requested,
+		stats.pixels_processed, stats.pxp_passes, stats.pxp_overlapped,
+		stats.pxp_passes ?
+			(u32)div_u64(stats.pxp_us_total, stats.pxp_passes) : 0,
+		stats.pxp_us_total ?
+			(u32)div64_u64(stats.pxp_overlap_us_total * 100,
+				stats.pxp_us_total) : 0,
+		stats.parked, stats.parked_max, stats.held, stats.reordered,
+		stats.collisions, stats.resubmits, luts_busy);
+}
+
+static ssize_t mxc_epdc_sched_stats_store(struct device *dev,
+				struct device_attribute *attr,
+				const char *buf, size_t size)
+{
+	struct fb_info *info = dev_get_drvdata(dev);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
+	unsigned long flags;
+	u32 depth;
+
+	/* Any write clears the counters; current queue depth is kept */
+	spin_lock_irqsave(&fb_data->queue_lock, flags);
+	depth = fb_data->sched_stats.queue_depth;
+	memset(&fb_data->sched_stats, 0, sizeof(fb_data->sched_stats));
+	fb_data->sched_stats.queue_depth = depth;
+	fb_data->sched_stats.queue_depth_max = depth;
+	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+
+	return size;
+}
+static DEVICE_ATTR(mxc_epdc_sched_stats, 0666, mxc_epdc_sched_stats_show,
+		   mxc_epdc_sched_stats_store);
+
+static ssize_t mxc_epdc_pwr_stats_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct fb_info *info = dev_get_drvdata(dev);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
+	struct epdc_pwr_pred pred;
+	unsigned long flags;
+
+	spin_lock_irqsave(&fb_data->queue_lock, flags);
+	pred = fb_data->pwr_pred;
+	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+
+	return sprintf(buf,
+		"adaptive: %d\n"
+		"samples: %u\n"
+		"gap_avg_ms: %d\n"
+		"gap_dev_ms: %d\n"
+		"ramp_us: %u\n"
+		"predictions: %u\n"
+		"holds: %u\n"
+		"prepowers: %u\n"
+		"hits: %u\n"
+		"misses_cold: %u\n"
+		"misses_wasted: %u\n",
+		fb_data->pwrdown_delay == FB_POWERDOWN_ADAPTIVE,
+		pred.samples, pred.gap_avg_ms, pred.gap_dev_ms, pred.ramp_us,
+		pred.predictions, pred.holds, pred.prepowers, pred.hits,
+		pred.misses_cold, pred.misses_wasted);
+}
+
+static ssize_t mxc_epdc_pwr_stats_store(struct device *dev,
+				struct device_attribute *attr,
+				const char *buf, size_t size)
+{
+	struct fb_info *info = dev_get_drvdata(dev);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
+	struct epdc_pwr_pred *pred = &fb_data->pwr_pred;
+	unsigned long flags;
+
+	/* Any write clears the counters; the learned model is kept */
+	spin_lock_irqsave(&fb_data->queue_lock, flags);
+	pred->predictions = 0;
+	pred->holds = 0;
+	pred->prepowers = 0;
+	pred->hits = 0;
+	pred->misses_cold = 0;
+	pred->misses_wasted = 0;
+	spin_unlock_irqrestore(&fb_data->queue_lock, flags);
+
+	return size;
+}
+static DEVICE_ATTR(mxc_epdc_pwr_stats, 0666, mxc_epdc_pwr_stats_show,
+		   mxc_epdc_pwr_stats_store);
+
+static ssize_t mxc_epdc_damage_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct fb_info *info = dev_get_drvdata(dev);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
+	struct epdc_damage *d = &fb_data->damage;
+	ssize_t len;
+
+	mutex_lock(&d->lock);
+	len = sprintf(buf,
+		"budget_kb: %u\n"
+		"passes: %u\n"
+		"bytes_diffed: %llu\n"
+		"pages_whole: %u\n"
+		"pages_clean: %u\n"
+		"rects: %u\n"
+		"pixels_band: %llu\n"
+		"pixels_sent: %llu\n",
+		d->budget_kb, d->passes, d->bytes_diffed, d->pages_whole,
+		d->pages_clean, d->rects, d->pixels_band, d->pixels_sent);
+	mutex_unlock(&d->lock);
+
+	return len;
+}
+
+static ssize_t mxc_epdc_damage_store(struct device *dev,
+				struct device_attribute *attr,
+				const char *buf, size_t size)
+{
+	struct fb_info *info = dev_get_drvdata(dev);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
+	struct epdc_damage *d = &fb_data->damage;
+	int value = 0;
+
+	/* Write the diff budget in KB (0 = page bands); clears counters */
+	if ((sscanf(buf, "%d", &value) <= 0) || (value < 0)) {
+		printk(KERN_ERR "Error in epdc damage budget value\n");
+		return -EINVAL;
+	}
+
+	/* Not while a defio pass is diffing against the old budget */
+	mutex_lock(&d->lock);
+	d->budget_kb = value;
+	d->passes = 0;
+	d->bytes_diffed = 0;
+	d->pages_whole = 0;
+	d->pages_clean = 0;
+	d->rects = 0;
+	d->pixels_band = 0;
+	d->pixels_sent = 0;
+	mutex_unlock(&d->lock);
+
+	return size;
+}
+static DEVICE_ATTR(mxc_epdc_damage, 0666, mxc_epdc_damage_show,
+		   mxc_epdc_damage_store);
+
+static ssize_t mxc_epdc_waveform_index_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct fb_info *info = dev_get_drvdata(dev);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
+	int i, len;
+
+	len = scnprintf(buf, PAGE_SIZE,
+		"modes: du %d gc4 %d gc8 %d gc16 %d gc32 %d gl16 %d\n"
+		"temp_index: %d\n"
+		"temp_ranges: %d\n",
+		fb_data->wv_modes.mode_du, fb_data->wv_modes.mode_gc4,
+		fb_data->wv_modes.mode_gc8, fb_data->wv_modes.mode_gc16,
+		fb_data->wv_modes.mode_gc32, fb_data->wv_modes.mode_gl16,
+		fb_data->temp_index, fb_data->temps.num_temp_ranges);
+
+	for (i = 0; i < fb_data->temps.num_temp_ranges; i++)
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+			"%d: %d..%d\n", i, fb_data->temp_range_bounds[i],
+			fb_data->temp_range_bounds[i + 1] - 1);
+
+	return len;
+}
+static DEVICE_ATTR(mxc_epdc_waveform_index, 0444,
+		   mxc_epdc_waveform_index_show, NULL);
+
+static ssize_t mxc_epdc_pxp_sw_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct fb_info *info = dev_get_drvdata(dev);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
+
+	return sprintf(buf, "max_pixels: %u\njobs: %u\n",
+		fb_data->pxp_sw_max_pixels, fb_data->pxp_sw_jobs);
+}
+
+static ssize_t mxc_epdc_pxp_sw_store(struct device *dev,
+				struct device_attribute *attr,
+				const char *buf, size_t size)
+{
+	struct fb_info *info = dev_get_drvdata(dev);
+	struct mxc_epdc_fb_data *fb_data = (struct mxc_epdc_fb_data *)info;
+	int value = 0;
+
+	/* Largest update, in pixels, to run on pxp_sw (0 = never) */
+	if ((sscanf(buf, "%d", &value) <= 0) || (value < 0)) {
+		printk(KERN_ERR "Error in epdc pxp_sw size value\n");
+		return -EINVAL;
+	}
+
+	fb_data->pxp_sw_max_pixels = value;
+	fb_data->pxp_sw_jobs = 0;
+
+	return size;
+}
+static DEVICE_ATTR(mxc_epdc_pxp_sw, 0666, mxc_epdc_pxp_sw_show,
+		   mxc_epdc_pxp_sw_store);
+
 
 #include "mxc_epdc_fb_lab126.c"
 
@@ -4145,8 +6060,15 @@ int __devinit mxc_epdc_fb_probe(struct platform_device *pdev)
 	INIT_LIST_HEAD(&fb_data->full_marker_list);
 
 	/* Initialize all LUTs to inactive */
-	for (i = 0; i < EPDC_NUM_LUTS; i++)
+	for (i = 0; i < EPDC_NUM_LUTS; i++) {
 		fb_data->lut_update_order[i] = 0;
+		fb_data->lut_shadow[i].busy = false;
+		fb_data->lut_shadow[i].traced = false;
+	}
+	memset(&fb_data->sched_stats, 0, sizeof(fb_data->sched_stats));
+
+	epdc_pixel_init();
+	epdc_pixel_selftest(&pdev->dev);
 
 	/* Retrieve EPDC IRQ num */
 	res = platform_get_resource(pdev, IORESOURCE_IRQ, 0);
@@ -4170,10 +6092,21 @@ int __devinit mxc_epdc_fb_probe(struct platform_device *pdev)
 	}
 
 	INIT_DELAYED_WORK(&fb_data->epdc_done_work, epdc_done_work_func);
+	INIT_DELAYED_WORK(&fb_data->epdc_prepower_work,
+		epdc_prepower_work_func);
+	memset(&fb_data->pwr_pred, 0, sizeof(fb_data->pwr_pred));
+	memset(&fb_data->damage, 0, sizeof(fb_data->damage));
+	fb_data->damage.budget_kb = EPDC_DAMAGE_BUDGET_KB;
+	mutex_init(&fb_data->damage.lock);
 	fb_data->epdc_submit_workqueue = create_rt_workqueue("submit");
 	INIT_WORK(&fb_data->epdc_submit_work, epdc_submit_work_func);
 
 	info->fbdefio = &mxc_epdc_fb_defio;
+#ifdef CONFIG_FB_MXC_EINK_AUTO_UPDATE_MODE
+	fb_deferred_io_init(info);
+	mxc_epdc_defio_mmap = info->fbops->fb_mmap;
+	info->fbops->fb_mmap = mxc_epdc_fb_defio_mmap;
+#endif
 
 	/* get pmic regulators */
 	fb_data->display_regulator = regulator_get(NULL, "DISPLAY");
@@ -4208,12 +6141,30 @@ int __devinit mxc_epdc_fb_probe(struct platform_device *pdev)
 	if (device_create_file(&pdev->dev, &dev_attr_mxc_epdc_pwrdown) < 0)
 		dev_err(&pdev->dev, "Unable to create  mxc_epdc_pwrdown file\n");
 
+	if (device_create_file(&pdev->dev, &dev_attr_mxc_epdc_sched_stats) < 0)
+		dev_err(&pdev->dev, "Unable to create mxc_epdc_sched_stats file\n");
+
+	if (device_create_file(&pdev->dev, &dev_attr_mxc_epdc_pwr_stats) < 0)
+		dev_err(&pdev->dev, "Unable to create mxc_epdc_pwr_stats file\n");
+	if (device_create_file(&pdev->dev, &dev_attr_mxc_epdc_damage) < 0)
+		dev_err(&pdev->dev, "Unable to create mxc_epdc_damage file\n");
+	if (device_create_file(&pdev->dev, &dev_attr_mxc_epdc_waveform_index) < 0)
+		dev_err(&pdev->dev, "Unable to create mxc_epdc_waveform_index file\n");
+	if (device_create_file(&pdev->dev, &dev_attr_mxc_epdc_pxp_sw) < 0)
+		dev_err(&pdev->dev, "Unable to create mxc_epdc_pxp_sw file\n");
+
 	fb_data->cur_update = NULL;
 
 	spin_lock_init(&fb_data->queue_lock);
 
 	mutex_init(&fb_data->pxp_mutex);
 
+	INIT_LIST_HEAD(&fb_data->user_buf_list);
+	mutex_init(&fb_data->user_buf_mutex);
+	fb_data->user_buf_handle = 0;
+
+	mxc_epdc_lat_init(fb_data);
+
 	mutex_init(&fb_data->power_mutex);
 
 	/* PxP DMA interface */
@@ -4284,6 +6235,7 @@ int __devinit mxc_epdc_fb_probe(struct platform_device *pdev)
 	 * later in our thread.
 	 */
 	fb_data->pxp_chan = NULL;
+	fb_data->pxp_sw_chan = NULL;
 
 	/* Initialize Scatter-gather list containing 2 buffer addresses. */
 	sg = fb_data->sg;
@@ -4308,6 +6260,7 @@ int __devinit mxc_epdc_fb_probe(struct platform_device *pdev)
 	fb_data->powering_down = false;
 	fb_data->wait_for_powerdown = false;
 	fb_data->pwrdown_delay = 0;
+	fb_data->pxp_sw_max_pixels = EPDC_PXP_SW_MAX_PIXELS;
 
 	/* Lab126  and Tequila only */
 	if (dont_register_fb) {
@@ -4367,6 +6320,7 @@ dont_register: /* Lab126 */
 	goto out;
 
 out_dmaengine:
+	mxc_epdc_lat_exit(fb_data);
 	dmaengine_put();
 out_irq:
 	free_irq(fb_data->epdc_irq, fb_data);
@@ -4403,6 +6357,7 @@ out:
 static int mxc_epdc_fb_remove(struct platform_device *pdev)
 {
 	struct update_data_list *plist, *temp_list;
+	struct epdc_user_buf *ubuf, *temp_ubuf;
 	struct mxc_epdc_fb_data *fb_data = platform_get_drvdata(pdev);
 	struct fb_info *info = &fb_data->info; /* Lab126 */
 
@@ -4411,6 +6366,7 @@ static int mxc_epdc_fb_remove(struct platform_device *pdev)
 	mxc_epdc_fb_blank(FB_BLANK_POWERDOWN, &fb_data->info);
 
 	cancel_rearming_delayed_work(&fb_data->epdc_done_work);
+	cancel_rearming_delayed_work(&fb_data->epdc_prepower_work);
 
 	/* Lab126 */
 	device_remove_file(info->dev, &fb_attrs[0]);
@@ -4418,7 +6374,17 @@ static int mxc_epdc_fb_remove(struct platform_device *pdev)
 	device_remove_file(&pdev->dev, &dev_attr_mxc_epdc_debug);
 	device_remove_file(&pdev->dev, &dev_attr_mxc_epdc_update);
 	device_remove_file(&pdev->dev, &dev_attr_mxc_epdc_pwrdown);
+	device_remove_file(&pdev->dev, &dev_attr_mxc_epdc_sched_stats);
+	device_remove_file(&pdev->dev, &dev_attr_mxc_epdc_pwr_stats);
+	device_remove_file(&pdev->dev, &dev_attr_mxc_epdc_damage);
+	device_remove_file(&pdev->dev, &dev_attr_mxc_epdc_waveform_index);
+	device_remove_file(&pdev->dev, &dev_attr_mxc_epdc_pxp_sw);
 	device_remove_file(&pdev->dev, &dev_attr_mxc_epdc_force_powerup);
+	mxc_epdc_lat_exit(fb_data);
+#ifdef CONFIG_FB_MXC_EINK_AUTO_UPDATE_MODE
+	fb_deferred_io_cleanup(&fb_data->info);
+#endif
+	epdc_damage_free(&fb_data->damage);
 	
 	regulator_put(fb_data->display_regulator);
 	regulator_put(fb_data->vcom_regulator);
@@ -4437,6 +6403,11 @@ static int mxc_epdc_fb_remove(struct platform_device *pdev)
 		dma_free_writecombine(&pdev->dev, fb_data->waveform_buffer_size,
 				fb_data->waveform_buffer_virt,
 				fb_data->waveform_buffer_phys);
+	list_for_each_entry_safe(ubuf, temp_ubuf, &fb_data->user_buf_list,
+			list) {
+		list_del(&ubuf->list);
+		epdc_user_buf_free(ubuf);
+	}
 	list_for_each_entry_safe(plist, temp_list, &fb_data->upd_buf_free_list,
 			list) {
 		list_del(&plist->list);
@@ -4458,6 +6429,8 @@ static int mxc_epdc_fb_remove(struct platform_device *pdev)
 	/* Release PxP-related resources */
 	if (fb_data->pxp_chan != NULL)
 		dma_release_channel(&fb_data->pxp_chan->dma_chan);
+	if (fb_data->pxp_sw_chan != NULL)
+		dma_release_channel(&fb_data->pxp_sw_chan->dma_chan);
 
 	dmaengine_put();
 
@@ -4520,11 +6493,13 @@ static void pxp_dma_done(void *arg)
 	complete(&fb_data->pxp_tx_cmpl);
 }
 
-/* Function to request PXP DMA channel */
-static int pxp_chan_init(struct mxc_epdc_fb_data *fb_data)
+/* Function to request PXP DMA channel, on the PxP or on pxp_sw */
+static struct pxp_channel *pxp_chan_init(struct mxc_epdc_fb_data *fb_data,
+					 bool sw)
 {
 	dma_cap_mask_t mask;
 	struct dma_chan *chan;
+	struct pxp_channel *pxp_chan;
 
 	/*
 	 * Request a free channel
@@ -4532,21 +6507,37 @@ static int pxp_chan_init(struct mxc_epdc_fb_data *fb_data)
 	dma_cap_zero(mask);
 	dma_cap_set(DMA_SLAVE, mask);
 	dma_cap_set(DMA_PRIVATE, mask);
-	chan = dma_request_channel(mask, NULL, NULL);
+	chan = dma_request_channel(mask, pxp_chan_filter,
+		sw ? fb_data : NULL);
 	if (!chan) {
-		dev_err(fb_data->dev, "Unsuccessfully received channel!!!!\n");
-		return -EBUSY;
+		if (!sw)
+			dev_err(fb_data->dev,
+				"Unsuccessfully received channel!!!!\n");
+		return NULL;
 	}
 
 	dev_dbg(fb_data->dev, "Successfully received channel.\n");
 
-	fb_data->pxp_chan = to_pxp_channel(chan);
+	pxp_chan = to_pxp_channel(chan);
 
-	fb_data->pxp_chan->client = fb_data;
+	pxp_chan->client = fb_data;
 
-	init_completion(&fb_data->pxp_tx_cmpl);
+	/* Screen updates go ahead of user-space PxP jobs */
+	pxp_chan->priority = PXP_PRIO_HIGH;
 
-	return 0;
+	return pxp_chan;
+}
+
+/* Give up a channel after a failed job, so the next job gets a fresh one */
+static void pxp_chan_release(struct mxc_epdc_fb_data *fb_data,
+			     struct pxp_channel *pxp_chan)
+{
+	dma_release_channel(&pxp_chan->dma_chan);
+
+	if (pxp_chan == fb_data->pxp_sw_chan)
+		fb_data->pxp_sw_chan = NULL;
+	else
+		fb_data->pxp_chan = NULL;
 }
 
 /*
@@ -4565,19 +6556,63 @@ static int pxp_process_update(struct mxc_epdc_fb_data *fb_data,
 	struct dma_async_tx_descriptor *txd;
 	struct pxp_config_data *pxp_conf = &fb_data->pxp_conf;
 	struct pxp_proc_data *proc_data = &fb_data->pxp_conf.proc_data;
-	int i, ret;
+	int i;
 	int length;
+	bool use_sw;
 
 	dev_dbg(fb_data->dev, "Starting PxP Send Buffer\n");
 
-	/* First, check to see that we have acquired a PxP Channel object */
+	/*
+	 * Configure PxP for processing of new update region
+	 * The rest of our config params were set up in
+	 * probe() and should not need to be changed.
+	 */
+	pxp_conf->s0_param.width = src_width;
+	pxp_conf->s0_param.height = src_height;
+	proc_data->srect.top = update_region->top;
+	proc_data->srect.left = update_region->left;
+	proc_data->srect.width = update_region->width;
+	proc_data->srect.height = update_region->height;
+
+	/*
+	 * Because only YUV/YCbCr image can be scaled, configure
+	 * drect equivalent to srect, as such do not perform scaling.
+	 */
+	proc_data->drect.top = 0;
+	proc_data->drect.left = 0;
+	proc_data->drect.width = proc_data->srect.width;
+	proc_data->drect.height = proc_data->srect.height;
+
+	/* PXP expects rotation in terms of degrees */
+	proc_data->rotate = fb_data->epdc_fb_var.rotate * 90;
+	if (proc_data->rotate > 270)
+		proc_data->rotate = 0;
+
+	pxp_conf->out_param.width = update_region->width;
+	pxp_conf->out_param.height = update_region->height;
+
+	/*
+	 * Small updates go to the CPU engine, so they don't wait for the
+	 * PxP clock or its interrupt.  It needs CPU mappings of both
+	 * buffers, and only takes the jobs pxp_sw_supported() allows.
+	 */
+	use_sw = fb_data->pxp_vaddr[0] && fb_data->pxp_vaddr[1] &&
+		(epdc_rect_area(update_region) <= fb_data->pxp_sw_max_pixels) &&
+		pxp_sw_supported(&pxp_conf->s0_param, &pxp_conf->out_param,
+				 proc_data);
+
+	/*
+	 * First, check to see that we have acquired our PxP Channel
+	 * objects.  Both are held from first use on, so that each job
+	 * just picks one.
+	 */
 	if (fb_data->pxp_chan == NULL) {
 		/*
 		 * PxP Channel has not yet been created and initialized,
 		 * so let's go ahead and try
 		 */
-		ret = pxp_chan_init(fb_data);
-		if (ret) {
+		fb_data->pxp_chan = pxp_chan_init(fb_data, false);
+		if (fb_data->pxp_chan == NULL) {
 			/*
 			 * PxP channel init failed, and we can't use the
 			 * PxP until the PxP DMA driver has loaded, so we abort
@@ -4587,6 +6622,16 @@ static int pxp_process_update(struct mxc_epdc_fb_data *fb_data,
 		}
 	}
 
+	if (use_sw && (fb_data->pxp_sw_chan == NULL)) {
+		fb_data->pxp_sw_chan = pxp_chan_init(fb_data, true);
+		if (fb_data->pxp_sw_chan == NULL) {
+			dev_info(fb_data->dev,
+				"No pxp_sw engine, all updates use the PxP\n");
+			fb_data->pxp_sw_max_pixels = 0;
+			use_sw = false;
+		}
+	}
+
 	/*
 	 * Init completion, so that we
 	 * can be properly informed of the completion
@@ -4597,7 +6642,8 @@ static int pxp_process_update(struct mxc_epdc_fb_data *fb_data,
 	dev_dbg(fb_data->dev, "sg[0] = 0x%x, sg[1] = 0x%x\n",
 		sg_dma_address(&sg[0]), sg_dma_address(&sg[1]));
 
-	dma_chan = &fb_data->pxp_chan->dma_chan;
+	dma_chan = use_sw ? &fb_data->pxp_sw_chan->dma_chan :
+		&fb_data->pxp_chan->dma_chan;
 
 	txd = dma_chan->device->device_prep_slave_sg(dma_chan, sg, 2,
 						     DMA_TO_DEVICE,
@@ -4611,35 +6657,6 @@ static int pxp_process_update(struct mxc_epdc_fb_data *fb_data,
 	txd->callback_param = txd;
 	txd->callback = pxp_dma_done;
 
-	/*
-	 * Configure PxP for processing of new update region
-	 * The rest of our config params were set up in
-	 * probe() and should not need to be changed.
-	 */
-	pxp_conf->s0_param.width = src_width;
-	pxp_conf->s0_param.height = src_height;
-	proc_data->srect.top = update_region->top;
-	proc_data->srect.left = update_region->left;
-	proc_data->srect.width = update_region->width;
-	proc_data->srect.height = update_region->height;
-
-	/*
-	 * Because only YUV/YCbCr image can be scaled, configure
-	 * drect equivalent to srect, as such do not perform scaling.
-	 */
-	proc_data->drect.top = 0;
-	proc_data->drect.left = 0;
-	proc_data->drect.width = proc_data->srect.width;
-	proc_data->drect.height = proc_data->srect.height;
-
-	/* PXP expects rotation in terms of degrees */
-	proc_data->rotate = fb_data->epdc_fb_var.rotate * 90;
-	if (proc_data->rotate > 270)
-		proc_data->rotate = 0;
-
-	pxp_conf->out_param.width = update_region->width;
-	pxp_conf->out_param.height = update_region->height;
-
 	desc = to_tx_desc(txd);
 	length = desc->len;
 	for (i = 0; i < length; i++) {
@@ -4648,10 +6665,12 @@ static int pxp_process_update(struct mxc_epdc_fb_data *fb_data,
 			pxp_conf->s0_param.paddr = sg_dma_address(&sg[0]);
 			memcpy(&desc->layer_param.s0_param, &pxp_conf->s0_param,
 				sizeof(struct pxp_layer_param));
+			desc->vaddr = fb_data->pxp_vaddr[0];
 		} else if (i == 1) {
 			pxp_conf->out_param.paddr = sg_dma_address(&sg[1]);
 			memcpy(&desc->layer_param.out_param, &pxp_conf->out_param,
 				sizeof(struct pxp_layer_param));
+			desc->vaddr = fb_data->pxp_vaddr[1];
 		}
 		/* TODO: OverLay */
 
@@ -4668,6 +6687,8 @@ static int pxp_process_update(struct mxc_epdc_fb_data *fb_data,
 	}
 
 	fb_data->txd = txd;
+	if (use_sw)
+		fb_data->pxp_sw_jobs++;
 
 	/* trigger ePxP */
 	dma_async_issue_pending(dma_chan);
@@ -4687,14 +6708,11 @@ static int pxp_complete_update(struct mxc_epdc_fb_data *fb_data, u32 *hist_stat)
 		dev_info(fb_data->info.device,
 			 "PxP operation failed due to %s\n",
 			 ret < 0 ? "user interrupt" : "timeout");
-		dma_release_channel(&fb_data->pxp_chan->dma_chan);
-		fb_data->pxp_chan = NULL;
+		pxp_chan_release(fb_data, to_pxp_channel(fb_data->txd->chan));
 		return ret ? : -ETIMEDOUT;
 	}
 
 	*hist_stat = to_tx_desc(fb_data->txd)->hist_status;
-	dma_release_channel(&fb_data->pxp_chan->dma_chan);
-	fb_data->pxp_chan = NULL;
 
 	dev_dbg(fb_data->dev, "TX completed\n");
 
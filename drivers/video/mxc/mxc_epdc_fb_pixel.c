@@ -0,0 +1,440 @@
+/*
+ * Copyright 2012 Amazon Technologies, Inc. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+/* Lab126 CPU pixel kernels for mxc_epdc
+ *
+ * Row copy/pad and RGB565->Y8->Y4 conversion used to prepare the PxP
+ * bounce buffer, and gray-level classification for auto waveform
+ * selection.  Each kernel has a straightforward per-pixel reference
+ * (epdc_ref_*) and a word-at-a-time fast path; the fast path is what the
+ * driver uses and the reference exists for the self-test.
+ *
+ * Levels are returned as a 16-bit mask with bit n set if any pixel has
+ * top nibble n, which is what the PxP histogram (GRAY16 mode) matches.
+ *
+ * Note: NEON is not used here.  This kernel does not preserve NEON/VFP
+ * state across kernel-mode use (no kernel_neon_begin()), so touching
+ * those registers would corrupt user context.
+ */
+
+/*
+ * RGB->Y weights match the PxP CSC2 RGB->YUV setup in pxp_set_csc():
+ * Y = (77 * R + 150 * G + 29 * B) >> 8 with 8-bit expanded components.
+ */
+#define EPDC_Y_R	77
+#define EPDC_Y_G	150
+#define EPDC_Y_B	29
+
+static u16 epdc_y_r_tab[32];
+static u16 epdc_y_g_tab[64];
+static u16 epdc_y_b_tab[32];
+static u8 epdc_y4_tab[256];
+
+static void epdc_pixel_init(void)
+{
+	u32 c8;
+	int i;
+
+	for (i = 0; i < 32; i++) {
+		c8 = (i << 3) | (i >> 2);
+		epdc_y_r_tab[i] = EPDC_Y_R * c8;
+		epdc_y_b_tab[i] = EPDC_Y_B * c8;
+	}
+	for (i = 0; i < 64; i++) {
+		c8 = (i << 2) | (i >> 4);
+		epdc_y_g_tab[i] = EPDC_Y_G * c8;
+	}
+
+	/*
+	 * Y4 is stored in an 8-bit container with the top nibble replicated
+	 * into the low one.  The EPDC (P4N) only uses the top nibble, so the
+	 * panel sees the same level, but the PxP histogram now sees e.g.
+	 * 0xF3 as pure white.
+	 */
+	for (i = 0; i < 256; i++)
+		epdc_y4_tab[i] = (i & 0xF0) | (i >> 4);
+}
+
+static inline u8 epdc_rgb565_to_y8(u16 pix)
+{
+	return (epdc_y_r_tab[pix >> 11] + epdc_y_g_tab[(pix >> 5) & 0x3F] +
+		epdc_y_b_tab[pix & 0x1F]) >> 8;
+}
+
+/* Reference kernels: one pixel at a time, no alignment assumptions */
+
+static void epdc_ref_rgb565_to_y8(u8 *dst, const u8 *src, int width)
+{
+	int i;
+
+	for (i = 0; i < width; i++)
+		dst[i] = epdc_rgb565_to_y8(src[2 * i] | (src[2 * i + 1] << 8));
+}
+
+static void epdc_ref_y8_to_y4(u8 *dst, const u8 *src, int width)
+{
+	int i;
+
+	for (i = 0; i < width; i++)
+		dst[i] = epdc_y4_tab[src[i]];
+}
+
+static u32 epdc_ref_levels(const u8 *y8, int width)
+{
+	u32 levels = 0;
+	int i;
+
+	for (i = 0; i < width; i++)
+		levels |= 1 << (y8[i] >> 4);
+
+	return levels;
+}
+
+/* Fast kernels: whole 32-bit words when both pointers allow it */
+
+static u32 epdc_rgb565_to_y8_row(u8 *dst, const u8 *src, int width)
+{
+	u32 pix2, levels = 0;
+	int i = 0;
+
+	if (!((unsigned long)src & 0x3)) {
+		const u32 *src32 = (const u32 *)src;
+
+		for (; i + 2 <= width; i += 2) {
+			pix2 = le32_to_cpu(*src32++);
+			dst[i] = epdc_rgb565_to_y8(pix2 & 0xFFFF);
+			dst[i + 1] = epdc_rgb565_to_y8(pix2 >> 16);
+			levels |= (1 << (dst[i] >> 4)) |
+				(1 << (dst[i + 1] >> 4));
+		}
+	}
+
+	if (i < width) {
+		epdc_ref_rgb565_to_y8(dst + i, src + 2 * i, width - i);
+		levels |= epdc_ref_levels(dst + i, width - i);
+	}
+
+	return levels;
+}
+
+static u32 epdc_y8_to_y4_row(u8 *dst, const u8 *src, int width)
+{
+	u32 pix4, levels = 0;
+	int i = 0;
+
+	if (!(((unsigned long)src | (unsigned long)dst) & 0x3)) {
+		const u32 *src32 = (const u32 *)src;
+		u32 *dst32 = (u32 *)dst;
+
+		for (; i + 4 <= width; i += 4) {
+			pix4 = *src32++;
+			*dst32++ = epdc_y4_tab[pix4 & 0xFF] |
+				(epdc_y4_tab[(pix4 >> 8) & 0xFF] << 8) |
+				(epdc_y4_tab[(pix4 >> 16) & 0xFF] << 16) |
+				(epdc_y4_tab[pix4 >> 24] << 24);
+			levels |= (1 << ((pix4 >> 4) & 0xF)) |
+				(1 << ((pix4 >> 12) & 0xF)) |
+				(1 << ((pix4 >> 20) & 0xF)) |
+				(1 << (pix4 >> 28));
+		}
+	}
+
+	if (i < width) {
+		levels |= epdc_ref_levels(src + i, width - i);
+		epdc_ref_y8_to_y4(dst + i, src + i, width - i);
+	}
+
+	return levels;
+}
+
+/* Fused RGB565 -> Y4: a single pass over the source row */
+static u32 epdc_rgb565_to_y4_row(u8 *dst, const u8 *src, int width)
+{
+	u32 pix2, levels = 0;
+	int i = 0;
+
+	if (!((unsigned long)src & 0x3)) {
+		const u32 *src32 = (const u32 *)src;
+
+		for (; i + 2 <= width; i += 2) {
+			pix2 = le32_to_cpu(*src32++);
+			dst[i] = epdc_y4_tab[epdc_rgb565_to_y8(pix2 & 0xFFFF)];
+			dst[i + 1] = epdc_y4_tab[epdc_rgb565_to_y8(pix2 >> 16)];
+			levels |= (1 << (dst[i] >> 4)) |
+				(1 << (dst[i + 1] >> 4));
+		}
+	}
+
+	for (; i < width; i++) {
+		dst[i] = epdc_y4_tab[epdc_rgb565_to_y8(src[2 * i] |
+			(src[2 * i + 1] << 8))];
+		levels |= 1 << (dst[i] >> 4);
+	}
+
+	return levels;
+}
+
+/* Level mask of a row, without converting it anywhere */
+static u32 epdc_y8_levels_row(const u8 *src, int width)
+{
+	u32 pix4, levels = 0;
+	int i = 0;
+
+	if (!((unsigned long)src & 0x3)) {
+		const u32 *src32 = (const u32 *)src;
+
+		for (; i + 4 <= width; i += 4) {
+			pix4 = *src32++;
+			levels |= (1 << ((pix4 >> 4) & 0xF)) |
+				(1 << ((pix4 >> 12) & 0xF)) |
+				(1 << ((pix4 >> 20) & 0xF)) |
+				(1 << (pix4 >> 28));
+		}
+	}
+
+	if (i < width)
+		levels |= epdc_ref_levels(src + i, width - i);
+
+	return levels;
+}
+
+static u32 epdc_rgb565_levels_row(const u8 *src, int width)
+{
+	u32 pix2, levels = 0;
+	int i = 0;
+
+	if (!((unsigned long)src & 0x3)) {
+		const u32 *src32 = (const u32 *)src;
+
+		for (; i + 2 <= width; i += 2) {
+			pix2 = le32_to_cpu(*src32++);
+			levels |= (1 << (epdc_rgb565_to_y8(pix2 & 0xFFFF) >> 4)) |
+				(1 << (epdc_rgb565_to_y8(pix2 >> 16) >> 4));
+		}
+	}
+
+	for (; i < width; i++)
+		levels |= 1 << (epdc_rgb565_to_y8(src[2 * i] |
+			(src[2 * i + 1] << 8)) >> 4);
+
+	return levels;
+}
+
+/*
+ * Level mask of a width x height block with 1 (Y8) or 2 (RGB565) bytes
+ * per pixel.  Stops early once every level has been seen.
+ */
+static u32 epdc_levels_rect(const u8 *src, int stride, int width,
+			    int height, int src_bpp)
+{
+	u32 levels = 0;
+	int y;
+
+	for (y = 0; (y < height) && (levels != 0xFFFF); y++) {
+		if (src_bpp == 2)
+			levels |= epdc_rgb565_levels_row(src, width);
+		else
+			levels |= epdc_y8_levels_row(src, width);
+		src += stride;
+	}
+
+	return levels;
+}
+
+/*
+ * Level sets programmed into the PxP HIST2/4/8 parameters (pxp_dma.c);
+ * a level mask is converted into the matching hist_stat bits so that
+ * CPU and PxP classification feed the same waveform selection.
+ */
+#define EPDC_HIST2_LEVELS	0x8001	/* 0x0 0xF */
+#define EPDC_HIST4_LEVELS	0x8421	/* 0x0 0x5 0xA 0xF */
+#define EPDC_HIST8_LEVELS	0xAA55	/* 0x0 0x2 0x4 0x6 0x9 0xB 0xD 0xF */
+
+static u32 epdc_levels_to_hist(u32 levels)
+{
+	u32 hist_stat = 0x8;
+
+	if (!(levels & ~EPDC_HIST2_LEVELS))
+		hist_stat |= 0x1;
+	if (!(levels & ~EPDC_HIST4_LEVELS))
+		hist_stat |= 0x2;
+	if (!(levels & ~EPDC_HIST8_LEVELS))
+		hist_stat |= 0x4;
+
+	return hist_stat;
+}
+
+enum epdc_pixel_op {
+	EPDC_PIXEL_COPY,	/* Copy as-is */
+	EPDC_PIXEL_RGB565_Y8,	/* Convert RGB565 to 8-bit luma */
+	EPDC_PIXEL_RGB565_Y4,	/* Convert RGB565 to 16-level luma */
+	EPDC_PIXEL_Y8_Y4,	/* Quantize 8-bit luma to 16 levels */
+};
+
+/*
+ * Copy a block of rows into an 8x8-aligned destination, converting on the
+ * way and zeroing the padding to the right of every row and below the
+ * last row.  width/height are in pixels; src_bpp is the source depth in
+ * bytes per pixel.  dst_stride must be at least ALIGN(width, 8) output
+ * pixels.  Converting ops return the level mask of the block (padding
+ * excluded); a plain copy returns 0.
+ */
+static u32 epdc_copy_pad_rows(u8 *dst, int dst_stride, const u8 *src,
+			      int src_stride, int width, int height,
+			      int src_bpp, enum epdc_pixel_op op)
+{
+	int dst_bpp = (op == EPDC_PIXEL_COPY) ? src_bpp : 1;
+	int row_bytes = width * dst_bpp;
+	int pad_bytes = (ALIGN(width, 8) - width) * dst_bpp;
+	u32 levels = 0;
+	int y;
+
+	for (y = 0; y < height; y++) {
+		switch (op) {
+		case EPDC_PIXEL_COPY:
+			memcpy(dst, src, row_bytes);
+			break;
+		case EPDC_PIXEL_RGB565_Y8:
+			levels |= epdc_rgb565_to_y8_row(dst, src, width);
+			break;
+		case EPDC_PIXEL_RGB565_Y4:
+			levels |= epdc_rgb565_to_y4_row(dst, src, width);
+			break;
+		case EPDC_PIXEL_Y8_Y4:
+			levels |= epdc_y8_to_y4_row(dst, src, width);
+			break;
+		}
+
+		if (pad_bytes)
+			memset(dst + row_bytes, 0x0, pad_bytes);
+
+		dst += dst_stride;
+		src += src_stride;
+	}
+
+	if (height & 0x7)
+		memset(dst, 0x0, (ALIGN(height, 8) - height) * dst_stride);
+
+	return levels;
+}
+
+#ifdef CONFIG_FB_MXC_EINK_PIXEL_SELFTEST
+/*
+ * Byte-for-byte comparison of the fast kernels against the references,
+ * across odd widths and every source/destination misalignment.
+ */
+static int epdc_pixel_selftest(struct device *dev)
+{
+	const int max_width = 67;
+	u8 *src, *ref, *out;
+	int width, soff, doff, i;
+	u32 levels;
+	int failures = 0;
+
+	src = kmalloc(2 * max_width + 8, GFP_KERNEL);
+	ref = kmalloc(max_width + 8, GFP_KERNEL);
+	out = kmalloc(max_width + 8, GFP_KERNEL);
+	if (!src || !ref || !out) {
+		failures = -ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < 2 * max_width + 8; i++)
+		src[i] = random32();
+
+	for (width = 1; width <= max_width; width++)
+		for (soff = 0; soff < 4; soff++)
+			for (doff = 0; doff < 4; doff++) {
+				epdc_ref_rgb565_to_y8(ref + doff, src + soff,
+					width);
+				levels = epdc_rgb565_to_y8_row(out + doff,
+					src + soff, width);
+				if (memcmp(ref + doff, out + doff, width) ||
+					(levels != epdc_ref_levels(ref + doff,
+					width)) || (levels !=
+					epdc_rgb565_levels_row(src + soff,
+					width))) {
+					dev_err(dev, "selftest: RGB565->Y8 "
+						"w=%d soff=%d doff=%d\n",
+						width, soff, doff);
+					failures++;
+				}
+
+				epdc_ref_y8_to_y4(ref + doff, src + soff,
+					width);
+				levels = epdc_y8_to_y4_row(out + doff,
+					src + soff, width);
+				if (memcmp(ref + doff, out + doff, width) ||
+					(levels != epdc_ref_levels(src + soff,
+					width)) || (levels !=
+					epdc_y8_levels_row(src + soff,
+					width))) {
+					dev_err(dev, "selftest: Y8->Y4 "
+						"w=%d soff=%d doff=%d\n",
+						width, soff, doff);
+					failures++;
+				}
+
+				epdc_ref_rgb565_to_y8(ref + doff, src + soff,
+					width);
+				epdc_ref_y8_to_y4(ref + doff, ref + doff,
+					width);
+				levels = epdc_rgb565_to_y4_row(out + doff,
+					src + soff, width);
+				if (memcmp(ref + doff, out + doff, width) ||
+					(levels != epdc_ref_levels(ref + doff,
+					width))) {
+					dev_err(dev, "selftest: RGB565->Y4 "
+						"w=%d soff=%d doff=%d\n",
+						width, soff, doff);
+					failures++;
+				}
+			}
+
+	/* Known values: black and white must survive both stages */
+	if ((epdc_rgb565_to_y8(0x0000) != 0x00) ||
+		(epdc_rgb565_to_y8(0xFFFF) != 0xFF) ||
+		(epdc_y4_tab[0x00] != 0x00) || (epdc_y4_tab[0xFF] != 0xFF)) {
+		dev_err(dev, "selftest: black/white levels wrong\n");
+		failures++;
+	}
+
+	/* Classification: B/W, 4-level gray, 8-level gray, full gray */
+	if ((epdc_levels_to_hist(0x8001) != 0xF) ||
+		(epdc_levels_to_hist(0x0421) != 0xA) ||
+		(epdc_levels_to_hist(0x0204) != 0xC) ||
+		(epdc_levels_to_hist(0x0008) != 0x8)) {
+		dev_err(dev, "selftest: level classification wrong\n");
+		failures++;
+	}
+
+	if (failures)
+		dev_err(dev, "pixel kernel selftest: %d failures\n", failures);
+	else
+		dev_info(dev, "pixel kernel selftest passed\n");
+
+out:
+	kfree(src);
+	kfree(ref);
+	kfree(out);
+	return failures;
+}
+#else
+static inline int epdc_pixel_selftest(struct device *dev) { return 0; }
+#endif
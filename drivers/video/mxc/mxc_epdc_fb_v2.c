@@ -2275,6 +2275,13 @@ int mxc_epdc_fb_set_pwrdown_delay(u32 pwrdown_delay,
 	struct mxc_epdc_fb_data *fb_data = info ?
 		(struct mxc_epdc_fb_data *)info:g_fb_data;
 
+	/* No idle predictor here; don't let -2 reach msecs_to_jiffies() */
+	if ((int)pwrdown_delay == FB_POWERDOWN_ADAPTIVE) {
+		dev_err(fb_data->dev,
+			"Adaptive power-down is not supported.\n");
+		return -EINVAL;
+	}
+
 	fb_data->pwrdown_delay = pwrdown_delay;
 
 	return 0;
@@ -3858,7 +3865,7 @@ static int pxp_chan_init(struct mxc_epdc_fb_data *fb_data)
 	dma_cap_zero(mask);
 	dma_cap_set(DMA_SLAVE, mask);
 	dma_cap_set(DMA_PRIVATE, mask);
-	chan = dma_request_channel(mask, NULL, NULL);
+	chan = dma_request_channel(mask, pxp_chan_filter, NULL);
 	if (!chan) {
 		dev_err(fb_data->dev, "Unsuccessfully received channel!!!!\n");
 		return -EBUSY;
@@ -3870,6 +3877,9 @@ static int pxp_chan_init(struct mxc_epdc_fb_data *fb_data)
 
 	fb_data->pxp_chan->client = fb_data;
 
+	/* Screen updates go ahead of user-space PxP jobs */
+	fb_data->pxp_chan->priority = PXP_PRIO_HIGH;
+
 	init_completion(&fb_data->pxp_tx_cmpl);
 
 	return 0;
@@ -0,0 +1,202 @@
+/*
+ * Copyright 2012 Amazon Technologies, Inc. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+/*
+ * Update merge policy for mxc_epdc_fb.
+ *
+ * Nothing in here touches driver state, so that tools/epdc/epdc_replay
+ * can feed recorded mxcfb_update_data traces through the same decisions
+ * the driver makes.  Include <linux/mxcfb.h> first; userspace users must
+ * also provide u32 and bool.
+ */
+#ifndef __MXC_EPDC_MERGE_H__
+#define __MXC_EPDC_MERGE_H__
+
+#define MERGE_OK	0
+#define MERGE_FAIL	1
+#define MERGE_BLOCK	2
+
+/*
+ * Merge cost model: fixed cost of an extra PxP pass + LUT, in weighted
+ * pixels, and the free LUT count below which that cost is quadrupled.
+ */
+#define EPDC_MERGE_OVERHEAD	(64 * 64)
+#define EPDC_MERGE_LUTS_LOW	3
+
+static inline bool epdc_rects_overlap(struct mxcfb_rect *a,
+				      struct mxcfb_rect *b)
+{
+	return (a->left < b->left + b->width) &&
+		(b->left < a->left + a->width) &&
+		(a->top < b->top + b->height) &&
+		(b->top < a->top + a->height);
+}
+
+static inline u32 epdc_rect_area(struct mxcfb_rect *rect)
+{
+	return rect->width * rect->height;
+}
+
+static inline void epdc_rect_union(struct mxcfb_rect *a,
+				   struct mxcfb_rect *b,
+				   struct mxcfb_rect *combine)
+{
+	u32 left = a->left < b->left ? a->left : b->left;
+	u32 top = a->top < b->top ? a->top : b->top;
+
+	combine->width = (a->left + a->width) > (b->left + b->width) ?
+			(a->left + a->width - left) :
+			(b->left + b->width - left);
+	combine->height = (a->top + a->height) > (b->top + b->height) ?
+			(a->top + a->height - top) :
+			(b->top + b->height - top);
+	combine->left = left;
+	combine->top = top;
+}
+
+/*
+ * Relative per-pixel cost of a waveform, roughly proportional to the
+ * number of frames it drives.  AUTO is unknown until the PxP histogram
+ * has been taken, so it is charged as a mid-weight mode.
+ */
+static inline u32 epdc_waveform_cost(struct mxcfb_waveform_modes *modes,
+				     u32 mode)
+{
+	if ((mode == modes->mode_du) || (mode == modes->mode_a2))
+		return 1;
+	if (mode == modes->mode_gc4)
+		return 2;
+	if (mode == WAVEFORM_MODE_AUTO)
+		return 2;
+	return 3;
+}
+
+/*
+ * Fixed cost, in weighted pixels, of running an update as its own
+ * PxP pass and LUT.  It grows as free LUTs run out, since a separate
+ * update then also risks stalling the queue.
+ */
+static inline u32 epdc_merge_overhead(int luts_free)
+{
+	if (luts_free <= EPDC_MERGE_LUTS_LOW)
+		return EPDC_MERGE_OVERHEAD * 4;
+
+	return EPDC_MERGE_OVERHEAD;
+}
+
+/*
+ * Can a and b be driven as one update at all, and with which waveform?
+ * Returns MERGE_OK with *merged_mode set, MERGE_FAIL if the two must
+ * stay separate, or MERGE_BLOCK if nothing queued behind b may be merged
+ * into a either.
+ */
+static inline int epdc_merge_mode(struct mxcfb_waveform_modes *modes,
+				  struct mxcfb_update_data *a,
+				  struct mxcfb_update_data *b,
+				  u32 *merged_mode)
+{
+	/*
+	 * Updates with different flags must be executed sequentially.
+	 * Halt the merge process to ensure this.
+	 */
+	if (a->flags != b->flags)
+		return MERGE_BLOCK;
+
+	/* Alt buffer regions can't be combined across separate sources */
+	if (a->flags & EPDC_FLAG_USE_ALT_BUFFER)
+		return MERGE_BLOCK;
+
+	if (a->waveform_mode == b->waveform_mode)
+		*merged_mode = a->waveform_mode;
+	else if (a->waveform_mode == modes->mode_a2 ||
+			b->waveform_mode == modes->mode_a2 ||
+			a->waveform_mode == modes->mode_gl16 ||
+			b->waveform_mode == modes->mode_gl16)
+		/* A2 and GL16 only merge with the same waveform */
+		return MERGE_FAIL;
+	else if (a->waveform_mode == modes->mode_gc16 ||
+			b->waveform_mode == modes->mode_gc16)
+		/* GC16 takes precedence over anything else */
+		*merged_mode = modes->mode_gc16;
+	else
+		/* AUTO with anything else stays AUTO */
+		*merged_mode = WAVEFORM_MODE_AUTO;
+
+	return MERGE_OK;
+}
+
+/*
+ * Is the bounding box of two disjoint updates no more expensive than
+ * running them separately, given the per-update overhead?  A FULL update
+ * never takes the box: it would drive every pixel in it, including the
+ * ones between the two regions that nobody asked to refresh.
+ */
+static inline bool epdc_merge_cheaper(struct mxcfb_waveform_modes *modes,
+				      struct mxcfb_update_data *a,
+				      struct mxcfb_update_data *b,
+				      struct mxcfb_rect *combine,
+				      u32 merged_mode, u32 overhead)
+{
+	u32 separate_cost, merged_cost;
+
+	if ((a->update_mode == UPDATE_MODE_FULL) ||
+	    (b->update_mode == UPDATE_MODE_FULL))
+		return false;
+
+	separate_cost =
+		epdc_rect_area(&a->update_region) *
+			epdc_waveform_cost(modes, a->waveform_mode) +
+		epdc_rect_area(&b->update_region) *
+			epdc_waveform_cost(modes, b->waveform_mode) +
+		overhead;
+	merged_cost = epdc_rect_area(combine) *
+		epdc_waveform_cost(modes, merged_mode);
+
+	return merged_cost <= separate_cost;
+}
+
+/*
+ * Does the newer update a make the older update b redundant?  It must
+ * fully cover b and drive those pixels at least as hard: same flags,
+ * same or stronger update mode, and the same waveform (or GC16, which
+ * supersedes everything).
+ */
+static inline bool epdc_update_supersedes(struct mxcfb_waveform_modes *modes,
+					  struct mxcfb_update_data *a,
+					  struct mxcfb_update_data *b)
+{
+	struct mxcfb_rect *arect = &a->update_region;
+	struct mxcfb_rect *brect = &b->update_region;
+
+	if (a->flags != b->flags)
+		return false;
+	if ((a->update_mode != UPDATE_MODE_FULL) &&
+		(b->update_mode == UPDATE_MODE_FULL))
+		return false;
+	if ((a->waveform_mode != b->waveform_mode) &&
+		(a->waveform_mode != modes->mode_gc16))
+		return false;
+
+	return (brect->left >= arect->left) &&
+		(brect->top >= arect->top) &&
+		(brect->left + brect->width <= arect->left + arect->width) &&
+		(brect->top + brect->height <= arect->top + arect->height);
+}
+
+#endif /* __MXC_EPDC_MERGE_H__ */
@@ -0,0 +1,68 @@
+/*
+ * Copyright 2012 Amazon Technologies, Inc. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM mxc_epdc
+
+#if !defined(_TRACE_MXC_EPDC_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_MXC_EPDC_H
+
+#include <linux/tracepoint.h>
+
+#define epdc_lat_stage_name(stage)	{ EPDC_LAT_##stage, #stage }
+
+/* An update reached one stage of the send -> PxP -> LUT pipeline */
+TRACE_EVENT(mxc_epdc_update_stage,
+
+	TP_PROTO(u32 update_order, u32 update_marker, int stage, int lut),
+
+	TP_ARGS(update_order, update_marker, stage, lut),
+
+	TP_STRUCT__entry(
+		__field(	u32,	update_order	)
+		__field(	u32,	update_marker	)
+		__field(	int,	stage		)
+		__field(	int,	lut		)
+	),
+
+	TP_fast_assign(
+		__entry->update_order	= update_order;
+		__entry->update_marker	= update_marker;
+		__entry->stage		= stage;
+		__entry->lut		= lut;
+	),
+
+	TP_printk("order=%u marker=%u stage=%s lut=%d",
+		  __entry->update_order, __entry->update_marker,
+		  __print_symbolic(__entry->stage,
+				   epdc_lat_stage_name(SEND),
+				   epdc_lat_stage_name(PXP_START),
+				   epdc_lat_stage_name(PXP_DONE),
+				   epdc_lat_stage_name(SUBMIT),
+				   epdc_lat_stage_name(DONE)),
+		  __entry->lut)
+);
+
+#endif /* _TRACE_MXC_EPDC_H */
+
+/* This part must be outside protection */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#define TRACE_INCLUDE_FILE mxc_epdc_trace
+#include <trace/define_trace.h>
@@ -0,0 +1,21 @@
+/*
+ *  linux/include/linux/einkfb_events.h -- eInk frame buffer events device
+ *
+ *      Copyright (c) 2011 Amazon Technologies, Inc.
+ *
+ *  This file is subject to the terms and conditions of the GNU General Public
+ *  License. See the file COPYING in the main directory of this archive for
+ *  more details.
+ */
+
+#ifndef _EINKFB_EVENTS_H
+#define _EINKFB_EVENTS_H
+
+#include <linux/ioctl.h>
+
+// ioctl on the eink_events device:  returns the number of events this reader
+// lost to a lap of the ring since it opened the device.
+//
+#define EINKFB_EVENTS_DROPPED   _IOR('e', 0x01, unsigned long)
+
+#endif // _EINKFB_EVENTS_H
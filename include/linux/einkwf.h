@@ -11,6 +11,7 @@
 #ifndef _EINKWF_H
 #define _EINKWF_H
 
+#include <linux/kernel.h>
 #include <linux/types.h>
 
 struct eink_waveform_t
@@ -70,6 +71,116 @@ struct eink_commands_info_t
 };
 typedef struct eink_commands_info_t eink_commands_info_t;
 
+// Waveform LUTs are decoded into frames of drive values, one per (from, to)
+// pair of 4-bit gray levels (0 = black, 15 = white), laid out [frame][from][to].
+//
+#define EINK_WF_LUT_GRAYS       16
+#define EINK_WF_LUT_FRAME_SIZE  (EINK_WF_LUT_GRAYS * EINK_WF_LUT_GRAYS)
+
+#define EINK_WF_DRIVE_NONE      0
+#define EINK_WF_DRIVE_BLACK     1
+#define EINK_WF_DRIVE_WHITE     2
+#define EINK_WF_DRIVE_NONE_ALT  3
+
+#define EINK_WF_DRIVES(d)       ((EINK_WF_DRIVE_BLACK == (d)) || (EINK_WF_DRIVE_WHITE == (d)))
+
+struct eink_waveform_lut_t
+{
+    int             num_modes,          // modes in the waveform
+                    num_temp_ranges,    // temperature ranges in the waveform
+                    temp_range,         // range the LUT was taken from
+                    temp_min,           // range's lower bound (inclusive)
+                    temp_max,           // range's upper bound (exclusive)
+                    num_frames;         // frames decoded into frames[]
+    
+    unsigned char   *frames;            // caller-supplied
+    int             frames_size;        // in bytes
+};
+typedef struct eink_waveform_lut_t eink_waveform_lut_t;
+
+// Temperature range tables hold ascending (unsigned) bounds, one more than the number
+// of ranges.  They're indexed once into a temperature -> range table that covers every
+// temperature that can differ in its range, so that lookups don't walk the bounds.
+//
+#define EINK_WF_TEMP_MIN        (-128)
+#define EINK_WF_TEMP_MAX        255
+#define EINK_WF_TEMPS           (EINK_WF_TEMP_MAX - EINK_WF_TEMP_MIN + 1)
+
+#define EINK_WF_TEMP_RANGE(t, temp) \
+    ((t)->temp_ranges[clamp((int)(temp), EINK_WF_TEMP_MIN, EINK_WF_TEMP_MAX) - EINK_WF_TEMP_MIN])
+
+struct eink_waveform_temps_t
+{
+    int             num_temp_ranges;
+    unsigned char   temp_ranges[EINK_WF_TEMPS];     // temperature - EINK_WF_TEMP_MIN -> range
+};
+typedef struct eink_waveform_temps_t eink_waveform_temps_t;
+
+// Inline, so that panel drivers that only have a TRT (e.g., mxc_epdc_fb) can index it
+// without depending on the waveform parser.
+//
+static inline void einkwf_index_temp_ranges(eink_waveform_temps_t *temps, unsigned char *bounds, int num_bounds)
+{
+    int temperature, temp_range, num_temp_ranges = max(num_bounds - 1, 0);
+    
+    if ( temps )
+    {
+        temps->num_temp_ranges = num_temp_ranges;
+        
+        // Each temperature falls into the first range whose bounds straddle it, defaulting
+        // to the first range when it's below all of them.
+        //
+        for ( temperature = EINK_WF_TEMP_MIN; temperature <= EINK_WF_TEMP_MAX; temperature++ )
+        {
+            unsigned char which_range = 0;
+            
+            for ( temp_range = 0; temp_range < num_temp_ranges; temp_range++ )
+            {
+                if ( temperature >= bounds[temp_range] )
+                {
+                    which_range = temp_range;
+                    
+                    if ( temperature < bounds[temp_range + 1] )
+                        break;
+                }
+            }
+            
+            temps->temp_ranges[temperature - EINK_WF_TEMP_MIN] = which_range;
+        }
+    }
+}
+
+// The waveform index is built once per waveform loaded into the buffer.  It caches the
+// header info & version strings and, for .wbf waveforms, where each (mode, temperature
+// range) LUT lives and how many frames it has.
+//
+#define EINK_WF_VERSION_STRING_MAX  64
+#define EINK_WF_INDEX_MODES         16
+#define EINK_WF_INDEX_TEMP_RANGES   32
+
+struct eink_waveform_lut_info_t
+{
+    unsigned long   offset,             // LUT's frame data in the waveform
+                    size;               // encoded, in bytes
+    int             num_frames;         // 0 -> not indexed
+};
+typedef struct eink_waveform_lut_info_t eink_waveform_lut_info_t;
+
+struct eink_waveform_index_t
+{
+    bool            valid;              // header recognized
+    eink_waveform_info_t info;
+    char            version_string[EINK_WF_VERSION_STRING_MAX],
+                    filename[EINK_WF_VERSION_STRING_MAX];
+    
+    bool            luts_indexed;       // set once the LUTs have been walked
+    int             num_modes;
+    unsigned char   temp_bounds[EINK_WF_INDEX_TEMP_RANGES + 1];
+    eink_waveform_temps_t temps;
+    eink_waveform_lut_info_t luts[EINK_WF_INDEX_MODES][EINK_WF_INDEX_TEMP_RANGES];
+};
+typedef struct eink_waveform_index_t eink_waveform_index_t;
+
 #define EINK_WF_UNKNOWN_PATH    "no path set yet"
 #define EINK_WF_DEFAULT_USAGE   "default waveform usage"
 #define EINK_WF_USE_BUILTIN_WAVEFORM "built-in"
@@ -100,6 +211,9 @@ void einkwf_get_waveform_version(eink_waveform_t *waveform);
 void einkwf_get_fpl_version(eink_fpl_t *fpl);
 char *einkwf_get_waveform_version_string(eink_waveform_version_string_t which_string);
 bool einkwf_waveform_valid(void);
+bool einkwf_get_waveform_lut(eink_waveform_lut_t *lut, int mode, int temperature);
+eink_waveform_index_t *einkwf_get_waveform_index(bool index_luts);
+void einkwf_index_clr(void);
 
 int  einkwf_write_waveform_to_file(char *waveform_file_path);
 int  einkwf_read_waveform_from_file(char *waveform_file_path);
@@ -95,8 +95,11 @@ struct mxcfb_rect {
 #define EPDC_FLAG_ENABLE_INVERSION		0x01
 #define EPDC_FLAG_FORCE_MONOCHROME		0x02
 #define EPDC_FLAG_USE_ALT_BUFFER		0x100
+#define EPDC_FLAG_USE_USER_BUFFER		0x200	/* alt_buffer_data.phys_addr
+							   is a user buffer handle */
 
 #define FB_POWERDOWN_DISABLE			-1
+#define FB_POWERDOWN_ADAPTIVE			-2	/* Predict idle gaps */
 
 struct mxcfb_alt_buffer_data {
 	__u32 phys_addr;
@@ -105,6 +108,17 @@ struct mxcfb_alt_buffer_data {
 	struct mxcfb_rect alt_update_region;	/* region within buffer to update */
 };
 
+/*
+ * Userspace buffer registered with MXCFB_REGISTER_USER_BUFFER.  The
+ * returned handle goes in alt_buffer_data.phys_addr of an update with
+ * EPDC_FLAG_USE_ALT_BUFFER | EPDC_FLAG_USE_USER_BUFFER set.
+ */
+struct mxcfb_user_buffer {
+	__u32 addr;	/* user virtual address */
+	__u32 size;	/* length in bytes */
+	__u32 handle;	/* returned by driver */
+};
+
 struct mxcfb_update_data {
 	struct mxcfb_rect update_region;
 	__u32 waveform_mode;
@@ -156,6 +170,8 @@ struct mxcfb_waveform_modes {
 #define MXCFB_GET_PAUSE			_IOW('F', 0x34, __u32)
 #define MXCFB_SET_RESUME		_IOW('F', 0x35, __u32)
 #define MXCFB_CLEAR_UPDATE_QUEUE	_IOW('F', 0x36, __u32)
+#define MXCFB_REGISTER_USER_BUFFER	_IOWR('F', 0x37, struct mxcfb_user_buffer)
+#define MXCFB_UNREGISTER_USER_BUFFER	_IOW('F', 0x38, __u32)
 
 #ifdef __KERNEL__
 
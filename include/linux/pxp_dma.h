@@ -98,6 +98,14 @@ enum pxp_channel_status {
 	PXP_CHANNEL_READY,
 };
 
+/* Channel priorities: queued work on higher priority channels runs first */
+enum pxp_channel_priority {
+	PXP_PRIO_LOW,		/* user-space (overlay) clients */
+	PXP_PRIO_NORMAL,
+	PXP_PRIO_HIGH,		/* EPDC updates */
+	NR_PXP_PRIO,
+};
+
 struct rect {
 	int top;		/* Upper left coordinate of rectangle */
 	int left;
@@ -172,6 +180,12 @@ struct pxp_mem_desc {
 
 #ifdef __KERNEL__
 
+#include <linux/dmaengine.h>
+#include <linux/string.h>
+
+/* Device name of the CPU implementation of the PxP (pxp_sw.c) */
+#define PXP_SW_DEV_NAME		"pxp_sw"
+
 struct pxp_tx_desc {
 	struct dma_async_tx_descriptor txd;
 	struct list_head tx_list;
@@ -184,6 +198,8 @@ struct pxp_tx_desc {
 	} layer_param;
 	struct pxp_proc_data proc_data;
 
+	void *vaddr;		/* CPU mapping of the layer, for pxp_sw */
+
 	u32 hist_status;	/* Histogram output status */
 
 	struct pxp_tx_desc *next;
@@ -199,7 +215,8 @@ struct pxp_channel {
 	struct list_head active_list;	/* active tx-descriptors */
 	struct list_head free_list;	/* free tx-descriptors */
 	struct list_head queue;	/* queued tx-descriptors */
-	struct list_head list;	/* track queued channel number */
+	struct list_head list;	/* on the PxP run queue for its priority */
+	int priority;		/* enum pxp_channel_priority */
 	spinlock_t lock;	/* protects sg[0,1], queue */
 	struct mutex chan_mutex;	/* protects status, cookie, free_list */
 	int active_buffer;
@@ -218,6 +235,69 @@ struct pxp_irq_info {
 
 void pxp_txd_ack(struct dma_async_tx_descriptor *txd,
 		 struct pxp_channel *pxp_chan);
+
+static inline bool pxp_chan_is_sw(struct dma_chan *chan)
+{
+	return !strcmp(dev_name(chan->device->dev), PXP_SW_DEV_NAME);
+}
+
+/* dma_request_channel() filter: a non-NULL @param asks for pxp_sw */
+static inline bool pxp_chan_filter(struct dma_chan *chan, void *param)
+{
+	return pxp_chan_is_sw(chan) == (param != NULL);
+}
+
+/* Bytes per pixel of an S0 format pxp_sw takes, 0 if it doesn't */
+static inline int pxp_sw_bpp(u32 pixel_fmt)
+{
+	switch (pixel_fmt) {
+	case PXP_PIX_FMT_GREY:
+		return 1;
+	case PXP_PIX_FMT_RGB565:
+		return 2;
+	case PXP_PIX_FMT_RGB32:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Can pxp_sw process S0 into the output as @proc_data asks?  pxp_sw
+ * refuses anything else at tx_submit(), so clients check this before
+ * they pick it over the PxP.
+ */
+static inline bool pxp_sw_supported(struct pxp_layer_param *s0_params,
+				    struct pxp_layer_param *out_params,
+				    struct pxp_proc_data *proc_data)
+{
+	struct rect *srect = &proc_data->srect;
+	struct rect *drect = &proc_data->drect;
+
+	if (!pxp_sw_bpp(s0_params->pixel_fmt) ||
+	    (out_params->pixel_fmt != PXP_PIX_FMT_GREY))
+		return false;
+
+	if (proc_data->hflip || proc_data->vflip ||
+	    (proc_data->rotate % 90) || (proc_data->rotate < 0) ||
+	    (proc_data->rotate > 270) || (proc_data->lut_transform & ~0x3))
+		return false;
+
+	/* Only 1:1, with the processed rectangle filling the output */
+	if ((srect->width != drect->width) ||
+	    (srect->height != drect->height) || drect->left || drect->top ||
+	    (drect->width != out_params->width) ||
+	    (drect->height != out_params->height))
+		return false;
+
+	if ((srect->left < 0) || (srect->top < 0) || (srect->width <= 0) ||
+	    (srect->height <= 0) ||
+	    (srect->left + srect->width > s0_params->width) ||
+	    (srect->top + srect->height > s0_params->height))
+		return false;
+
+	return true;
+}
 #endif
 
 #endif
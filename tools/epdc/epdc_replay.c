@@ -0,0 +1,365 @@
+/*
+ * epdc_replay - run recorded EPDC update traces through the mxc_epdc_fb
+ * merge policy and report how many pixels it would send to the PxP.
+ *
+ * Copyright 2012 Amazon Technologies, Inc. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Usage: epdc_replay [-b] [-q depth] [-l luts_free] [trace]
+ *
+ * A trace is read from the named file, or stdin.  By default it is text,
+ * one update per line:
+ *
+ *	left top width height waveform update_mode [flags]
+ *
+ * where waveform is a number or one of init, du, gc4, gc16, gl16, a2 or
+ * auto, and update_mode is partial, full, 0 or 1.  A line reading "sync"
+ * drains the queue, as a client waiting on a marker would.  Blank lines
+ * and lines starting with '#' are ignored.  With -b, the trace is instead
+ * a raw sequence of struct mxcfb_update_data, as passed to
+ * MXCFB_SEND_UPDATE.
+ *
+ * Updates are queued as in UPDATE_SCHEME_QUEUE_AND_MERGE, and the queue
+ * is drained whenever it reaches the given depth: the oldest update takes
+ * in everything behind it that epdc_submit_merge() would accept, until a
+ * merge is blocked.  Every trace is run twice, once with the merge policy
+ * the driver uses and once with the old one (overlapping updates only,
+ * always into their bounding box, nothing superseded), so that the two
+ * can be compared.  Regions blocked by in-flight LUTs are not modelled.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#include "../../include/linux/mxcfb.h"
+
+typedef uint32_t u32;
+
+#include "../../drivers/video/mxc/mxc_epdc_merge.h"
+
+#define MAX_TRACE	65536
+#define MAX_QUEUE	64
+#define NUM_LUTS	16
+
+struct replay_stats {
+	unsigned long updates;
+	unsigned long dispatched;
+	unsigned long merges;
+	unsigned long merges_declined;
+	unsigned long superseded;
+	unsigned long long pixels_requested;
+	unsigned long long pixels_processed;
+};
+
+/* Entry that stands for a "sync" line in the trace */
+#define TRACE_SYNC	((u32)-1)
+
+static struct mxcfb_waveform_modes modes = {
+	.mode_init = WAVEFORM_MODE_INIT,
+	.mode_du = WAVEFORM_MODE_DU,
+	.mode_gc4 = WAVEFORM_MODE_GC4,
+	.mode_gc8 = WAVEFORM_MODE_GC16,
+	.mode_gc16 = WAVEFORM_MODE_GC16,
+	.mode_gc32 = WAVEFORM_MODE_GC16,
+	.mode_gl16 = WAVEFORM_MODE_GL16,
+	.mode_a2 = WAVEFORM_MODE_A2,
+};
+
+static struct mxcfb_update_data trace[MAX_TRACE];
+static int trace_len;
+
+static int queue_depth = 4;
+static int luts_free = NUM_LUTS;
+
+static int parse_waveform(const char *s, u32 *mode)
+{
+	static const struct {
+		const char *name;
+		u32 mode;
+	} names[] = {
+		{ "init", WAVEFORM_MODE_INIT },
+		{ "du", WAVEFORM_MODE_DU },
+		{ "gc4", WAVEFORM_MODE_GC4 },
+		{ "gc16", WAVEFORM_MODE_GC16 },
+		{ "gl16", WAVEFORM_MODE_GL16 },
+		{ "a2", WAVEFORM_MODE_A2 },
+		{ "auto", WAVEFORM_MODE_AUTO },
+	};
+	char *end;
+	unsigned int i;
+
+	for (i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+		if (!strcasecmp(s, names[i].name)) {
+			*mode = names[i].mode;
+			return 0;
+		}
+	}
+
+	*mode = strtoul(s, &end, 0);
+	return (*end || end == s) ? -1 : 0;
+}
+
+static int parse_update_mode(const char *s, u32 *mode)
+{
+	if (!strcasecmp(s, "partial") || !strcmp(s, "0"))
+		*mode = UPDATE_MODE_PARTIAL;
+	else if (!strcasecmp(s, "full") || !strcmp(s, "1"))
+		*mode = UPDATE_MODE_FULL;
+	else
+		return -1;
+
+	return 0;
+}
+
+static int read_text_trace(FILE *f)
+{
+	char line[256], wave[32], mode[32];
+	struct mxcfb_update_data *upd;
+	unsigned int flags;
+	int lineno = 0, n;
+
+	while (fgets(line, sizeof(line), f)) {
+		char *p = line + strspn(line, " \t");
+
+		lineno++;
+		if (*p == '#' || *p == '\n' || *p == '\0')
+			continue;
+
+		if (trace_len == MAX_TRACE) {
+			fprintf(stderr, "trace too long, stopping at line %d\n",
+				lineno);
+			break;
+		}
+
+		upd = &trace[trace_len];
+		memset(upd, 0, sizeof(*upd));
+
+		if (!strncasecmp(p, "sync", 4)) {
+			upd->update_marker = TRACE_SYNC;
+			trace_len++;
+			continue;
+		}
+
+		flags = 0;
+		n = sscanf(p, "%u %u %u %u %31s %31s %i",
+			   &upd->update_region.left, &upd->update_region.top,
+			   &upd->update_region.width,
+			   &upd->update_region.height, wave, mode, &flags);
+		if (n < 6 || parse_waveform(wave, &upd->waveform_mode) ||
+		    parse_update_mode(mode, &upd->update_mode)) {
+			fprintf(stderr, "line %d: can't parse update\n",
+				lineno);
+			return -1;
+		}
+		upd->flags = flags;
+		upd->temp = TEMP_USE_AMBIENT;
+		upd->update_marker = trace_len;
+		trace_len++;
+	}
+
+	return 0;
+}
+
+static int read_binary_trace(FILE *f)
+{
+	while (trace_len < MAX_TRACE &&
+	       fread(&trace[trace_len], sizeof(trace[0]), 1, f) == 1) {
+		/* Markers are only used to tell syncs from updates here */
+		if (trace[trace_len].update_marker == TRACE_SYNC)
+			trace[trace_len].update_marker = 0;
+		trace_len++;
+	}
+
+	return ferror(f) ? -1 : 0;
+}
+
+/*
+ * Would the driver merge b into a?  Mirrors epdc_submit_merge(), or the
+ * merge it replaced when cost_model is false.
+ */
+static int replay_merge(struct mxcfb_update_data *a,
+			struct mxcfb_update_data *b, bool cost_model,
+			struct replay_stats *stats)
+{
+	struct mxcfb_rect combine;
+	u32 merged_mode;
+	int ret;
+
+	ret = epdc_merge_mode(&modes, a, b, &merged_mode);
+	if (ret != MERGE_OK)
+		return ret;
+
+	epdc_rect_union(&a->update_region, &b->update_region, &combine);
+
+	if (!epdc_rects_overlap(&a->update_region, &b->update_region)) {
+		if (!cost_model)
+			return MERGE_FAIL;
+
+		if (!epdc_merge_cheaper(&modes, a, b, &combine, merged_mode,
+				epdc_merge_overhead(luts_free))) {
+			stats->merges_declined++;
+			return MERGE_FAIL;
+		}
+	}
+
+	a->waveform_mode = merged_mode;
+	if (b->update_mode == UPDATE_MODE_FULL)
+		a->update_mode = UPDATE_MODE_FULL;
+	a->update_region = combine;
+
+	stats->merges++;
+
+	return MERGE_OK;
+}
+
+static void replay_drain(struct mxcfb_update_data *queue, int *queued,
+			 bool cost_model, struct replay_stats *stats)
+{
+	struct mxcfb_update_data upd;
+	int i, j;
+
+	while (*queued) {
+		upd = queue[0];
+		memmove(&queue[0], &queue[1], --(*queued) * sizeof(upd));
+
+		for (i = 0; i < *queued; ) {
+			int ret = replay_merge(&upd, &queue[i], cost_model,
+					       stats);
+
+			if (ret == MERGE_BLOCK)
+				break;
+			if (ret == MERGE_OK) {
+				for (j = i; j < *queued - 1; j++)
+					queue[j] = queue[j + 1];
+				(*queued)--;
+			} else {
+				i++;
+			}
+		}
+
+		stats->dispatched++;
+		stats->pixels_processed += epdc_rect_area(&upd.update_region);
+	}
+}
+
+static void replay(bool cost_model, struct replay_stats *stats)
+{
+	struct mxcfb_update_data queue[MAX_QUEUE];
+	int queued = 0, i, j;
+
+	memset(stats, 0, sizeof(*stats));
+
+	for (i = 0; i < trace_len; i++) {
+		struct mxcfb_update_data *upd = &trace[i];
+
+		if (upd->update_marker == TRACE_SYNC) {
+			replay_drain(queue, &queued, cost_model, stats);
+			continue;
+		}
+
+		stats->updates++;
+		stats->pixels_requested += epdc_rect_area(&upd->update_region);
+
+		/* As epdc_collapse_superseded(), at queue time */
+		for (j = 0; cost_model && j < queued; ) {
+			if (epdc_update_supersedes(&modes, upd, &queue[j])) {
+				memmove(&queue[j], &queue[j + 1],
+					(queued - j - 1) * sizeof(queue[0]));
+				queued--;
+				stats->superseded++;
+			} else {
+				j++;
+			}
+		}
+
+		queue[queued++] = *upd;
+
+		if (queued >= queue_depth)
+			replay_drain(queue, &queued, cost_model, stats);
+	}
+
+	replay_drain(queue, &queued, cost_model, stats);
+}
+
+static void print_stats(const char *name, struct replay_stats *stats)
+{
+	printf("%-8s updates %lu dispatched %lu merges %lu declined %lu "
+	       "superseded %lu pixels requested %llu processed %llu",
+	       name, stats->updates, stats->dispatched, stats->merges,
+	       stats->merges_declined, stats->superseded,
+	       stats->pixels_requested, stats->pixels_processed);
+	if (stats->pixels_requested)
+		printf(" (%llu%%)", stats->pixels_processed * 100 /
+		       stats->pixels_requested);
+	printf("\n");
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-b] [-q depth] [-l luts_free] [trace]\n"
+		"  -b  trace is raw struct mxcfb_update_data records\n"
+		"  -q  queue depth that triggers a drain (1-%d, default %d)\n"
+		"  -l  free LUTs assumed by the cost model (0-%d, default %d)\n",
+		prog, MAX_QUEUE - 1, queue_depth, NUM_LUTS, luts_free);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	struct replay_stats cost, bbox;
+	bool binary = false;
+	FILE *f = stdin;
+	int opt, ret;
+
+	while ((opt = getopt(argc, argv, "bq:l:h")) != -1) {
+		switch (opt) {
+		case 'b':
+			binary = true;
+			break;
+		case 'q':
+			queue_depth = atoi(optarg);
+			if (queue_depth < 1 || queue_depth >= MAX_QUEUE)
+				usage(argv[0]);
+			break;
+		case 'l':
+			luts_free = atoi(optarg);
+			if (luts_free < 0 || luts_free > NUM_LUTS)
+				usage(argv[0]);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (optind < argc) {
+		f = fopen(argv[optind], binary ? "rb" : "r");
+		if (!f) {
+			perror(argv[optind]);
+			return 1;
+		}
+	}
+
+	ret = binary ? read_binary_trace(f) : read_text_trace(f);
+	if (f != stdin)
+		fclose(f);
+	if (ret)
+		return 1;
+
+	replay(true, &cost);
+	replay(false, &bbox);
+
+	print_stats("cost", &cost);
+	print_stats("bbox", &bbox);
+
+	return 0;
+}